@@ -0,0 +1,492 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../plugins/sync/consumer_producer.h"
+#include "../plugins/sync/monitor.h"
+
+/** 
+ * Component microbenchmarks for the queue, the monitor and the plugin transforms 
+ * Every measurement is warmed up first and then repeated; the median and the minimum of the 
+ * repetitions are reported. Threads are pinned so runs are comparable with each other. 
+ */
+
+#define BENCH_MAX_SAMPLES 101
+#define BENCH_MAX_LENGTH (64 * 1024)
+
+typedef const char* (*plugin_transform_func_t)(const char*);
+
+// Command line options
+typedef struct {
+    int repetitions;     // Measured runs per benchmark (after one warm-up run)
+    int quick;           // Fewer iterations, capacities and lengths (smoke test)
+    int cpu;             // First CPU to pin to (-1 = no pinning)
+    const char* filter;  // Only run benchmarks whose group starts with this (NULL = all)
+} bench_options_t;
+
+static bench_options_t options = { 5, 0, 0, NULL };
+
+static double now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Pin the calling thread - the second thread of a pair goes to the next CPU if there is one
+static void pin_thread(int offset) {
+    if (options.cpu < 0) {
+        return;
+    }
+    
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((options.cpu + offset) % (cpus > 0 ? cpus : 1), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int selected(const char* group) {
+    return !options.filter || strncmp(group, options.filter, strlen(options.filter)) == 0;
+}
+
+// Run a measurement once to warm up, then repeatedly, keeping the median and the minimum
+static void sample(double (*measure)(void*), void* arg, double* median, double* minimum) {
+    double samples[BENCH_MAX_SAMPLES];
+    int count = options.repetitions < BENCH_MAX_SAMPLES ? options.repetitions : BENCH_MAX_SAMPLES;
+    
+    measure(arg);
+    for (int i = 0; i < count; i++) {
+        samples[i] = measure(arg);
+    }
+    
+    qsort(samples, count, sizeof(double), compare_doubles);
+    *median = samples[count / 2];
+    *minimum = samples[0];
+}
+
+static void report(const char* group, const char* label, double (*measure)(void*), void* arg, const char* unit) {
+    double median, minimum;
+    sample(measure, arg, &median, &minimum);
+    printf("[BENCH] %-20s %-16s median %12.1f %s   min %12.1f %s\n", group, label, median, unit, minimum, unit);
+    fflush(stdout);
+}
+
+/* ---------------- consumer_producer_t ---------------- */
+
+typedef struct {
+    int capacity;
+    int iterations;
+    consumer_producer_t request;
+    consumer_producer_t response;
+} queue_bench_t;
+
+// Echo every request back until the <END> item
+static void* echo_thread(void* arg) {
+    queue_bench_t* bench = (queue_bench_t*)arg;
+    pin_thread(1);
+    
+    while (1) {
+        char* item = consumer_producer_get(&bench->request);
+        int end = strcmp(item, "<END>") == 0;
+        consumer_producer_put(&bench->response, item);
+        free(item);
+        if (end) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Round trip through two queues, ns per round trip
+static double measure_ping_pong(void* arg) {
+    queue_bench_t* bench = (queue_bench_t*)arg;
+    consumer_producer_init(&bench->request, bench->capacity);
+    consumer_producer_init(&bench->response, bench->capacity);
+    
+    pthread_t thread;
+    pthread_create(&thread, NULL, echo_thread, bench);
+    
+    double start = now_ns();
+    for (int i = 0; i < bench->iterations; i++) {
+        consumer_producer_put(&bench->request, "ping");
+        free(consumer_producer_get(&bench->response));
+    }
+    double elapsed = now_ns() - start;
+    
+    consumer_producer_put(&bench->request, "<END>");
+    free(consumer_producer_get(&bench->response));
+    pthread_join(thread, NULL);
+    
+    consumer_producer_destroy(&bench->request);
+    consumer_producer_destroy(&bench->response);
+    return elapsed / bench->iterations;
+}
+
+static void* drain_thread(void* arg) {
+    queue_bench_t* bench = (queue_bench_t*)arg;
+    pin_thread(1);
+    
+    for (int i = 0; i < bench->iterations; i++) {
+        free(consumer_producer_get(&bench->request));
+    }
+    return NULL;
+}
+
+// One producer, one consumer, as fast as possible - ns per item
+static double measure_streaming(void* arg) {
+    queue_bench_t* bench = (queue_bench_t*)arg;
+    consumer_producer_init(&bench->request, bench->capacity);
+    
+    pthread_t thread;
+    double start = now_ns();
+    pthread_create(&thread, NULL, drain_thread, bench);
+    for (int i = 0; i < bench->iterations; i++) {
+        consumer_producer_put(&bench->request, "a typical log line of some length");
+    }
+    pthread_join(thread, NULL);
+    double elapsed = now_ns() - start;
+    
+    consumer_producer_destroy(&bench->request);
+    return elapsed / bench->iterations;
+}
+
+static void bench_queue(void) {
+    static const int quick_capacities[] = { 1, 64, 4096 };
+    int iterations = options.quick ? 2000 : 100000;
+    
+    for (int capacity = 1; capacity <= 4096; capacity *= 2) {
+        if (options.quick && capacity != quick_capacities[0] && capacity != quick_capacities[1] &&
+            capacity != quick_capacities[2]) {
+            continue;
+        }
+        
+        char label[32];
+        snprintf(label, sizeof(label), "capacity=%d", capacity);
+        queue_bench_t bench;
+        memset(&bench, 0, sizeof(bench));
+        bench.capacity = capacity;
+        
+        if (selected("queue-pingpong")) {
+            bench.iterations = iterations / 4;
+            report("queue-pingpong", label, measure_ping_pong, &bench, "ns/rt  ");
+        }
+        
+        if (selected("queue-stream")) {
+            bench.iterations = iterations;
+            report("queue-stream", label, measure_streaming, &bench, "ns/item");
+        }
+    }
+}
+
+/* ---------------- monitor_t ---------------- */
+
+typedef struct {
+    int iterations;
+    monitor_t ping;
+    monitor_t pong;
+    volatile double signaled_at;
+    double total_latency;
+} monitor_bench_t;
+
+static void* monitor_waiter(void* arg) {
+    monitor_bench_t* bench = (monitor_bench_t*)arg;
+    pin_thread(1);
+    
+    for (int i = 0; i < bench->iterations; i++) {
+        monitor_wait(&bench->ping);
+        bench->total_latency += now_ns() - bench->signaled_at;
+        monitor_reset(&bench->ping);
+        monitor_signal(&bench->pong);
+    }
+    return NULL;
+}
+
+// Time from monitor_signal until the waiting thread runs again, ns per wake-up
+static double measure_monitor_wake(void* arg) {
+    monitor_bench_t* bench = (monitor_bench_t*)arg;
+    monitor_init(&bench->ping);
+    monitor_init(&bench->pong);
+    bench->total_latency = 0;
+    
+    pthread_t thread;
+    pthread_create(&thread, NULL, monitor_waiter, bench);
+    
+    for (int i = 0; i < bench->iterations; i++) {
+        // Let the waiter block first so the wake-up is measured, not a latched signal
+        sched_yield();
+        monitor_reset(&bench->pong);
+        bench->signaled_at = now_ns();
+        monitor_signal(&bench->ping);
+        monitor_wait(&bench->pong);
+    }
+    pthread_join(thread, NULL);
+    
+    monitor_destroy(&bench->ping);
+    monitor_destroy(&bench->pong);
+    return bench->total_latency / bench->iterations;
+}
+
+static void bench_monitor(void) {
+    if (!selected("monitor-wake")) {
+        return;
+    }
+    
+    monitor_bench_t bench;
+    memset(&bench, 0, sizeof(bench));
+    bench.iterations = options.quick ? 500 : 20000;
+    report("monitor-wake", "signal->wait", measure_monitor_wake, &bench, "ns     ");
+}
+
+/* ---------------- plugin_transform ---------------- */
+
+typedef struct {
+    plugin_transform_func_t transform;
+    const char* line;
+    int length;
+    int iterations;
+} transform_bench_t;
+
+// ns per line
+static double measure_transform(void* arg) {
+    transform_bench_t* bench = (transform_bench_t*)arg;
+    
+    double start = now_ns();
+    // A plugin that only reads the line (logger) returns it as it is
+    for (int i = 0; i < bench->iterations; i++) {
+        const char* result = bench->transform(bench->line);
+        if (result != bench->line) {
+            free((void*)result);
+        }
+    }
+    return (now_ns() - start) / bench->iterations;
+}
+
+static void* open_plugin(const char* name) {
+    static const char* patterns[] = { "./%s.so", "output/%s.so", "./output/%s.so" };
+    char filename[256];
+    
+    for (int i = 0; i < 3; i++) {
+        snprintf(filename, sizeof(filename), patterns[i], name);
+        void* handle = dlopen(filename, RTLD_NOW | RTLD_LOCAL);
+        if (handle) {
+            return handle;
+        }
+    }
+    
+    fprintf(stderr, "Error loading plugin %s: %s\n", name, dlerror());
+    return NULL;
+}
+
+static void bench_transforms(void) {
+    // typewriter sleeps 100ms per character, so it is left out
+    static const char* plugins[] = { "uppercaser", "rotator", "flipper", "expander", "logger" };
+    static const int lengths[] = { 0, 1, 16, 64, 256, 1024, 4096, 16384, 65536 };
+    
+    char* line = (char*)malloc(BENCH_MAX_LENGTH + 1);
+    if (!line) {
+        return;
+    }
+    for (int i = 0; i < BENCH_MAX_LENGTH; i++) {
+        line[i] = "The quick brown fox jumps over the lazy dog 0123456789"[i % 54];
+    }
+    
+    for (int p = 0; p < (int)(sizeof(plugins) / sizeof(plugins[0])); p++) {
+        char group[64];
+        snprintf(group, sizeof(group), "transform-%s", plugins[p]);
+        if (!selected(group)) {
+            continue;
+        }
+        
+        void* handle = open_plugin(plugins[p]);
+        if (!handle) {
+            continue;
+        }
+        
+        transform_bench_t bench;
+        bench.transform = (plugin_transform_func_t)dlsym(handle, "plugin_transform");
+        if (!bench.transform) {
+            fprintf(stderr, "Error loading plugin_transform from %s: %s\n", plugins[p], dlerror());
+            dlclose(handle);
+            continue;
+        }
+        
+        // logger prints every line - measure the transform, not the terminal
+        int saved_stdout = -1;
+        if (strcmp(plugins[p], "logger") == 0) {
+            fflush(stdout);
+            saved_stdout = dup(STDOUT_FILENO);
+            int null_fd = open("/dev/null", O_WRONLY);
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+        
+        double results[sizeof(lengths) / sizeof(lengths[0])][2];
+        int num_lengths = 0;
+        for (int l = 0; l < (int)(sizeof(lengths) / sizeof(lengths[0])); l++) {
+            if (options.quick && lengths[l] > 4096) {
+                break;
+            }
+            
+            char saved = line[lengths[l]];
+            line[lengths[l]] = '\0';
+            bench.line = line;
+            bench.length = lengths[l];
+            bench.iterations = (options.quick ? (1 << 16) : (1 << 22)) / (lengths[l] + 64) + 10;
+            
+            // Printed afterwards, stdout may be redirected right now
+            sample(measure_transform, &bench, &results[l][0], &results[l][1]);
+            num_lengths++;
+            
+            line[lengths[l]] = saved;
+        }
+        
+        if (saved_stdout >= 0) {
+            fflush(stdout);
+            dup2(saved_stdout, STDOUT_FILENO);
+            close(saved_stdout);
+        }
+        
+        for (int l = 0; l < num_lengths; l++) {
+            char label[32];
+            snprintf(label, sizeof(label), "length=%d", lengths[l]);
+            printf("[BENCH] %-20s %-16s median %12.1f ns/line   min %12.1f ns/line   %8.1f MB/s\n",
+                   group, label, results[l][0], results[l][1],
+                   lengths[l] > 0 ? lengths[l] / results[l][0] * 1e3 : 0.0);
+        }
+        fflush(stdout);
+        dlclose(handle);
+    }
+    
+    free(line);
+}
+
+/* ---------------- UTF-8 mode ---------------- */
+
+typedef void (*plugin_set_utf8_func_t)(int);
+
+// Cost of UTF-8 mode: ASCII lines only add the SIMD check, other lines are decoded
+static void bench_utf8(void) {
+    static const char* plugins[] = { "uppercaser", "rotator", "flipper" };
+    static const int lengths[] = { 64, 256, 4096 };
+    static const char* text = "Gr\xc3\xbc\xc3\x9f \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d \xd0\xbc\xd0\xb8\xd1\x80 ";
+    
+    char* ascii = (char*)malloc(BENCH_MAX_LENGTH + 1);
+    char* other = (char*)malloc(BENCH_MAX_LENGTH + 1);
+    if (!ascii || !other) {
+        free(ascii);
+        free(other);
+        return;
+    }
+    
+    // The non-ASCII line repeats whole characters only, so it stays valid UTF-8 when cut at a repeat
+    size_t text_length = strlen(text);
+    for (int i = 0; i < BENCH_MAX_LENGTH; i++) {
+        ascii[i] = "The quick brown fox jumps over the lazy dog 0123456789"[i % 54];
+        other[i] = text[i % text_length];
+    }
+    
+    for (int p = 0; p < (int)(sizeof(plugins) / sizeof(plugins[0])); p++) {
+        char group[64];
+        snprintf(group, sizeof(group), "utf8-%s", plugins[p]);
+        if (!selected(group)) {
+            continue;
+        }
+        
+        void* handle = open_plugin(plugins[p]);
+        if (!handle) {
+            continue;
+        }
+        
+        transform_bench_t bench;
+        bench.transform = (plugin_transform_func_t)dlsym(handle, "plugin_transform");
+        plugin_set_utf8_func_t set_utf8 = (plugin_set_utf8_func_t)dlsym(handle, "plugin_set_utf8");
+        if (!bench.transform || !set_utf8) {
+            fprintf(stderr, "Error loading the UTF-8 mode of %s: %s\n", plugins[p], dlerror());
+            dlclose(handle);
+            continue;
+        }
+        
+        for (int l = 0; l < (int)(sizeof(lengths) / sizeof(lengths[0])); l++) {
+            int length = lengths[l] - lengths[l] % (int)text_length;
+            bench.length = length;
+            bench.iterations = (options.quick ? (1 << 16) : (1 << 22)) / (length + 64) + 10;
+            
+            // ASCII lines in byte mode, the same lines in UTF-8 mode, then a line that has to be decoded
+            double bytes_median, bytes_min, ascii_median, ascii_min, other_median, other_min;
+            char saved = ascii[length];
+            ascii[length] = '\0';
+            bench.line = ascii;
+            set_utf8(0);
+            sample(measure_transform, &bench, &bytes_median, &bytes_min);
+            set_utf8(1);
+            sample(measure_transform, &bench, &ascii_median, &ascii_min);
+            ascii[length] = saved;
+            
+            saved = other[length];
+            other[length] = '\0';
+            bench.line = other;
+            sample(measure_transform, &bench, &other_median, &other_min);
+            other[length] = saved;
+            set_utf8(0);
+            
+            printf("[BENCH] %-20s length=%-9d bytes %10.1f ns/line   utf8 ascii %10.1f ns/line (%+5.1f%%)   utf8 other %10.1f ns/line\n",
+                   group, length, bytes_median, ascii_median, (ascii_median / bytes_median - 1) * 100.0, other_median);
+        }
+        fflush(stdout);
+        dlclose(handle);
+    }
+    
+    free(ascii);
+    free(other);
+}
+
+void print_usage(const char* program_name) {
+    printf("Usage: %s [--reps N] [--cpu N] [--quick] [--filter GROUP]\n", program_name);
+    printf("Options:\n");
+    printf("  --reps N       Measured repetitions per benchmark, after one warm-up run (default 5)\n");
+    printf("  --cpu N        Pin to CPU N (and N+1 for the second thread), -1 disables pinning (default 0)\n");
+    printf("  --quick        Fewer iterations, capacities and lengths\n");
+    printf("  --filter GROUP Only run groups starting with GROUP (queue, monitor, transform, transform-flipper, utf8, ...)\n");
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            options.quick = 1;
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            options.repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            options.cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (options.repetitions <= 0) {
+        fprintf(stderr, "Error: Invalid number of repetitions\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    pin_thread(0);
+    bench_queue();
+    bench_monitor();
+    bench_transforms();
+    bench_utf8();
+    return 0;
+}
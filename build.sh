@@ -27,13 +27,29 @@ mkdir -p output
 
 # Build main application
 print_status "Building main application..."
-gcc -o output/analyzer main.c -ldl -lpthread || {
+gcc -o output/analyzer main.c \
+    host/thread_pool.c \
+    host/executor.c \
+    host/ingest.c \
+    host/server.c \
+    host/compose.c \
+    host/memo.c \
+    host/priority.c \
+    host/trace_export.c \
+    host/multiprocess.c \
+    host/shm_ring.c \
+    host/capture.c \
+    host/autoscale.c \
+    host/overload.c \
+    host/tap.c \
+    plugins/sync/trace.c \
+    -ldl -lpthread || {
     print_error "Failed to build main application"
     exit 1
 }
 
 # List of plugins to build
-plugins="logger typewriter uppercaser rotator flipper expander"
+plugins="logger typewriter uppercaser rotator flipper expander filter"
 
 # Build each plugin
 print_status "Building the plugins..."
@@ -42,13 +58,30 @@ for plugin_name in $plugins; do
     gcc -fPIC -shared -o output/${plugin_name}.so \
         plugins/${plugin_name}.c \
         plugins/plugin_common.c \
+        plugins/perf_counters.c \
+        plugins/utf8.c \
         plugins/sync/monitor.c \
         plugins/sync/consumer_producer.c \
+        plugins/sync/spill.c \
+        plugins/sync/trace.c \
         -ldl -lpthread || {
         print_error "Failed to build $plugin_name"
         exit 1
     }
 done
 
+# Optional targets
+if [ "$1" = "microbench" ]; then
+    print_status "Building microbenchmarks..."
+    gcc -o output/microbench bench/microbench.c \
+        plugins/sync/monitor.c \
+        plugins/sync/consumer_producer.c \
+        plugins/sync/spill.c \
+        -ldl -lpthread || {
+        print_error "Failed to build microbenchmarks"
+        exit 1
+    }
+fi
+
 print_status "Build completed successfully!"
 print_status "Plugins built: $plugins"
\ No newline at end of file
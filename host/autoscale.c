@@ -0,0 +1,239 @@
+#include "autoscale.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static long long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Only plugins that describe themselves as a pure transform keep no state between items
+static int is_stateless(plugin_handle_t* plugin) {
+    if (!plugin->get_descriptor || !plugin->set_max_workers || !plugin->scale_workers || !plugin->blocked_ns) {
+        return 0;
+    }
+    
+    const plugin_descriptor_t* descriptor = plugin->get_descriptor();
+    return descriptor && descriptor->kind != TRANSFORM_OPAQUE;
+}
+
+const char* autoscale_init(autoscaler_t* autoscaler, plugin_handle_t* plugins, int num_plugins, int budget) {
+    memset(autoscaler, 0, sizeof(*autoscaler));
+    if (!plugins || num_plugins <= 0) {
+        return "Invalid parameters entered to autoscale_init";
+    }
+    
+    if (budget < num_plugins) {
+        return "Thread budget is smaller than the number of plugins";
+    }
+    
+    autoscaler->stages = (autoscale_stage_t*)calloc(num_plugins, sizeof(autoscale_stage_t));
+    if (!autoscaler->stages) {
+        return "Failed to allocate memory for stages";
+    }
+    
+    autoscaler->num_stages = num_plugins;
+    autoscaler->budget = budget;
+    autoscaler->threads = num_plugins;
+    autoscaler->peak_threads = num_plugins;
+    
+    // Every stage starts with one thread, an elastic one may take the whole rest of the budget
+    for (int i = 0; i < num_plugins; i++) {
+        autoscale_stage_t* stage = &autoscaler->stages[i];
+        stage->plugin = &plugins[i];
+        stage->workers = 1;
+        stage->peak_workers = 1;
+        stage->scalable = is_stateless(&plugins[i]);
+        if (stage->scalable) {
+            plugins[i].set_max_workers(budget - num_plugins + 1);
+        }
+    }
+    return NULL;
+}
+
+// Change the threads of a stage and log the decision
+static void scale_stage(autoscaler_t* autoscaler, autoscale_stage_t* stage, int workers, int pending, double blocked) {
+    int scaled = stage->plugin->scale_workers(workers);
+    if (scaled <= 0 || scaled == stage->workers) {
+        return;
+    }
+    
+    fprintf(stderr, "[INFO][autoscale] - %s: %d -> %d workers (queue %d/%d, producers blocked %.0f%%)\n",
+            stage->plugin->name, stage->workers, scaled, pending, autoscaler->queue_size, blocked * 100.0);
+    
+    if (scaled > stage->workers) {
+        stage->ups += scaled - stage->workers;
+    } else {
+        stage->downs += stage->workers - scaled;
+    }
+    autoscaler->threads += scaled - stage->workers;
+    if (autoscaler->threads > autoscaler->peak_threads) {
+        autoscaler->peak_threads = autoscaler->threads;
+    }
+    stage->workers = scaled;
+    if (scaled > stage->peak_workers) {
+        stage->peak_workers = scaled;
+    }
+    
+    stage->hot = 0;
+    stage->cold = 0;
+    stage->cooldown = AUTOSCALE_COOLDOWN_SAMPLES;
+}
+
+// Sample every stage once and scale the ones that stayed hot or cold long enough
+static void sample(autoscaler_t* autoscaler, long long interval_ns) {
+    int pending[autoscaler->num_stages];
+    double blocked[autoscaler->num_stages];
+    for (int i = 0; i < autoscaler->num_stages; i++) {
+        autoscale_stage_t* stage = &autoscaler->stages[i];
+        pending[i] = stage->plugin->pending ? stage->plugin->pending() : 0;
+        
+        unsigned long long blocked_ns = stage->plugin->blocked_ns ? stage->plugin->blocked_ns() : 0;
+        blocked[i] = interval_ns > 0 ? (double)(blocked_ns - stage->blocked_ns) / interval_ns : 0;
+        stage->blocked_ns = blocked_ns;
+    }
+    
+    // At most one thread is added per sample, to the stage under the most pressure
+    autoscale_stage_t* hottest = NULL;
+    double hottest_pressure = 0;
+    int hottest_index = 0;
+    
+    for (int i = 0; i < autoscaler->num_stages; i++) {
+        autoscale_stage_t* stage = &autoscaler->stages[i];
+        if (!stage->scalable) {
+            continue;
+        }
+        
+        // A stage whose output waits for a full downstream queue is not what holds the chain up
+        double occupancy = (double)pending[i] / autoscaler->queue_size;
+        int held_up = i + 1 < autoscaler->num_stages && pending[i + 1] >= autoscaler->queue_size;
+        int hot = !held_up && (occupancy >= AUTOSCALE_UP_OCCUPANCY || blocked[i] >= AUTOSCALE_UP_BLOCKED);
+        int cold = occupancy < AUTOSCALE_DOWN_OCCUPANCY && blocked[i] == 0;
+        
+        stage->hot = hot ? stage->hot + 1 : 0;
+        stage->cold = cold ? stage->cold + 1 : 0;
+        if (stage->cooldown > 0) {
+            stage->cooldown--;
+            continue;
+        }
+        
+        if (stage->cold >= AUTOSCALE_DOWN_SAMPLES && stage->workers > 1) {
+            scale_stage(autoscaler, stage, stage->workers - 1, pending[i], blocked[i]);
+            continue;
+        }
+        
+        double pressure = occupancy > blocked[i] ? occupancy : blocked[i];
+        if (stage->hot >= AUTOSCALE_UP_SAMPLES && (!hottest || pressure > hottest_pressure)) {
+            hottest = stage;
+            hottest_pressure = pressure;
+            hottest_index = i;
+        }
+    }
+    
+    if (hottest && autoscaler->threads < autoscaler->budget) {
+        scale_stage(autoscaler, hottest, hottest->workers + 1, pending[hottest_index], blocked[hottest_index]);
+    }
+}
+
+static void* controller_thread(void* arg) {
+    autoscaler_t* autoscaler = (autoscaler_t*)arg;
+    long long last = now_ns();
+    
+    pthread_mutex_lock(&autoscaler->mutex);
+    while (!autoscaler->stopping) {
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        until.tv_nsec += AUTOSCALE_INTERVAL_MS * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        
+        int result = 0;
+        while (!autoscaler->stopping && result != ETIMEDOUT) {
+            result = pthread_cond_timedwait(&autoscaler->wake, &autoscaler->mutex, &until);
+        }
+        if (autoscaler->stopping) {
+            break;
+        }
+        pthread_mutex_unlock(&autoscaler->mutex);
+        
+        long long now = now_ns();
+        sample(autoscaler, now - last);
+        last = now;
+        
+        pthread_mutex_lock(&autoscaler->mutex);
+    }
+    pthread_mutex_unlock(&autoscaler->mutex);
+    return NULL;
+}
+
+const char* autoscale_start(autoscaler_t* autoscaler, int queue_size) {
+    if (!autoscaler || !autoscaler->stages || queue_size <= 0) {
+        return "Invalid parameters entered to autoscale_start";
+    }
+    
+    autoscaler->queue_size = queue_size;
+    autoscaler->stopping = 0;
+    
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&autoscaler->wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&autoscaler->mutex, NULL);
+    
+    if (pthread_create(&autoscaler->thread, NULL, controller_thread, autoscaler) != 0) {
+        pthread_cond_destroy(&autoscaler->wake);
+        pthread_mutex_destroy(&autoscaler->mutex);
+        return "Failed to create controller thread";
+    }
+    
+    autoscaler->running = 1;
+    return NULL;
+}
+
+void autoscale_stop(autoscaler_t* autoscaler) {
+    if (!autoscaler->running) {
+        return;
+    }
+    
+    pthread_mutex_lock(&autoscaler->mutex);
+    autoscaler->stopping = 1;
+    pthread_cond_signal(&autoscaler->wake);
+    pthread_mutex_unlock(&autoscaler->mutex);
+    
+    pthread_join(autoscaler->thread, NULL);
+    pthread_cond_destroy(&autoscaler->wake);
+    pthread_mutex_destroy(&autoscaler->mutex);
+    autoscaler->running = 0;
+}
+
+void autoscale_report(autoscaler_t* autoscaler) {
+    if (!autoscaler->stages) {
+        return;
+    }
+    
+    for (int i = 0; i < autoscaler->num_stages; i++) {
+        autoscale_stage_t* stage = &autoscaler->stages[i];
+        if (stage->scalable) {
+            fprintf(stderr, "[STATS][autoscale] - %s: %lu added, %lu retired, peak %d workers, ended with %d\n",
+                    stage->plugin->name, stage->ups, stage->downs, stage->peak_workers, stage->workers);
+        } else {
+            fprintf(stderr, "[STATS][autoscale] - %s: stateful, peak %d workers\n",
+                    stage->plugin->name, stage->peak_workers);
+        }
+    }
+    
+    fprintf(stderr, "[STATS][autoscale] - peak %d of %d threads\n", autoscaler->peak_threads, autoscaler->budget);
+}
+
+void autoscale_destroy(autoscaler_t* autoscaler) {
+    autoscale_stop(autoscaler);
+    free(autoscaler->stages);
+    autoscaler->stages = NULL;
+}
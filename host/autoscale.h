@@ -0,0 +1,100 @@
+#ifndef AUTOSCALE_H
+#define AUTOSCALE_H
+
+#include <pthread.h>
+#include "plugin_host.h"
+
+/** 
+ * Elastic stage scaling 
+ * A controller thread samples the queue of every stage: how full it is and how long its 
+ * producers were blocked since the last sample. A stateless stage that stays under pressure 
+ * while its own output is not held up gets another consumer thread, a stage that stays idle 
+ * gives one back. Scaling up needs several hot samples in a row and scaling down many more 
+ * cold ones, and a stage that was just scaled is left alone for a while, so the thread count 
+ * does not flap. All stages together never use more threads than the budget. 
+ */
+
+// Time between two samples
+#define AUTOSCALE_INTERVAL_MS 10
+
+// A stage is hot at this queue fill level, or when its producers were blocked this share of the time
+#define AUTOSCALE_UP_OCCUPANCY 0.75
+#define AUTOSCALE_UP_BLOCKED 0.25
+
+// A stage is cold below this queue fill level, with no producer blocked
+#define AUTOSCALE_DOWN_OCCUPANCY 0.25
+
+// Hot or cold samples in a row before a stage is scaled
+#define AUTOSCALE_UP_SAMPLES 3
+#define AUTOSCALE_DOWN_SAMPLES 20
+
+// Samples a stage is left alone after it was scaled
+#define AUTOSCALE_COOLDOWN_SAMPLES 5
+
+typedef struct
+{
+    plugin_handle_t* plugin;                 /* Stage */
+    int scalable;                            /* Stateless, runs on elastic consumer threads */
+    int workers;                             /* Consumer threads now */
+    int peak_workers;                        /* Most consumer threads */
+    int hot;                                 /* Hot samples in a row */
+    int cold;                                /* Cold samples in a row */
+    int cooldown;                            /* Samples left before the stage may be scaled again */
+    unsigned long long blocked_ns;           /* Producer blocked time at the last sample */
+    unsigned long ups;                       /* Threads added */
+    unsigned long downs;                     /* Threads retired */
+} autoscale_stage_t;
+
+typedef struct
+{
+    autoscale_stage_t* stages;               /* One per plugin, in chain order */
+    int num_stages;                          /* Number of stages */
+    int queue_size;                          /* Capacity of every queue */
+    int budget;                              /* Most threads of all stages together */
+    int threads;                             /* Threads of all stages now */
+    int peak_threads;                        /* Most threads of all stages together */
+    pthread_t thread;                        /* Controller thread */
+    int running;                             /* thread is running */
+    int stopping;                            /* Asks the controller to return */
+    pthread_mutex_t mutex;                   /* Protects stopping */
+    pthread_cond_t wake;                     /* Wakes the controller when it is stopped */
+} autoscaler_t;
+
+/** 
+ * Pick the stages that may be scaled and make them elastic - must be called before the plugins 
+ * are initialized 
+ * @param autoscaler Pointer to autoscaler structure 
+ * @param plugins Loaded plugins, in chain order 
+ * @param num_plugins Number of plugins 
+ * @param budget Most threads of all stages together (at least one per plugin) 
+ * @return NULL on success, error message on failure 
+ */
+const char* autoscale_init(autoscaler_t* autoscaler, plugin_handle_t* plugins, int num_plugins, int budget);
+
+/** 
+ * Start the controller thread - call once the plugins are initialized and attached 
+ * @param autoscaler Pointer to autoscaler structure 
+ * @param queue_size Capacity of every queue 
+ * @return NULL on success, error message on failure 
+ */
+const char* autoscale_start(autoscaler_t* autoscaler, int queue_size);
+
+/** 
+ * Stop the controller thread - must be called before the plugins are finalized 
+ * @param autoscaler Pointer to autoscaler structure 
+ */
+void autoscale_stop(autoscaler_t* autoscaler);
+
+/** 
+ * Print the scaling decisions of every elastic stage, and the workers of every stateful one 
+ * @param autoscaler Pointer to autoscaler structure 
+ */
+void autoscale_report(autoscaler_t* autoscaler);
+
+/** 
+ * Free the stages 
+ * @param autoscaler Pointer to autoscaler structure 
+ */
+void autoscale_destroy(autoscaler_t* autoscaler);
+
+#endif
@@ -0,0 +1,271 @@
+#include "capture.h"
+#include "priority.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The ingest paths record through a plain function, so they find the open capture here
+static capture_t* active_capture = NULL;
+
+static long long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Write value as an LEB128 varint, returns the number of bytes written (0 on failure)
+static size_t write_varint(FILE* file, unsigned long long value) {
+    unsigned char bytes[10];
+    size_t length = 0;
+    do {
+        bytes[length] = value & 0x7f;
+        value >>= 7;
+        if (value) {
+            bytes[length] |= 0x80;
+        }
+        length++;
+    } while (value);
+    
+    return fwrite(bytes, 1, length, file) == length ? length : 0;
+}
+
+// Read an LEB128 varint, returns 0 on success, 1 at the end of the file, -1 on a truncated value
+static int read_varint(FILE* file, unsigned long long* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return shift == 0 ? 1 : -1;
+        }
+        
+        *value |= (unsigned long long)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* capture_open(capture_t* capture, const char* path) {
+    memset(capture, 0, sizeof(*capture));
+    capture->file = fopen(path, "wb");
+    if (!capture->file) {
+        return "Failed to create capture file";
+    }
+    
+    if (fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_LENGTH, capture->file) != CAPTURE_MAGIC_LENGTH) {
+        fclose(capture->file);
+        capture->file = NULL;
+        return "Failed to write capture file";
+    }
+    
+    capture->path = path;
+    capture->bytes = CAPTURE_MAGIC_LENGTH;
+    active_capture = capture;
+    return NULL;
+}
+
+void capture_record(const char* line) {
+    capture_t* capture = active_capture;
+    if (!capture || capture->failed || strcmp(line, "<END>") == 0) {
+        return;
+    }
+    
+    // The first line starts the recording, so a replay does not wait for the idle time before it
+    long long now = now_ns();
+    unsigned long long gap = capture->last_ns ? now - capture->last_ns : 0;
+    capture->last_ns = now;
+    
+    size_t length = strlen(line);
+    size_t gap_bytes = write_varint(capture->file, gap);
+    size_t length_bytes = gap_bytes ? write_varint(capture->file, length) : 0;
+    if (!length_bytes || fwrite(line, 1, length, capture->file) != length) {
+        fprintf(stderr, "[ERROR][capture] - write to %s failed, recording stopped\n", capture->path);
+        capture->failed = 1;
+        return;
+    }
+    
+    capture->lines++;
+    capture->bytes += gap_bytes + length_bytes + length;
+}
+
+void capture_close(capture_t* capture) {
+    if (!capture->file) {
+        return;
+    }
+    
+    if (active_capture == capture) {
+        active_capture = NULL;
+    }
+    
+    if (fclose(capture->file) != 0 && !capture->failed) {
+        fprintf(stderr, "[ERROR][capture] - write to %s failed\n", capture->path);
+    }
+    capture->file = NULL;
+    
+    fprintf(stderr, "[STATS][capture] - %lu lines captured to %s, %zu bytes\n",
+            capture->lines, capture->path, capture->bytes);
+}
+
+const char* replay_open(replay_t* replay, const char* path, double speed) {
+    memset(replay, 0, sizeof(*replay));
+    replay->file = fopen(path, "rb");
+    if (!replay->file) {
+        return "Failed to open capture file";
+    }
+    
+    char magic[CAPTURE_MAGIC_LENGTH];
+    if (fread(magic, 1, CAPTURE_MAGIC_LENGTH, replay->file) != CAPTURE_MAGIC_LENGTH ||
+        memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH) != 0) {
+        fclose(replay->file);
+        replay->file = NULL;
+        return "Not a capture file";
+    }
+    
+    replay->speed = speed;
+    return NULL;
+}
+
+// Sleep until the monotonic time deadline (in nanoseconds)
+static void sleep_until(long long deadline) {
+    struct timespec until;
+    until.tv_sec = deadline / 1000000000LL;
+    until.tv_nsec = deadline % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+}
+
+static void sample_queues(replay_t* replay, plugin_handle_t* queues) {
+    for (int i = 0; i < replay->num_queues; i++) {
+        int count = queues[i].pending ? queues[i].pending() : 0;
+        replay_queue_t* queue = &replay->queues[i];
+        queue->total += count;
+        if (count > queue->max) {
+            queue->max = count;
+        }
+        if (count >= replay->queue_size) {
+            queue->full++;
+        }
+    }
+    replay->samples++;
+}
+
+const char* replay_run(replay_t* replay, plugin_handle_t* first, plugin_handle_t* queues, int num_queues, int queue_size) {
+    if (!replay || !replay->file || !first || !first->place_work_meta) {
+        return "Invalid parameters entered to replay_run";
+    }
+    
+    replay->queues = (replay_queue_t*)calloc(num_queues > 0 ? num_queues : 1, sizeof(replay_queue_t));
+    if (!replay->queues) {
+        return "Failed to allocate memory for queue statistics";
+    }
+    for (int i = 0; i < num_queues; i++) {
+        replay->queues[i].name = queues[i].name;
+    }
+    replay->num_queues = num_queues;
+    replay->queue_size = queue_size;
+    
+    char* line = NULL;
+    size_t line_capacity = 0;
+    const char* error = NULL;
+    long long start = now_ns();
+    double offset_ns = 0;
+    
+    while (1) {
+        unsigned long long gap;
+        unsigned long long length;
+        int status = read_varint(replay->file, &gap);
+        if (status == 1) {
+            break;
+        }
+        if (status < 0 || read_varint(replay->file, &length) != 0 || length > CAPTURE_LINE_MAX) {
+            error = "Capture file is truncated or corrupt";
+            break;
+        }
+        
+        if (length + 1 > line_capacity) {
+            char* grown = (char*)realloc(line, length + 1);
+            if (!grown) {
+                error = "Failed to allocate memory for a replayed line";
+                break;
+            }
+            line = grown;
+            line_capacity = length + 1;
+        }
+        
+        if (fread(line, 1, length, replay->file) != length) {
+            error = "Capture file is truncated or corrupt";
+            break;
+        }
+        line[length] = '\0';
+        
+        // Keep the recorded gaps, scaled by the speed factor
+        offset_ns += gap;
+        long long due = start;
+        if (replay->speed > 0) {
+            due = start + (long long)(offset_ns / replay->speed);
+            if (now_ns() < due) {
+                sleep_until(due);
+            }
+        }
+        
+        work_meta_t meta = {0};
+        priority_stamp(line, NULL, &meta);
+        error = first->place_work_meta(line, &meta);
+        if (error) {
+            break;
+        }
+        
+        // A full first queue blocks the placement, which puts the replay behind schedule
+        double lag = replay->speed > 0 ? (double)(now_ns() - due) : 0;
+        replay->lag_total_ns += lag;
+        if (lag > replay->lag_max_ns) {
+            replay->lag_max_ns = lag;
+        }
+        
+        replay->lines++;
+        replay->bytes += length;
+        sample_queues(replay, queues);
+    }
+    
+    free(line);
+    replay->captured_ns = offset_ns;
+    replay->elapsed_ns = now_ns() - start;
+    return error;
+}
+
+void replay_report(replay_t* replay) {
+    if (!replay->queues) {
+        return;
+    }
+    
+    char speed[32];
+    if (replay->speed > 0) {
+        snprintf(speed, sizeof(speed), "%gx", replay->speed);
+    } else {
+        snprintf(speed, sizeof(speed), "max speed");
+    }
+    
+    fprintf(stderr, "[STATS][replay] - %lu lines (%zu bytes) spanning %.1f ms replayed in %.1f ms at %s, "
+            "behind schedule avg %.1f us max %.1f us\n",
+            replay->lines, replay->bytes, replay->captured_ns / 1e6, replay->elapsed_ns / 1e6, speed,
+            replay->lines > 0 ? replay->lag_total_ns / replay->lines / 1000.0 : 0.0, replay->lag_max_ns / 1000.0);
+    
+    for (int i = 0; i < replay->num_queues && replay->samples > 0; i++) {
+        replay_queue_t* queue = &replay->queues[i];
+        fprintf(stderr, "[STATS][replay] - %s queue: avg %.1f items, max %d of %d, full in %.1f%% of samples\n",
+                queue->name, queue->total / replay->samples, queue->max, replay->queue_size,
+                100.0 * queue->full / replay->samples);
+    }
+}
+
+void replay_close(replay_t* replay) {
+    if (replay->file) {
+        fclose(replay->file);
+        replay->file = NULL;
+    }
+    free(replay->queues);
+    replay->queues = NULL;
+    replay->num_queues = 0;
+}
@@ -0,0 +1,111 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "plugin_host.h"
+
+/** 
+ * Traffic capture and timed replay 
+ * A capture records every line that enters the pipeline (from stdin, the --input streams or the 
+ * clients) together with the time it arrived. The file starts with CAPTURE_MAGIC, followed by 
+ * one record per line: the nanoseconds since the previous line and the line length, both as 
+ * LEB128 varints, then the line bytes. <END> markers are not recorded. 
+ * A replay feeds a capture back into the first plugin with the recorded gaps, scaled by a speed 
+ * factor (or without any gaps), and samples the queue fill levels as it goes. 
+ */
+
+#define CAPTURE_MAGIC "PIPECAP1"
+#define CAPTURE_MAGIC_LENGTH 8
+
+// Longest line a replay accepts, anything longer means the file is corrupt
+#define CAPTURE_LINE_MAX (1024 * 1024)
+
+typedef struct
+{
+    FILE* file;                              /* Capture file (NULL = not capturing) */
+    const char* path;                        /* Path given on the command line */
+    long long last_ns;                       /* Arrival of the previous line (0 = none yet) */
+    unsigned long lines;                     /* Lines recorded */
+    size_t bytes;                            /* Bytes written, header included */
+    int failed;                              /* A write failed, nothing more is recorded */
+} capture_t;
+
+typedef struct
+{
+    const char* name;                        /* Plugin that owns the queue */
+    double total;                            /* Sum of all sampled fill levels */
+    int max;                                 /* Fullest level seen */
+    unsigned long full;                      /* Samples that found the queue full */
+} replay_queue_t;
+
+typedef struct
+{
+    FILE* file;                              /* Capture being replayed */
+    double speed;                            /* Speed factor (0 = as fast as possible) */
+    unsigned long lines;                     /* Lines replayed */
+    size_t bytes;                            /* Line bytes replayed */
+    double captured_ns;                      /* Time span of the capture */
+    double elapsed_ns;                       /* Time the replay took */
+    double lag_total_ns;                     /* Sum of how late every line was placed */
+    double lag_max_ns;                       /* Latest placement */
+    replay_queue_t* queues;                  /* Fill level statistics of each sampled queue */
+    int num_queues;                          /* Number of sampled queues */
+    int queue_size;                          /* Capacity of every queue */
+    unsigned long samples;                   /* Samples taken of every queue */
+} replay_t;
+
+/** 
+ * Create a capture file and start recording 
+ * @param capture Pointer to capture structure 
+ * @param path Capture file (created or truncated) 
+ * @return NULL on success, error message on failure 
+ */
+const char* capture_open(capture_t* capture, const char* path);
+
+/** 
+ * Record a line that is about to enter the pipeline - does nothing unless a capture is open 
+ * @param line Line as placed into the first plugin 
+ */
+void capture_record(const char* line);
+
+/** 
+ * Stop recording, report and close the file 
+ * @param capture Pointer to capture structure 
+ */
+void capture_close(capture_t* capture);
+
+/** 
+ * Open a capture file for replay 
+ * @param replay Pointer to replay structure 
+ * @param path Capture file 
+ * @param speed Speed factor, 1 replays in real time (0 = as fast as possible) 
+ * @return NULL on success, error message on failure 
+ */
+const char* replay_open(replay_t* replay, const char* path, double speed);
+
+/** 
+ * Place every recorded line into the first plugin on its schedule 
+ * Does not send the final <END> that shuts the pipeline down 
+ * @param replay Pointer to replay structure 
+ * @param first First plugin of the chain 
+ * @param queues Plugins whose queue fill levels are sampled after every line 
+ * @param num_queues Number of sampled plugins 
+ * @param queue_size Capacity of every queue 
+ * @return NULL on success, error message on failure 
+ */
+const char* replay_run(replay_t* replay, plugin_handle_t* first, plugin_handle_t* queues, int num_queues, int queue_size);
+
+/** 
+ * Print the replay timing and the queue fill levels 
+ * @param replay Pointer to replay structure 
+ */
+void replay_report(replay_t* replay);
+
+/** 
+ * Close the capture file and free the statistics 
+ * @param replay Pointer to replay structure 
+ */
+void replay_close(replay_t* replay);
+
+#endif
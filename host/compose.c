@@ -0,0 +1,410 @@
+#include "compose.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A plugin can be fused if it exports a descriptor of a known primitive and accepts a kernel
+static const plugin_descriptor_t* fusable_descriptor(plugin_handle_t* plugin) {
+    if (!plugin->get_descriptor || !plugin->set_process_override) {
+        return NULL;
+    }
+    
+    const plugin_descriptor_t* descriptor = plugin->get_descriptor();
+    if (!descriptor) {
+        return NULL;
+    }
+    
+    switch (descriptor->kind) {
+        case TRANSFORM_MAP:
+            return descriptor->map ? descriptor : NULL;
+        case TRANSFORM_PERMUTE:
+            return descriptor->source_index ? descriptor : NULL;
+        case TRANSFORM_EXPAND:
+            return descriptor->source_index && descriptor->output_length ? descriptor : NULL;
+        default:
+            return NULL;
+    }
+}
+
+// Length of the line after every stage of the run (lengths[0] is the input length)
+static void stage_lengths(compose_kernel_t* kernel, int length, int* lengths) {
+    lengths[0] = length;
+    for (int k = 0; k < kernel->num_stages; k++) {
+        const plugin_descriptor_t* stage = kernel->stages[k];
+        lengths[k + 1] = stage->kind == TRANSFORM_EXPAND ? stage->output_length(lengths[k]) : lengths[k];
+    }
+}
+
+// Gather index for one input length: >= 0 is an input position, < 0 encodes a literal byte as -(byte + 1)
+static int* build_index(compose_kernel_t* kernel, int length, int* output_length) {
+    int lengths[kernel->num_stages + 1];
+    stage_lengths(kernel, length, lengths);
+    *output_length = lengths[kernel->num_stages];
+    
+    int* index = (int*)malloc((*output_length + 1) * sizeof(int));
+    if (!index) {
+        return NULL;
+    }
+    
+    for (int i = 0; i < *output_length; i++) {
+        // Walk back through the run to the input byte this output byte comes from
+        int position = i;
+        for (int k = kernel->num_stages - 1; k >= 0; k--) {
+            const plugin_descriptor_t* stage = kernel->stages[k];
+            if (stage->kind == TRANSFORM_MAP) {
+                continue;
+            }
+            
+            position = stage->source_index(position, lengths[k]);
+            if (position < 0) {
+                // Inserted by this stage - only the maps after it still apply
+                position = -(kernel->fill_maps[k * 256 + stage->fill] + 1);
+                break;
+            }
+        }
+        index[i] = position;
+    }
+    
+    return index;
+}
+
+// One pass over the line: byte table lookup through the gather index
+static char* apply_kernel(compose_kernel_t* kernel, const char* input, int length) {
+    const unsigned char* bytes = (const unsigned char*)input;
+    
+    // Only byte maps - one table lookup per byte
+    if (!kernel->has_gather) {
+        char* result = malloc(length + 1);
+        if (!result) {
+            return NULL;
+        }
+        
+        for (int i = 0; i < length; i++) {
+            result[i] = kernel->map[bytes[i]];
+        }
+        result[length] = '\0';
+        return result;
+    }
+    
+    // A slot holds the index of the last length that used it, so the cache stays a few indexes
+    // big however many lengths come along
+    int output_length;
+    int* index;
+    int cached = length > 0 && length < COMPOSE_CACHED_LENGTHS;
+    compose_index_t* slot = &kernel->indexes[length % COMPOSE_INDEX_SLOTS];
+    if (cached && slot->length == length) {
+        index = slot->index;
+        output_length = slot->output_length;
+    } else {
+        index = build_index(kernel, length, &output_length);
+        if (!index) {
+            return NULL;
+        }
+        
+        // Only the plugin's own thread runs the kernel, so the cache needs no lock
+        if (cached) {
+            free(slot->index);
+            slot->length = length;
+            slot->output_length = output_length;
+            slot->index = index;
+        }
+    }
+    
+    char* result = malloc(output_length + 1);
+    if (result) {
+        for (int i = 0; i < output_length; i++) {
+            int source = index[i];
+            result[i] = source >= 0 ? kernel->map[bytes[source]] : (char)(-source - 1);
+        }
+        result[output_length] = '\0';
+    }
+    
+    if (!cached) {
+        free(index);
+    }
+    
+    return result;
+}
+
+// Run the kernels of a run one after the other, showing each output to the taps behind it
+static char* apply_run(compose_kernel_t* kernel, const char* input, int length) {
+    char* result = apply_kernel(kernel, input, length);
+    while (result && kernel->next) {
+        for (int t = 0; t < kernel->num_taps; t++) {
+            kernel->taps[t](result, NULL);
+        }
+        
+        kernel = kernel->next;
+        char* next = apply_kernel(kernel, result, strlen(result));
+        free(result);
+        result = next;
+    }
+    return result;
+}
+
+// Process override installed into the first plugin of a fused run
+static const char* run_kernel(void* arg, const char* input) {
+    compose_kernel_t* kernel = (compose_kernel_t*)arg;
+    if (!input) {
+        return NULL;
+    }
+    
+    int length = strlen(input);
+    if (!kernel->memo) {
+        return apply_run(kernel, input, length);
+    }
+    
+    // A repeated line skips the run and forwards a copy of the remembered result
+    size_t cached_length;
+    unsigned long long hash;
+    const char* cached = memo_lookup(kernel->memo, input, length, &cached_length, &hash);
+    if (cached) {
+        char* result = malloc(cached_length + 1);
+        if (result) {
+            memcpy(result, cached, cached_length + 1);
+        }
+        return result;
+    }
+    
+    char* result = apply_kernel(kernel, input, length);
+    if (result) {
+        memo_insert(kernel->memo, hash, input, length, result, strlen(result));
+    }
+    return result;
+}
+
+static const char* kernel_init(compose_kernel_t* kernel, plugin_handle_t* plugins,
+                               const plugin_descriptor_t** stages, int num_stages, size_t memo_limit) {
+    memset(kernel, 0, sizeof(*kernel));
+    kernel->stages = (const plugin_descriptor_t**)malloc(num_stages * sizeof(plugin_descriptor_t*));
+    kernel->fill_maps = (unsigned char*)malloc(num_stages * 256);
+    if (!kernel->stages || !kernel->fill_maps) {
+        return "Failed to allocate memory for fused kernel";
+    }
+    
+    size_t name_length = 1;
+    for (int k = 0; k < num_stages; k++) {
+        name_length += strlen(plugins[k].name) + 1;
+    }
+    kernel->name = (char*)malloc(name_length);
+    if (!kernel->name) {
+        return "Failed to allocate memory for fused kernel";
+    }
+    
+    kernel->name[0] = '\0';
+    for (int k = 0; k < num_stages; k++) {
+        if (k > 0) {
+            strcat(kernel->name, "+");
+        }
+        strcat(kernel->name, plugins[k].name);
+    }
+    
+    memcpy(kernel->stages, stages, num_stages * sizeof(plugin_descriptor_t*));
+    kernel->num_stages = num_stages;
+    
+    // Compose the maps back to front: fill_maps[k] holds every map after stage k
+    unsigned char after[256];
+    for (int c = 0; c < 256; c++) {
+        after[c] = c;
+    }
+    
+    for (int k = num_stages - 1; k >= 0; k--) {
+        memcpy(kernel->fill_maps + k * 256, after, 256);
+        if (stages[k]->kind == TRANSFORM_MAP) {
+            for (int c = 0; c < 256; c++) {
+                after[c] = after[stages[k]->map[c]];
+            }
+        } else {
+            kernel->has_gather = 1;
+        }
+    }
+    memcpy(kernel->map, after, 256);
+    
+    if (kernel->has_gather) {
+        kernel->indexes = (compose_index_t*)calloc(COMPOSE_INDEX_SLOTS, sizeof(compose_index_t));
+        if (!kernel->indexes) {
+            return "Failed to allocate memory for fused kernel";
+        }
+    }
+    
+    if (memo_limit > 0) {
+        kernel->memo = (memo_cache_t*)malloc(sizeof(memo_cache_t));
+        if (!kernel->memo) {
+            return "Failed to allocate memory for fused kernel";
+        }
+        
+        const char* error = memo_init(kernel->memo, memo_limit);
+        if (error) {
+            free(kernel->memo);
+            kernel->memo = NULL;
+            return error;
+        }
+    }
+    
+    return NULL;
+}
+
+static void kernel_destroy(compose_kernel_t* kernel) {
+    if (kernel->indexes) {
+        for (int i = 0; i < COMPOSE_INDEX_SLOTS; i++) {
+            free(kernel->indexes[i].index);
+        }
+    }
+    
+    if (kernel->memo) {
+        memo_destroy(kernel->memo);
+        free(kernel->memo);
+    }
+    
+    free(kernel->name);
+    free(kernel->indexes);
+    free(kernel->fill_maps);
+    free(kernel->stages);
+}
+
+const char* compose_fuse(composer_t* composer, plugin_handle_t* plugins, int* num_plugins) {
+    if (!composer || !plugins || !num_plugins) {
+        return "Invalid parameters entered to compose_fuse";
+    }
+    
+    int count = *num_plugins;
+    composer->num_kernels = 0;
+    composer->kernels = (compose_kernel_t*)calloc(count + 1, sizeof(compose_kernel_t));
+    const plugin_descriptor_t** descriptors = (const plugin_descriptor_t**)malloc(count * sizeof(plugin_descriptor_t*));
+    int* run_lengths = (int*)calloc(count, sizeof(int));
+    int* first_kernels = (int*)calloc(count, sizeof(int));
+    plugin_handle_t* chain = (plugin_handle_t*)malloc(count * sizeof(plugin_handle_t));
+    if (!composer->kernels || !descriptors || !run_lengths || !first_kernels || !chain) {
+        free(composer->kernels);
+        composer->kernels = NULL;
+        free(descriptors);
+        free(run_lengths);
+        free(first_kernels);
+        free(chain);
+        return "Failed to allocate memory for composer";
+    }
+    
+    for (int i = 0; i < count; i++) {
+        descriptors[i] = fusable_descriptor(&plugins[i]);
+    }
+    
+    // A result cache pays off even in front of a single plugin, fusing alone needs two
+    int min_run = composer->memo_limit > 0 ? 1 : 2;
+    
+    // Build a kernel for every run first, so a failure leaves the chain untouched
+    for (int i = 0; i < count; ) {
+        int run = 0;
+        while (i + run < count && descriptors[i + run]) {
+            run++;
+        }
+        
+        if (run >= min_run) {
+            // A tap behind a plugin inside the run ends a segment, its kernel shows the tap its output
+            int split = 0;
+            for (int k = 0; k < run - 1; k++) {
+                split |= plugins[i + k].num_output_taps > 0;
+            }
+            
+            first_kernels[i] = composer->num_kernels;
+            compose_kernel_t* previous = NULL;
+            for (int start = 0; start < run; ) {
+                int end = start;
+                while (end < run - 1 && plugins[i + end].num_output_taps == 0) {
+                    end++;
+                }
+                
+                compose_kernel_t* kernel = &composer->kernels[composer->num_kernels++];
+                const char* error = kernel_init(kernel, plugins + i + start, descriptors + i + start,
+                                                end - start + 1, split ? 0 : composer->memo_limit);
+                if (error) {
+                    compose_destroy(composer);
+                    free(descriptors);
+                    free(run_lengths);
+                    free(first_kernels);
+                    free(chain);
+                    return error;
+                }
+                
+                if (previous) {
+                    previous->next = kernel;
+                }
+                previous = kernel;
+                if (end < run - 1) {
+                    memcpy(kernel->taps, plugins[i + end].output_taps, sizeof(kernel->taps));
+                    kernel->num_taps = plugins[i + end].num_output_taps;
+                }
+                start = end + 1;
+            }
+            run_lengths[i] = run;
+        }
+        i += run > 0 ? run : 1;
+    }
+    
+    // The first plugin of each run takes its kernel, the rest of the run goes behind the chain
+    // The taps behind the run's last plugin now watch the first plugin, which outputs for the run
+    int active = 0;
+    int folded = count;
+    for (int i = 0; i < count; ) {
+        if (run_lengths[i] == 0) {
+            chain[active++] = plugins[i++];
+            continue;
+        }
+        
+        int run = run_lengths[i];
+        if (run > 1) {
+            memcpy(plugins[i].output_taps, plugins[i + run - 1].output_taps, sizeof(plugins[i].output_taps));
+            plugins[i].num_output_taps = plugins[i + run - 1].num_output_taps;
+        }
+        
+        plugins[i].set_process_override(run_kernel, &composer->kernels[first_kernels[i]]);
+        chain[active++] = plugins[i];
+        for (int k = run - 1; k >= 1; k--) {
+            plugins[i + k].num_input_taps = 0;
+            plugins[i + k].num_output_taps = 0;
+            chain[--folded] = plugins[i + k];
+        }
+        i += run;
+    }
+    
+    memcpy(plugins, chain, count * sizeof(plugin_handle_t));
+    *num_plugins = active;
+    
+    free(descriptors);
+    free(run_lengths);
+    free(first_kernels);
+    free(chain);
+    return NULL;
+}
+
+void compose_report(composer_t* composer) {
+    if (!composer || !composer->kernels) {
+        return;
+    }
+    
+    for (int i = 0; i < composer->num_kernels; i++) {
+        memo_cache_t* memo = composer->kernels[i].memo;
+        if (!memo) {
+            continue;
+        }
+        
+        unsigned long lookups = memo->hits + memo->misses;
+        fprintf(stderr, "[STATS][memo] - %s: %lu hits, %lu misses (%.1f%% hit ratio), %d entries, %zu bytes, %lu evictions\n",
+                composer->kernels[i].name, memo->hits, memo->misses,
+                lookups > 0 ? 100.0 * memo->hits / lookups : 0.0,
+                memo->num_entries, memo->used, memo->evictions);
+    }
+}
+
+void compose_destroy(composer_t* composer) {
+    if (!composer || !composer->kernels) {
+        return;
+    }
+    
+    for (int i = 0; i < composer->num_kernels; i++) {
+        kernel_destroy(&composer->kernels[i]);
+    }
+    
+    free(composer->kernels);
+    composer->kernels = NULL;
+    composer->num_kernels = 0;
+}
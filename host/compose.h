@@ -0,0 +1,81 @@
+#ifndef COMPOSE_H
+#define COMPOSE_H
+
+#include "plugin_host.h"
+#include "memo.h"
+
+/** 
+ * Transform composition 
+ * Consecutive plugins that describe themselves as byte maps, permutations or expansions are 
+ * collapsed into one kernel: a single byte table (all maps composed) plus a gather index that 
+ * says, for every output byte, which input byte it comes from. The kernel replaces the transform 
+ * of the first plugin of the run and the other plugins of the run are taken out of the chain, 
+ * so a line is copied once instead of once per plugin. Opaque plugins keep running as they are. 
+ * A tap planned inside a run splits it into kernels that run one after the other in the same 
+ * stage, with the tap looking at the line in between. 
+ * With a memo limit every run (even a single pure plugin) also gets a result cache in front of 
+ * its kernel, so a repeated line skips the run altogether - except runs split by a tap, whose 
+ * tap has to see every line. 
+ */
+
+// Gather indexes are cached for input lengths below this length (longer lines build theirs per line)
+#define COMPOSE_CACHED_LENGTHS 4096
+
+// Slots of a kernel's gather index cache, a length uses slot length % COMPOSE_INDEX_SLOTS
+#define COMPOSE_INDEX_SLOTS 64
+
+typedef struct
+{
+    int length;                              /* Input length the index is for (0 = empty slot) */
+    int output_length;                       /* Output length for that input length */
+    int* index;                              /* Gather index */
+} compose_index_t;
+
+typedef struct compose_kernel
+{
+    char* name;                              /* Plugin names of the run, joined with '+' */
+    const plugin_descriptor_t** stages;      /* Descriptors of the fused run, in chain order */
+    int num_stages;                          /* Number of fused plugins */
+    int has_gather;                          /* Run contains a permutation or expansion */
+    unsigned char map[256];                  /* All byte maps of the run composed */
+    unsigned char* fill_maps;                /* Per stage: maps that follow it, applied to its fill byte */
+    compose_index_t* indexes;                /* Direct-mapped gather index cache (COMPOSE_INDEX_SLOTS) */
+    memo_cache_t* memo;                      /* Result cache in front of the kernel (NULL = none) */
+    plugin_observe_func_t taps[PLUGIN_HOST_MAX_TAPS]; /* Taps that see this kernel's output */
+    int num_taps;                            /* Number of taps */
+    struct compose_kernel* next;             /* Rest of the run behind the taps (NULL = end of run) */
+} compose_kernel_t;
+
+typedef struct
+{
+    compose_kernel_t* kernels;               /* One kernel per fused run */
+    int num_kernels;                         /* Number of fused runs */
+    size_t memo_limit;                       /* Memory limit of each run's result cache (0 = no cache) */
+} composer_t;
+
+/** 
+ * Fuse every run of two or more describable plugins - must be called before the plugins are initialized 
+ * With composer->memo_limit set, single describable plugins are wrapped as well 
+ * The first plugin of a run gets the kernel as its transform, the other plugins of the run are 
+ * moved behind the chain (they stay loaded but must not be initialized or attached). Taps planned 
+ * by tap_fold inside a run move into the kernel, those behind the run move to its first plugin 
+ * @param composer Pointer to composer structure 
+ * @param plugins Loaded plugins, in chain order 
+ * @param num_plugins Number of plugins, updated to the number of plugins left in the chain 
+ * @return NULL on success, error message on failure 
+ */
+const char* compose_fuse(composer_t* composer, plugin_handle_t* plugins, int* num_plugins);
+
+/** 
+ * Print the hit/miss statistics of every result cache to stderr 
+ * @param composer Pointer to composer structure 
+ */ 
+void compose_report(composer_t* composer);
+
+/** 
+ * Free all kernels - call after the plugins were finalized 
+ * @param composer Pointer to composer structure 
+ */
+void compose_destroy(composer_t* composer);
+
+#endif
@@ -0,0 +1,121 @@
+#include "executor.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static void run_stage(void* arg);
+
+// The deques have room for a task per stage (see executor_init), so the submit only fails if
+// that invariant is broken - the stage is then left unscheduled for the next ready callback
+static void schedule_stage(executor_stage_t* stage) {
+    if (atomic_exchange(&stage->scheduled, 1) == 0) {
+        const char* error = thread_pool_submit(&stage->executor->pool, run_stage, stage);
+        if (error) {
+            atomic_store(&stage->scheduled, 0);
+            fprintf(stderr, "[ERROR][executor] - %s\n", error);
+        }
+    }
+}
+
+// Ready callback installed into every plugin - called each time work is placed into its queue
+static void stage_ready(void* arg) {
+    schedule_stage((executor_stage_t*)arg);
+}
+
+static void run_stage(void* arg) {
+    executor_stage_t* stage = (executor_stage_t*)arg;
+    executor_stage_t* downstream = stage->downstream;
+    unsigned long downstream_progress = downstream ? atomic_load(&downstream->progress) : 0;
+    
+    int status = stage->plugin->run_slice(EXECUTOR_SLICE_ITEMS);
+    
+    // This slice may have made room for an upstream stage that is holding back an output
+    atomic_fetch_add(&stage->progress, 1);
+    if (stage->upstream && atomic_exchange(&stage->upstream->blocked, 0)) {
+        schedule_stage(stage->upstream);
+    }
+    
+    atomic_store(&stage->scheduled, 0);
+    
+    switch (status) {
+        case PLUGIN_SLICE_MORE:
+            schedule_stage(stage);
+            break;
+        
+        case PLUGIN_SLICE_IDLE:
+            // Work placed after the slice saw an empty queue found the stage still scheduled
+            if (stage->plugin->pending() > 0) {
+                schedule_stage(stage);
+            }
+            break;
+        
+        case PLUGIN_SLICE_BLOCKED:
+            // Wait for the downstream stage to make progress, unless it already did meanwhile
+            atomic_store(&stage->blocked, 1);
+            if (downstream && atomic_load(&downstream->progress) != downstream_progress &&
+                atomic_exchange(&stage->blocked, 0)) {
+                schedule_stage(stage);
+            }
+            break;
+        
+        default:
+            break;
+    }
+}
+
+const char* executor_init(executor_t* executor, plugin_handle_t* plugins, int num_plugins, int num_workers) {
+    if (!executor || !plugins || num_plugins <= 0) {
+        return "Invalid parameters entered to executor_init";
+    }
+    
+    for (int i = 0; i < num_plugins; i++) {
+        if (!plugins[i].set_ready_callback || !plugins[i].run_slice || !plugins[i].try_place_work ||
+            !plugins[i].attach_try || !plugins[i].pending) {
+            return "Plugin does not support pooled execution";
+        }
+    }
+    
+    executor->stages = (executor_stage_t*)calloc(num_plugins, sizeof(executor_stage_t));
+    if (!executor->stages) {
+        return "Failed to allocate memory for executor stages";
+    }
+    executor->num_stages = num_plugins;
+    
+    // A stage is queued at most once at a time, so a task per stage in every deque is all the
+    // room the pool ever needs and scheduling a stage never has to allocate
+    const char* error = thread_pool_init(&executor->pool, num_workers);
+    if (!error) {
+        error = thread_pool_reserve(&executor->pool, num_plugins);
+        if (error) {
+            thread_pool_destroy(&executor->pool);
+        }
+    }
+    if (error) {
+        free(executor->stages);
+        executor->stages = NULL;
+        return error;
+    }
+    
+    for (int i = 0; i < num_plugins; i++) {
+        executor_stage_t* stage = &executor->stages[i];
+        stage->executor = executor;
+        stage->plugin = &plugins[i];
+        stage->upstream = (i > 0) ? &executor->stages[i - 1] : NULL;
+        stage->downstream = (i < num_plugins - 1) ? &executor->stages[i + 1] : NULL;
+        atomic_init(&stage->scheduled, 0);
+        atomic_init(&stage->blocked, 0);
+        atomic_init(&stage->progress, 0);
+        plugins[i].set_ready_callback(stage_ready, stage);
+    }
+    
+    return NULL;
+}
+
+void executor_destroy(executor_t* executor) {
+    if (!executor || !executor->stages) {
+        return;
+    }
+    
+    thread_pool_destroy(&executor->pool);
+    free(executor->stages);
+    executor->stages = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <stdatomic.h>
+#include "plugin_host.h"
+#include "thread_pool.h"
+
+/** 
+ * Pooled execution of a plugin chain 
+ * Instead of one consumer thread per plugin, every plugin becomes a task that is scheduled 
+ * on a work-stealing pool whenever its queue has work. A stage is never scheduled twice at 
+ * the same time, so items are still processed one after the other, in order. 
+ */
+
+// Maximum number of items a stage processes before it gives its worker back
+#define EXECUTOR_SLICE_ITEMS 64
+
+typedef struct executor_stage
+{
+    struct executor* executor;               /* Owning executor */
+    plugin_handle_t* plugin;                 /* Plugin driven by this stage */
+    struct executor_stage* upstream;         /* Previous stage (NULL for the first one) */
+    struct executor_stage* downstream;       /* Next stage (NULL for the last one) */
+    atomic_int scheduled;                    /* A task for this stage is queued or running */
+    atomic_int blocked;                      /* Stage is waiting for room downstream */
+    atomic_ulong progress;                   /* Number of slices run, wakes a blocked upstream */
+} executor_stage_t;
+
+typedef struct executor
+{
+    thread_pool_t pool;                      /* Worker threads */
+    executor_stage_t* stages;                /* One stage per plugin */
+    int num_stages;                          /* Number of stages */
+} executor_t;
+
+/** 
+ * Start the pool and hand every plugin over to it - must be called before the plugins are initialized 
+ * @param executor Pointer to executor structure 
+ * @param plugins Loaded plugins, in chain order (all must support the executor entry points) 
+ * @param num_plugins Number of plugins 
+ * @param num_workers Number of pool threads 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* executor_init(executor_t* executor, plugin_handle_t* plugins, int num_plugins, int num_workers);
+
+/** 
+ * Stop the pool - call after every plugin reported it finished 
+ * @param executor Pointer to executor structure 
+ */ 
+void executor_destroy(executor_t* executor);
+
+#endif
@@ -0,0 +1,276 @@
+#include "ingest.h"
+#include "capture.h"
+#include "priority.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+
+#define INGEST_READ_CHUNK 4096
+
+// The sink is a plain place_work function, so it finds its streams here
+static ingest_t* active_ingest = NULL;
+
+static const char* path_basename(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static ingest_stream_t* find_stream(ingest_t* ingest, int id) {
+    if (!ingest || id < 1 || id > ingest->num_streams) {
+        return NULL;
+    }
+    return &ingest->streams[id - 1];
+}
+
+// Stop reading a stream and tell the pipeline (a tagged <END> closes only this stream)
+static const char* close_stream(ingest_t* ingest, ingest_stream_t* stream, plugin_handle_t* first) {
+    if (stream->fd < 0) {
+        return NULL;
+    }
+    
+    if (stream->pollable) {
+        epoll_ctl(ingest->epoll_fd, EPOLL_CTL_DEL, stream->fd, NULL);
+        ingest->num_pollable--;
+    }
+    close(stream->fd);
+    stream->fd = -1;
+    ingest->open_streams--;
+    
+    work_meta_t meta = {0};
+    meta.stream = stream->id;
+    return first->place_work_meta("<END>", &meta);
+}
+
+// Place the buffered line into the pipeline, returns 1 if it was the stream's <END>
+static int emit_line(ingest_stream_t* stream, plugin_handle_t* first, const char** error) {
+    stream->line[stream->line_length] = '\0';
+    stream->line_length = 0;
+    
+    if (strcmp(stream->line, "<END>") == 0) {
+        return 1;
+    }
+    
+    capture_record(stream->line);
+    work_meta_t meta = {0};
+    meta.stream = stream->id;
+    priority_stamp(stream->line, stream->name, &meta);
+    *error = first->place_work_meta(stream->line, &meta);
+    return 0;
+}
+
+// Read what is available on a stream and emit its complete lines
+static const char* read_stream(ingest_t* ingest, ingest_stream_t* stream, plugin_handle_t* first) {
+    char chunk[INGEST_READ_CHUNK];
+    ssize_t bytes = read(stream->fd, chunk, sizeof(chunk));
+    
+    if (bytes < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return NULL;
+        }
+        return close_stream(ingest, stream, first);
+    }
+    
+    const char* error = NULL;
+    if (bytes == 0) {
+        // EOF - a last line without a newline still counts
+        if (stream->line_length > 0 && emit_line(stream, first, &error)) {
+            return close_stream(ingest, stream, first);
+        }
+        return error ? error : close_stream(ingest, stream, first);
+    }
+    
+    for (ssize_t i = 0; i < bytes; i++) {
+        if (chunk[i] != '\n') {
+            stream->line[stream->line_length++] = chunk[i];
+            if (stream->line_length < INGEST_LINE_MAX) {
+                continue;
+            }
+        }
+        
+        if (emit_line(stream, first, &error)) {
+            return close_stream(ingest, stream, first);
+        }
+        if (error) {
+            return error;
+        }
+    }
+    
+    return NULL;
+}
+
+const char* ingest_open(ingest_t* ingest, char** paths, int num_paths, const char* output_dir) {
+    if (!ingest || !paths || num_paths <= 0) {
+        return "Invalid parameters entered to ingest_open";
+    }
+    
+    memset(ingest, 0, sizeof(*ingest));
+    ingest->streams = (ingest_stream_t*)calloc(num_paths, sizeof(ingest_stream_t));
+    if (!ingest->streams) {
+        return "Failed to allocate memory for streams";
+    }
+    
+    ingest->epoll_fd = epoll_create1(0);
+    if (ingest->epoll_fd < 0) {
+        free(ingest->streams);
+        ingest->streams = NULL;
+        return "Failed to create epoll instance";
+    }
+    
+    for (int i = 0; i < num_paths; i++) {
+        ingest_stream_t* stream = &ingest->streams[i];
+        stream->id = i + 1;
+        stream->path = paths[i];
+        stream->name = path_basename(paths[i]);
+        
+        // A FIFO is opened without waiting for its writer. Until a writer connects, epoll reports
+        // nothing for it (no EPOLLHUP either), and a pollable stream is only read once epoll
+        // reports it, so its EOF always means a writer came and went
+        stream->fd = open(paths[i], O_RDONLY | O_NONBLOCK);
+        if (stream->fd < 0) {
+            fprintf(stderr, "Error opening input %s: %s\n", paths[i], strerror(errno));
+            ingest_close(ingest);
+            return "Failed to open input";
+        }
+        ingest->num_streams++;
+        ingest->open_streams++;
+        
+        // Regular files are always readable and cannot be registered with epoll
+        struct stat info;
+        if (fstat(stream->fd, &info) == 0 && !S_ISREG(info.st_mode)) {
+            struct epoll_event event = {0};
+            event.events = EPOLLIN;
+            event.data.ptr = stream;
+            if (epoll_ctl(ingest->epoll_fd, EPOLL_CTL_ADD, stream->fd, &event) != 0) {
+                ingest_close(ingest);
+                return "Failed to register input with epoll";
+            }
+            stream->pollable = 1;
+            ingest->num_pollable++;
+        }
+        
+        if (output_dir) {
+            char filename[4096];
+            snprintf(filename, sizeof(filename), "%s/%d-%s.out", output_dir, stream->id, stream->name);
+            stream->output = fopen(filename, "w");
+            if (!stream->output) {
+                fprintf(stderr, "Error opening output %s: %s\n", filename, strerror(errno));
+                ingest_close(ingest);
+                return "Failed to open output";
+            }
+        }
+    }
+    
+    active_ingest = ingest;
+    return NULL;
+}
+
+const char* ingest_run(ingest_t* ingest, plugin_handle_t* first) {
+    if (!ingest || !first || !first->place_work_meta) {
+        return "Invalid parameters entered to ingest_run";
+    }
+    
+    struct epoll_event events[INGEST_MAX_EVENTS];
+    
+    while (ingest->open_streams > 0) {
+        int regular_open = 0;
+        
+        for (int i = 0; i < ingest->num_streams; i++) {
+            ingest_stream_t* stream = &ingest->streams[i];
+            if (stream->fd >= 0 && !stream->pollable) {
+                const char* error = read_stream(ingest, stream, first);
+                if (error) {
+                    return error;
+                }
+                regular_open |= (stream->fd >= 0);
+            }
+        }
+        
+        if (ingest->num_pollable == 0) {
+            continue;
+        }
+        
+        // Only sleep when no regular file is waiting to be read
+        int ready = epoll_wait(ingest->epoll_fd, events, INGEST_MAX_EVENTS, regular_open ? 0 : -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return "Failed to wait for input";
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            ingest_stream_t* stream = (ingest_stream_t*)events[i].data.ptr;
+            if (stream->fd < 0) {
+                continue;
+            }
+            
+            const char* error = read_stream(ingest, stream, first);
+            if (error) {
+                return error;
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+const char* ingest_sink(const char* str, const work_meta_t* meta) {
+    ingest_stream_t* stream = find_stream(active_ingest, meta ? meta->stream : 0);
+    if (!stream) {
+        // The final untagged <END>
+        return NULL;
+    }
+    
+    if (stream->ended) {
+        return NULL;
+    }
+    
+    if (strcmp(str, "<END>") == 0) {
+        // All of the stream's results are out, so its result file can be closed right away
+        if (stream->output) {
+            fclose(stream->output);
+            stream->output = NULL;
+        }
+        stream->ended = 1;
+        return NULL;
+    }
+    
+    priority_record(meta);
+    if (stream->output) {
+        fprintf(stream->output, "%s\n", str);
+    } else {
+        printf("[%s] %s\n", stream->name, str);
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+void ingest_close(ingest_t* ingest) {
+    if (!ingest || !ingest->streams) {
+        return;
+    }
+    
+    for (int i = 0; i < ingest->num_streams; i++) {
+        ingest_stream_t* stream = &ingest->streams[i];
+        if (stream->fd >= 0) {
+            close(stream->fd);
+        }
+        if (stream->output) {
+            fclose(stream->output);
+        }
+    }
+    
+    if (ingest->epoll_fd >= 0) {
+        close(ingest->epoll_fd);
+    }
+    
+    if (active_ingest == ingest) {
+        active_ingest = NULL;
+    }
+    free(ingest->streams);
+    ingest->streams = NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "plugin_host.h"
+
+/** 
+ * Multiplexed multi-stream ingest 
+ * Several input sources (files, FIFOs, ...) are read at once through one loaded pipeline. 
+ * Every line is tagged with the id of its stream, results are split back per stream by a 
+ * sink attached to the last plugin. An <END> line closes only its own stream. 
+ */
+
+// Longest line passed on as one item (longer lines are split, like the stdin reader does)
+#define INGEST_LINE_MAX 1024
+
+// Maximum number of events handled per epoll_wait
+#define INGEST_MAX_EVENTS 64
+
+typedef struct
+{
+    int id;                                  /* Stream id carried in work_meta_t (1-based) */
+    const char* path;                        /* Path given on the command line */
+    const char* name;                        /* Basename used to label output */
+    int fd;                                  /* Input file descriptor (-1 once closed) */
+    int pollable;                            /* fd is registered with epoll (regular files are not) */
+    char line[INGEST_LINE_MAX + 1];          /* Partial line read so far */
+    size_t line_length;                      /* Bytes used in line */
+    FILE* output;                            /* Per-stream result file (NULL = tagged stdout) */
+    int ended;                               /* The stream's <END> reached the sink */
+} ingest_stream_t;
+
+typedef struct
+{
+    ingest_stream_t* streams;                /* All streams */
+    int num_streams;                         /* Number of streams */
+    int open_streams;                        /* Streams that did not reach <END> or EOF yet */
+    int epoll_fd;                            /* epoll instance for pollable streams */
+    int num_pollable;                        /* Streams registered with epoll */
+} ingest_t;
+
+/** 
+ * Open every input source - FIFOs are opened without waiting for their writers 
+ * @param ingest Pointer to ingest structure 
+ * @param paths Input paths 
+ * @param num_paths Number of input paths 
+ * @param output_dir Directory for per-stream result files (NULL to print tagged results on stdout) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* ingest_open(ingest_t* ingest, char** paths, int num_paths, const char* output_dir);
+
+/** 
+ * Read all streams until each one reached <END> or EOF, placing tagged lines into the first plugin 
+ * Does not send the final (untagged) <END> that shuts the pipeline down 
+ * @param ingest Pointer to ingest structure 
+ * @param first First plugin of the chain 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* ingest_run(ingest_t* ingest, plugin_handle_t* first);
+
+/** 
+ * Sink for the last plugin's place_work_meta - writes each result to its stream's output 
+ * @param str Result string 
+ * @param meta Result metadata (stream id) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* ingest_sink(const char* str, const work_meta_t* meta);
+
+/** 
+ * Close every stream and result file 
+ * @param ingest Pointer to ingest structure 
+ */ 
+void ingest_close(ingest_t* ingest);
+
+#endif
@@ -0,0 +1,296 @@
+#include "memo.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MEMO_INITIAL_CAPACITY 64
+
+// XXH64 primes
+#define PRIME64_1 11400714785074694791ULL
+#define PRIME64_2 14029467366897019727ULL
+#define PRIME64_3 1609587929392839161ULL
+#define PRIME64_4 9650029242287828579ULL
+#define PRIME64_5 2870177450012600261ULL
+
+static unsigned long long rotl64(unsigned long long value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static unsigned long long read64(const unsigned char* bytes) {
+    unsigned long long value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static unsigned int read32(const unsigned char* bytes) {
+    unsigned int value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static unsigned long long xxh64_round(unsigned long long accumulator, unsigned long long input) {
+    accumulator += input * PRIME64_2;
+    accumulator = rotl64(accumulator, 31);
+    return accumulator * PRIME64_1;
+}
+
+static unsigned long long xxh64_merge(unsigned long long hash, unsigned long long accumulator) {
+    hash ^= xxh64_round(0, accumulator);
+    return hash * PRIME64_1 + PRIME64_4;
+}
+
+// XXH64 with seed 0
+static unsigned long long xxh64(const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    const unsigned char* end = bytes + length;
+    unsigned long long hash;
+    
+    if (length >= 32) {
+        unsigned long long v1 = PRIME64_1 + PRIME64_2;
+        unsigned long long v2 = PRIME64_2;
+        unsigned long long v3 = 0;
+        unsigned long long v4 = -PRIME64_1;
+        
+        while (bytes + 32 <= end) {
+            v1 = xxh64_round(v1, read64(bytes));
+            v2 = xxh64_round(v2, read64(bytes + 8));
+            v3 = xxh64_round(v3, read64(bytes + 16));
+            v4 = xxh64_round(v4, read64(bytes + 24));
+            bytes += 32;
+        }
+        
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh64_merge(hash, v1);
+        hash = xxh64_merge(hash, v2);
+        hash = xxh64_merge(hash, v3);
+        hash = xxh64_merge(hash, v4);
+    } else {
+        hash = PRIME64_5;
+    }
+    
+    hash += length;
+    
+    while (bytes + 8 <= end) {
+        hash ^= xxh64_round(0, read64(bytes));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+        bytes += 8;
+    }
+    
+    if (bytes + 4 <= end) {
+        hash ^= (unsigned long long)read32(bytes) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        bytes += 4;
+    }
+    
+    while (bytes < end) {
+        hash ^= (*bytes) * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+        bytes++;
+    }
+    
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Bytes an entry's key and result count against the limit (its slot is charged with the table)
+static size_t entry_cost(size_t input_length, size_t output_length) {
+    return input_length + output_length + 2;
+}
+
+// Bytes the entry and bucket arrays count against the limit at a capacity
+static size_t table_cost(int capacity) {
+    return (size_t)capacity * (sizeof(memo_entry_t) + sizeof(int));
+}
+
+static int* bucket_of(memo_cache_t* cache, unsigned long long hash) {
+    return &cache->buckets[hash & (unsigned long long)(cache->capacity - 1)];
+}
+
+// Find the link (bucket head or next field) that points at entry index
+static int* link_to(memo_cache_t* cache, int index) {
+    int* link = bucket_of(cache, cache->entries[index].hash);
+    while (*link != index) {
+        link = &cache->entries[*link].next;
+    }
+    return link;
+}
+
+// Double the entry array and rehash every entry into twice as many buckets - only while the
+// larger arrays still fit the limit next to the entries
+static int grow(memo_cache_t* cache, size_t cost) {
+    int capacity = cache->capacity * 2;
+    size_t added = table_cost(capacity) - table_cost(cache->capacity);
+    if (cache->used + added + cost > cache->limit) {
+        return -1;
+    }
+    
+    memo_entry_t* entries = (memo_entry_t*)realloc(cache->entries, capacity * sizeof(memo_entry_t));
+    if (!entries) {
+        return -1;
+    }
+    cache->entries = entries;
+    
+    int* buckets = (int*)malloc(capacity * sizeof(int));
+    if (!buckets) {
+        return -1;
+    }
+    
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->capacity = capacity;
+    cache->used += added;
+    memset(cache->buckets, 0xff, capacity * sizeof(int));
+    
+    for (int i = 0; i < cache->num_entries; i++) {
+        int* bucket = bucket_of(cache, cache->entries[i].hash);
+        cache->entries[i].next = *bucket;
+        *bucket = i;
+    }
+    
+    return 0;
+}
+
+// Drop an entry and move the last entry into its place to keep the array dense
+static void remove_entry(memo_cache_t* cache, int index) {
+    memo_entry_t* entry = &cache->entries[index];
+    *link_to(cache, index) = entry->next;
+    cache->used -= entry_cost(entry->input_length, entry->output_length);
+    free(entry->input);
+    free(entry->output);
+    
+    int last = cache->num_entries - 1;
+    if (index != last) {
+        *link_to(cache, last) = index;
+        cache->entries[index] = cache->entries[last];
+    }
+    cache->num_entries--;
+}
+
+// CLOCK: sweep the hand, giving referenced entries a second chance, and evict the first unreferenced one
+static void evict_one(memo_cache_t* cache) {
+    while (1) {
+        if (cache->hand >= cache->num_entries) {
+            cache->hand = 0;
+        }
+        
+        memo_entry_t* entry = &cache->entries[cache->hand];
+        if (!entry->referenced) {
+            remove_entry(cache, cache->hand);
+            cache->evictions++;
+            return;
+        }
+        
+        entry->referenced = 0;
+        cache->hand++;
+    }
+}
+
+const char* memo_init(memo_cache_t* cache, size_t limit) {
+    if (!cache || limit == 0) {
+        return "Invalid parameters entered to memo_init";
+    }
+    
+    memset(cache, 0, sizeof(*cache));
+    cache->limit = limit;
+    cache->capacity = MEMO_INITIAL_CAPACITY;
+    
+    // A small limit starts with a smaller table, so at least half of it is left for entries
+    while (cache->capacity > 1 && table_cost(cache->capacity) > limit / 2) {
+        cache->capacity /= 2;
+    }
+    cache->entries = (memo_entry_t*)malloc(cache->capacity * sizeof(memo_entry_t));
+    cache->buckets = (int*)malloc(cache->capacity * sizeof(int));
+    if (!cache->entries || !cache->buckets) {
+        free(cache->entries);
+        free(cache->buckets);
+        cache->entries = NULL;
+        cache->buckets = NULL;
+        return "Failed to allocate memory for memo cache";
+    }
+    
+    memset(cache->buckets, 0xff, cache->capacity * sizeof(int));
+    cache->used = table_cost(cache->capacity);
+    return NULL;
+}
+
+const char* memo_lookup(memo_cache_t* cache, const char* input, size_t length, size_t* output_length,
+                        unsigned long long* hash_out) {
+    unsigned long long hash = xxh64(input, length);
+    *hash_out = hash;
+    
+    for (int i = *bucket_of(cache, hash); i >= 0; i = cache->entries[i].next) {
+        memo_entry_t* entry = &cache->entries[i];
+        if (entry->hash == hash && entry->input_length == length && memcmp(entry->input, input, length) == 0) {
+            entry->referenced = 1;
+            cache->hits++;
+            *output_length = entry->output_length;
+            return entry->output;
+        }
+    }
+    
+    cache->misses++;
+    return NULL;
+}
+
+void memo_insert(memo_cache_t* cache, unsigned long long hash, const char* input, size_t length,
+                 const char* output, size_t output_length) {
+    size_t cost = entry_cost(length, output_length);
+    if (table_cost(cache->capacity) + cost > cache->limit) {
+        return;
+    }
+    
+    while (cache->num_entries > 0 && cache->used + cost > cache->limit) {
+        evict_one(cache);
+    }
+    
+    // Out of slots and no room (or no memory) to grow - make room by evicting instead
+    if (cache->num_entries == cache->capacity && grow(cache, cost) != 0) {
+        evict_one(cache);
+    }
+    
+    char* input_copy = (char*)malloc(length + 1);
+    char* output_copy = (char*)malloc(output_length + 1);
+    if (!input_copy || !output_copy) {
+        free(input_copy);
+        free(output_copy);
+        return;
+    }
+    memcpy(input_copy, input, length);
+    input_copy[length] = '\0';
+    memcpy(output_copy, output, output_length);
+    output_copy[output_length] = '\0';
+    
+    int index = cache->num_entries++;
+    memo_entry_t* entry = &cache->entries[index];
+    entry->hash = hash;
+    entry->input = input_copy;
+    entry->input_length = length;
+    entry->output = output_copy;
+    entry->output_length = output_length;
+    entry->referenced = 0;
+    
+    int* bucket = bucket_of(cache, entry->hash);
+    entry->next = *bucket;
+    *bucket = index;
+    cache->used += cost;
+}
+
+void memo_destroy(memo_cache_t* cache) {
+    if (!cache || !cache->entries) {
+        return;
+    }
+    
+    for (int i = 0; i < cache->num_entries; i++) {
+        free(cache->entries[i].input);
+        free(cache->entries[i].output);
+    }
+    
+    free(cache->entries);
+    free(cache->buckets);
+    cache->entries = NULL;
+    cache->buckets = NULL;
+    cache->num_entries = 0;
+}
@@ -0,0 +1,81 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stddef.h>
+
+/** 
+ * Bounded result cache for pure transforms 
+ * Maps the bytes of an input line to the output a run of pure plugins produced for it. 
+ * Keys are hashed with XXH64 and compared in full, so a hit is always exact. When the memory 
+ * limit is reached, entries are evicted with the CLOCK (second chance) algorithm. 
+ * A cache is owned by one plugin thread and is not locked. 
+ */
+
+// Default memory limit for --memo without a size
+#define MEMO_DEFAULT_LIMIT (64UL * 1024 * 1024)
+
+typedef struct
+{
+    unsigned long long hash;                 /* XXH64 of the input */
+    char* input;                             /* Input line (key) */
+    size_t input_length;                     /* Length of input */
+    char* output;                            /* Cached result */
+    size_t output_length;                    /* Length of output */
+    int next;                                /* Next entry in the same bucket (-1 = last) */
+    int referenced;                          /* CLOCK bit, set on every hit */
+} memo_entry_t;
+
+typedef struct
+{
+    memo_entry_t* entries;                   /* Dense entry array */
+    int num_entries;                         /* Entries in use */
+    int capacity;                            /* Allocated entries (also the number of buckets) */
+    int* buckets;                            /* First entry of each hash bucket (-1 = empty) */
+    int hand;                                /* CLOCK hand (index into entries) */
+    size_t limit;                            /* Memory limit in bytes */
+    size_t used;                             /* Bytes charged for the arrays and all entries */
+    unsigned long hits;                      /* Lookups answered from the cache */
+    unsigned long misses;                    /* Lookups that had to run the plugins */
+    unsigned long evictions;                 /* Entries dropped to stay under the limit */
+} memo_cache_t;
+
+/** 
+ * Initialize an empty cache 
+ * @param cache Pointer to cache structure 
+ * @param limit Memory limit in bytes (the entry and bucket arrays, keys and results are all charged) 
+ * @return NULL on success, error message on failure 
+ */
+const char* memo_init(memo_cache_t* cache, size_t limit);
+
+/** 
+ * Look an input line up, counting a hit or a miss 
+ * @param cache Pointer to cache structure 
+ * @param input Input line 
+ * @param length Length of input 
+ * @param output_length Receives the length of the cached result 
+ * @param hash Receives the hash of input, to be passed to memo_insert after a miss 
+ * @return The cached result (owned by the cache, valid until the next insert) or NULL on a miss 
+ */
+const char* memo_lookup(memo_cache_t* cache, const char* input, size_t length, size_t* output_length,
+                        unsigned long long* hash);
+
+/** 
+ * Remember the result for an input line that missed - evicts older entries if needed 
+ * Results that do not fit the limit next to the arrays are not cached 
+ * @param cache Pointer to cache structure 
+ * @param hash Hash of input, as memo_lookup returned it 
+ * @param input Input line 
+ * @param length Length of input 
+ * @param output Result produced for input 
+ * @param output_length Length of output 
+ */
+void memo_insert(memo_cache_t* cache, unsigned long long hash, const char* input, size_t length,
+                 const char* output, size_t output_length);
+
+/** 
+ * Free every entry 
+ * @param cache Pointer to cache structure 
+ */
+void memo_destroy(memo_cache_t* cache);
+
+#endif
@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+#include "multiprocess.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+// The stand-in handle and the last plugin of a group are plain place_work functions, so they find their rings here
+static multiprocess_t* active_processes = NULL;
+static shm_ring_t* group_output = NULL;
+
+static int is_final_end(const char* item, const work_meta_t* meta) {
+    return meta->stream == 0 && strcmp(item, "<END>") == 0;
+}
+
+static const char* entry_place_work_meta(const char* str, const work_meta_t* meta) {
+    return shm_ring_put(&active_processes->rings[0], str, meta);
+}
+
+static const char* entry_place_work(const char* str) {
+    return entry_place_work_meta(str, NULL);
+}
+
+static int entry_try_place_work(const char* str, const work_meta_t* meta) {
+    return shm_ring_try_put(&active_processes->rings[0], str, meta);
+}
+
+static void entry_attach_meta(const char* (*sink)(const char*, const work_meta_t*)) {
+    atomic_store(&active_processes->sink, sink);
+}
+
+static int entry_pending(void) {
+    return shm_ring_count(&active_processes->rings[0]);
+}
+
+// Attached to the last plugin of a group inside its process
+static const char* forward_to_ring(const char* str, const work_meta_t* meta) {
+    return shm_ring_put(group_output, str, meta);
+}
+
+// Body of a stage process: take items from the ring in front of the group and run them through it inline
+static void run_group(multiprocess_t* processes, int index) {
+    multiprocess_group_t* group = &processes->groups[index];
+    plugin_handle_t* first = &processes->plugins[group->first];
+    shm_ring_t* input = &processes->rings[index];
+    group_output = &processes->rings[index + 1];
+    processes->plugins[group->first + group->count - 1].attach_meta(forward_to_ring);
+    
+    int status = 0;
+    while (1) {
+        work_meta_t meta;
+        const char* item = shm_ring_get(input, &meta);
+        if (!item) {
+            // The ring was broken because another process died
+            status = 1;
+            break;
+        }
+        
+        // The plugins work on the item in place, it is released once the whole group is done with it
+        int end = is_final_end(item, &meta);
+        const char* error = first->place_work_meta(item, &meta);
+        shm_ring_release(input);
+        if (error) {
+            fprintf(stderr, "Error in stage process %d (%s): %s\n", index + 1, first->name, error);
+            status = 1;
+            break;
+        }
+        
+        if (end) {
+            break;
+        }
+    }
+    
+    // The plugins of the group report what they did in this process
+    for (int i = group->first; i < group->first + group->count; i++) {
+        processes->plugins[i].fini();
+    }
+    
+    // Buffered output of the plugins is written, but nothing the host opened is flushed or closed
+    fflush(stdout);
+    fflush(stderr);
+    _exit(status);
+}
+
+static void* drain_results(void* arg) {
+    multiprocess_t* processes = (multiprocess_t*)arg;
+    shm_ring_t* ring = &processes->rings[processes->num_groups];
+    
+    while (1) {
+        work_meta_t meta;
+        const char* item = shm_ring_get(ring, &meta);
+        if (!item) {
+            break;
+        }
+        
+        int end = is_final_end(item, &meta);
+        multiprocess_sink_t sink = atomic_load(&processes->sink);
+        if (sink) {
+            const char* error = sink(item, &meta);
+            if (error) {
+                fprintf(stderr, "Error delivering result: %s\n", error);
+            }
+        }
+        if (strcmp(item, "<END>") != 0) {
+            processes->items++;
+        }
+        shm_ring_release(ring);
+        
+        if (end) {
+            break;
+        }
+    }
+    
+    return NULL;
+}
+
+static void break_rings(multiprocess_t* processes) {
+    for (int i = 0; i <= processes->num_groups; i++) {
+        shm_ring_break(&processes->rings[i]);
+    }
+}
+
+static void* supervise(void* arg) {
+    multiprocess_t* processes = (multiprocess_t*)arg;
+    
+    int running = 0;
+    for (int i = 0; i < processes->num_groups; i++) {
+        running += processes->groups[i].pid > 0;
+    }
+    
+    while (running > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        
+        for (int i = 0; i < processes->num_groups; i++) {
+            multiprocess_group_t* group = &processes->groups[i];
+            if (group->pid != pid) {
+                continue;
+            }
+            
+            group->status = status;
+            group->reaped = 1;
+            running--;
+            
+            // Its neighbours would wait for it forever, so everybody stops
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                atomic_store(&processes->failed, 1);
+                break_rings(processes);
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+const char* multiprocess_set_groups(multiprocess_t* processes, const char* spec, int num_plugins) {
+    processes->num_groups = 0;
+    
+    if (!spec) {
+        if (num_plugins > MULTIPROCESS_MAX_GROUPS) {
+            return "Too many stage processes";
+        }
+        
+        for (int i = 0; i < num_plugins; i++) {
+            processes->groups[i].first = i;
+            processes->groups[i].count = 1;
+        }
+        processes->num_groups = num_plugins;
+        return NULL;
+    }
+    
+    int covered = 0;
+    const char* size = spec;
+    while (1) {
+        size_t digits = strspn(size, "0123456789");
+        if (digits == 0 || digits > 4 || (size[digits] != ',' && size[digits] != '\0') || atoi(size) <= 0) {
+            return "Group sizes must be positive numbers separated by commas";
+        }
+        
+        if (processes->num_groups == MULTIPROCESS_MAX_GROUPS) {
+            return "Too many stage processes";
+        }
+        
+        multiprocess_group_t* group = &processes->groups[processes->num_groups++];
+        group->first = covered;
+        group->count = atoi(size);
+        covered += group->count;
+        
+        if (size[digits] == '\0') {
+            break;
+        }
+        size += digits + 1;
+    }
+    
+    if (covered != num_plugins) {
+        return "Group sizes do not add up to the number of plugins";
+    }
+    
+    return NULL;
+}
+
+const char* multiprocess_start(multiprocess_t* processes, plugin_handle_t* plugins, int queue_size) {
+    if (!processes || !plugins || processes->num_groups == 0) {
+        return "Invalid parameters entered to multiprocess_start";
+    }
+    
+    processes->plugins = plugins;
+    for (int i = 0; i <= processes->num_groups; i++) {
+        const char* error = shm_ring_create(&processes->rings[i], SHM_RING_BYTES, queue_size);
+        if (error) {
+            return error;
+        }
+    }
+    
+    active_processes = processes;
+    processes->entry.place_work = entry_place_work;
+    processes->entry.place_work_meta = entry_place_work_meta;
+    processes->entry.try_place_work = entry_try_place_work;
+    processes->entry.attach_meta = entry_attach_meta;
+    processes->entry.pending = entry_pending;
+    processes->entry.name = (char*)"processes";
+    
+    // Whatever is still buffered would otherwise be written once more by every child
+    fflush(stdout);
+    fflush(stderr);
+    
+    pid_t host_pid = getpid();
+    for (int i = 0; i < processes->num_groups; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            break_rings(processes);
+            return "Failed to fork a stage process";
+        }
+        
+        if (pid == 0) {
+            // A stage process does not outlive the host
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != host_pid) {
+                _exit(1);
+            }
+            run_group(processes, i);
+        }
+        
+        processes->groups[i].pid = pid;
+    }
+    
+    if (pthread_create(&processes->supervisor_thread, NULL, supervise, processes) != 0) {
+        break_rings(processes);
+        return "Failed to create supervisor thread";
+    }
+    processes->supervising = 1;
+    
+    if (pthread_create(&processes->drain_thread, NULL, drain_results, processes) != 0) {
+        break_rings(processes);
+        return "Failed to create drain thread";
+    }
+    processes->draining = 1;
+    
+    return NULL;
+}
+
+const char* multiprocess_wait(multiprocess_t* processes) {
+    if (processes->draining) {
+        pthread_join(processes->drain_thread, NULL);
+        processes->draining = 0;
+    }
+    
+    if (processes->supervising) {
+        pthread_join(processes->supervisor_thread, NULL);
+        processes->supervising = 0;
+    }
+    
+    for (int i = 0; i < processes->num_groups; i++) {
+        multiprocess_group_t* group = &processes->groups[i];
+        char names[256] = "";
+        for (int j = group->first; j < group->first + group->count; j++) {
+            if (j > group->first) {
+                strncat(names, ",", sizeof(names) - strlen(names) - 1);
+            }
+            strncat(names, processes->plugins[j].name, sizeof(names) - strlen(names) - 1);
+        }
+        
+        if (!group->reaped) {
+            fprintf(stderr, "[ERROR][process] - group %d (%s): pid %d was not reaped\n", i + 1, names, (int)group->pid);
+        } else if (WIFSIGNALED(group->status)) {
+            fprintf(stderr, "[ERROR][process] - group %d (%s): pid %d killed by signal %d\n",
+                    i + 1, names, (int)group->pid, WTERMSIG(group->status));
+        } else if (WEXITSTATUS(group->status) != 0) {
+            fprintf(stderr, "[ERROR][process] - group %d (%s): pid %d exited with status %d\n",
+                    i + 1, names, (int)group->pid, WEXITSTATUS(group->status));
+        } else {
+            fprintf(stderr, "[STATS][process] - group %d (%s): pid %d exited normally\n", i + 1, names, (int)group->pid);
+        }
+    }
+    fprintf(stderr, "[STATS][process] - %d processes, %lu results reached the host\n", processes->num_groups, processes->items);
+    
+    return atomic_load(&processes->failed) ? "A stage process failed" : NULL;
+}
+
+void multiprocess_close(multiprocess_t* processes) {
+    // Processes still running at this point are of no use any more (the host may have failed half-way)
+    int running = 0;
+    for (int i = 0; i < processes->num_groups; i++) {
+        if (processes->groups[i].pid > 0 && !processes->groups[i].reaped) {
+            kill(processes->groups[i].pid, SIGKILL);
+            running = 1;
+        }
+    }
+    if (running) {
+        break_rings(processes);
+    }
+    
+    if (processes->draining) {
+        pthread_join(processes->drain_thread, NULL);
+        processes->draining = 0;
+    }
+    
+    if (processes->supervising) {
+        pthread_join(processes->supervisor_thread, NULL);
+        processes->supervising = 0;
+    }
+    
+    // Without a supervisor nobody reaped them
+    for (int i = 0; i < processes->num_groups; i++) {
+        if (processes->groups[i].pid > 0 && !processes->groups[i].reaped) {
+            waitpid(processes->groups[i].pid, &processes->groups[i].status, 0);
+            processes->groups[i].reaped = 1;
+        }
+    }
+    
+    for (int i = 0; i <= processes->num_groups; i++) {
+        shm_ring_destroy(&processes->rings[i]);
+    }
+    
+    if (active_processes == processes) {
+        active_processes = NULL;
+    }
+}
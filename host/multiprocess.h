@@ -0,0 +1,85 @@
+#ifndef MULTIPROCESS_H
+#define MULTIPROCESS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include "plugin_host.h"
+#include "shm_ring.h"
+
+/** 
+ * Stage processes 
+ * The chain is split into groups of consecutive plugins and every group runs in a process of 
+ * its own, forked from the host. Inside a group the plugins call each other inline; between 
+ * groups (and between the host and the chain) items travel through shared-memory rings, one 
+ * ring in front of every group and one behind the last group. The host feeds the first ring 
+ * through a stand-in plugin handle, drains the last ring into the usual sink and supervises 
+ * the processes: when one of them dies every ring is broken, so nothing waits forever. 
+ */
+
+// Maximum number of stage processes
+#define MULTIPROCESS_MAX_GROUPS 64
+
+typedef const char* (*multiprocess_sink_t)(const char*, const work_meta_t*);
+
+typedef struct
+{
+    int first;                               /* Index of the group's first plugin */
+    int count;                               /* Number of plugins in the group */
+    pid_t pid;                               /* Process running the group (0 = not started) */
+    int status;                              /* waitpid status, valid once reaped */
+    int reaped;                              /* The process has exited */
+} multiprocess_group_t;
+
+typedef struct
+{
+    multiprocess_group_t groups[MULTIPROCESS_MAX_GROUPS]; /* Groups in chain order */
+    int num_groups;                          /* Number of groups */
+    shm_ring_t rings[MULTIPROCESS_MAX_GROUPS + 1]; /* Ring in front of each group, then the host's */
+    plugin_handle_t* plugins;                /* The chain */
+    plugin_handle_t entry;                   /* Stands in for the chain on the host side */
+    _Atomic(multiprocess_sink_t) sink;       /* Receives the results of the last group (NULL = dropped) */
+    pthread_t drain_thread;                  /* Empties the last ring into the sink */
+    int draining;                            /* drain_thread is running */
+    pthread_t supervisor_thread;             /* Reaps the processes */
+    int supervising;                         /* supervisor_thread is running */
+    unsigned long items;                     /* Results that reached the host */
+    atomic_int failed;                       /* A process died or exited with an error */
+} multiprocess_t;
+
+/** 
+ * Split the chain into groups 
+ * @param processes Pointer to processes structure 
+ * @param spec Comma-separated group sizes, e.g. "2,1" (NULL = one process per plugin) 
+ * @param num_plugins Number of plugins in the chain 
+ * @return NULL on success, error message on failure 
+ */
+const char* multiprocess_set_groups(multiprocess_t* processes, const char* spec, int num_plugins);
+
+/** 
+ * Create the rings and fork a process per group - the plugins must be initialized inline and 
+ * attached to each other. Call before the host starts any thread of its own. 
+ * On success processes->entry takes the place of the chain: its place_work and place_work_meta 
+ * feed the first group, its attach_meta sets the sink for the results of the last group. 
+ * @param processes Pointer to processes structure 
+ * @param plugins The chain 
+ * @param queue_size Maximum number of items in each ring 
+ * @return NULL on success, error message on failure 
+ */
+const char* multiprocess_start(multiprocess_t* processes, plugin_handle_t* plugins, int queue_size);
+
+/** 
+ * Wait until the final <END> reached the host (or a process died) and every process exited, 
+ * then report how each one ended 
+ * @param processes Pointer to processes structure 
+ * @return NULL on success, error message if a process failed 
+ */
+const char* multiprocess_wait(multiprocess_t* processes);
+
+/** 
+ * Stop processes that are still running and unmap the rings 
+ * @param processes Pointer to processes structure 
+ */
+void multiprocess_close(multiprocess_t* processes);
+
+#endif
@@ -0,0 +1,149 @@
+#include "overload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parse a number of at most 9 digits that fills the whole text, returns -1 if it is not one
+static long parse_count(const char* text) {
+    size_t digits = strspn(text, "0123456789");
+    if (digits == 0 || digits > 9 || text[digits] != '\0') {
+        return -1;
+    }
+    return atol(text);
+}
+
+// Parse POLICY into a policy
+static const char* parse_policy(const char* text, overload_policy_t* policy) {
+    memset(policy, 0, sizeof(*policy));
+    if (strcmp(text, "block") == 0) {
+        policy->kind = OVERLOAD_BLOCK;
+        return NULL;
+    }
+    
+    if (strncmp(text, "block:", 6) == 0) {
+        long milliseconds = parse_count(text + 6);
+        if (milliseconds <= 0) {
+            return "Block timeout must be a positive number of milliseconds";
+        }
+        policy->kind = OVERLOAD_BLOCK;
+        policy->timeout_ns = milliseconds * 1000000LL;
+        return NULL;
+    }
+    
+    if (strcmp(text, "drop-newest") == 0) {
+        policy->kind = OVERLOAD_DROP_NEWEST;
+        return NULL;
+    }
+    
+    if (strcmp(text, "drop-oldest") == 0) {
+        policy->kind = OVERLOAD_DROP_OLDEST;
+        return NULL;
+    }
+    
+    if (strncmp(text, "sample:", 7) == 0) {
+        long every = parse_count(text + 7);
+        if (every <= 0) {
+            return "Sample rate must be a positive number";
+        }
+        policy->kind = OVERLOAD_SAMPLE;
+        policy->sample_every = every;
+        return NULL;
+    }
+    
+    return "Policy must be block, block:MS, drop-newest, drop-oldest or sample:N";
+}
+
+const char* overload_add_rule(overload_t* overload, const char* spec) {
+    if (overload->num_rules == OVERLOAD_MAX_RULES) {
+        return "Too many overload rules";
+    }
+    
+    overload_rule_t* rule = &overload->rules[overload->num_rules];
+    const char* separator = strchr(spec, '=');
+    if (separator == spec) {
+        return "Expected POLICY or NAME=POLICY";
+    }
+    
+    const char* error = parse_policy(separator ? separator + 1 : spec, &rule->policy);
+    if (error) {
+        return error;
+    }
+    
+    rule->stage = separator ? spec : NULL;
+    rule->stage_length = separator ? (size_t)(separator - spec) : 0;
+    overload->num_rules++;
+    return NULL;
+}
+
+int overload_has_timeout(const overload_t* overload) {
+    for (int i = 0; i < overload->num_rules; i++) {
+        if (overload->rules[i].policy.kind == OVERLOAD_BLOCK && overload->rules[i].policy.timeout_ns > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int names(const overload_rule_t* rule, const char* name) {
+    return rule->stage && strlen(name) == rule->stage_length && strncmp(rule->stage, name, rule->stage_length) == 0;
+}
+
+// Rule that decides the policy of a plugin (NULL = none, the plugin blocks)
+static const overload_rule_t* find_rule(const overload_t* overload, const char* name) {
+    const overload_rule_t* found = NULL;
+    for (int i = 0; i < overload->num_rules; i++) {
+        const overload_rule_t* rule = &overload->rules[i];
+        if (names(rule, name) || (!rule->stage && (!found || !found->stage))) {
+            found = rule;
+        }
+    }
+    return found;
+}
+
+const char* overload_apply(overload_t* overload, plugin_handle_t* plugins, int num_plugins) {
+    // A rule for a plugin that is not in the chain is most likely a typo
+    for (int i = 0; i < overload->num_rules; i++) {
+        int found = !overload->rules[i].stage;
+        for (int j = 0; j < num_plugins && !found; j++) {
+            found = names(&overload->rules[i], plugins[j].name);
+        }
+        if (!found) {
+            return "A rule names a plugin that is not in the chain";
+        }
+    }
+    
+    for (int i = 0; i < num_plugins; i++) {
+        const overload_rule_t* rule = find_rule(overload, plugins[i].name);
+        if (!rule) {
+            continue;
+        }
+        
+        if (!plugins[i].set_overload || !plugins[i].dropped) {
+            return "Plugin does not support overload policies";
+        }
+        plugins[i].set_overload(&rule->policy);
+    }
+    return NULL;
+}
+
+void overload_report(const overload_t* overload, plugin_handle_t* plugins, int num_plugins) {
+    for (int i = 0; i < num_plugins; i++) {
+        const overload_rule_t* rule = find_rule(overload, plugins[i].name);
+        if (!rule || !plugins[i].dropped) {
+            continue;
+        }
+        
+        const overload_policy_t* policy = &rule->policy;
+        char name[32];
+        if (policy->kind == OVERLOAD_BLOCK && policy->timeout_ns > 0) {
+            snprintf(name, sizeof(name), "block:%lld", policy->timeout_ns / 1000000LL);
+        } else if (policy->kind == OVERLOAD_SAMPLE) {
+            snprintf(name, sizeof(name), "sample:%u", policy->sample_every);
+        } else {
+            snprintf(name, sizeof(name), "%s", policy->kind == OVERLOAD_DROP_NEWEST ? "drop-newest" :
+                     policy->kind == OVERLOAD_DROP_OLDEST ? "drop-oldest" : "block");
+        }
+        
+        fprintf(stderr, "[STATS][overload] - %s: %s, %lu items dropped\n", plugins[i].name, name, plugins[i].dropped());
+    }
+}
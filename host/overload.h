@@ -0,0 +1,65 @@
+#ifndef HOST_OVERLOAD_H
+#define HOST_OVERLOAD_H
+
+#include <stddef.h>
+#include "plugin_host.h"
+
+/** 
+ * Overload policies of the plugin queues 
+ * Every rule sets the policy of one plugin, or of every plugin when it names none; a rule 
+ * naming the plugin wins over one for every plugin, and a later rule over an earlier one. 
+ * Policies are block (the default), block:MS, drop-newest, drop-oldest and sample:N, see 
+ * overload_policy_t. 
+ */
+
+// Maximum number of rules
+#define OVERLOAD_MAX_RULES 32
+
+typedef struct
+{
+    const char* stage;                       /* Plugin name (NULL = every plugin) */
+    size_t stage_length;                     /* Length of stage */
+    overload_policy_t policy;                /* Policy of the plugin's queue */
+} overload_rule_t;
+
+typedef struct
+{
+    overload_rule_t rules[OVERLOAD_MAX_RULES]; /* Rules in the order given */
+    int num_rules;                           /* Number of rules */
+} overload_t;
+
+/** 
+ * Add a rule 
+ * @param overload Pointer to overload structure 
+ * @param spec POLICY or NAME=POLICY (spec must outlive the rule) 
+ * @return NULL on success, error message on failure 
+ */
+const char* overload_add_rule(overload_t* overload, const char* spec);
+
+/** 
+ * Check whether a rule sets block:MS 
+ * @param overload Pointer to overload structure 
+ * @return 1 if some rule blocks with a timeout, 0 otherwise 
+ */
+int overload_has_timeout(const overload_t* overload);
+
+/** 
+ * Hand every plugin its policy - must be called before the plugins are initialized, and the 
+ * rules must outlive the plugins 
+ * @param overload Pointer to overload structure 
+ * @param plugins Loaded plugins, in chain order 
+ * @param num_plugins Number of plugins 
+ * @return NULL on success, error message on failure 
+ */
+const char* overload_apply(overload_t* overload, plugin_handle_t* plugins, int num_plugins);
+
+/** 
+ * Print the policy and the dropped items of every plugin that has a rule - call before the 
+ * plugins are finalized 
+ * @param overload Pointer to overload structure 
+ * @param plugins Loaded plugins, in chain order 
+ * @param num_plugins Number of plugins 
+ */
+void overload_report(const overload_t* overload, plugin_handle_t* plugins, int num_plugins);
+
+#endif
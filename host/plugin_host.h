@@ -0,0 +1,82 @@
+#ifndef PLUGIN_HOST_H
+#define PLUGIN_HOST_H
+
+#include "../plugins/plugin_sdk.h"
+
+/** 
+ * Host-side view of a loaded plugin (function pointers resolved with dlsym) 
+ */
+
+// Most taps the host plans on either side of one plugin (as many as a plugin accepts)
+#define PLUGIN_HOST_MAX_TAPS 8
+
+typedef const char* (*plugin_init_func_t)(int);
+typedef const char* (*plugin_fini_func_t)(void);
+typedef const char* (*plugin_place_work_func_t)(const char*);
+typedef void (*plugin_attach_func_t)(const char* (*)(const char*));
+typedef const char* (*plugin_wait_finished_func_t)(void);
+typedef const char* (*plugin_get_name_func_t)(void);
+typedef void (*plugin_set_ready_callback_func_t)(void (*)(void*), void*);
+typedef int (*plugin_run_slice_func_t)(int);
+typedef int (*plugin_try_place_work_func_t)(const char*, const work_meta_t*);
+typedef void (*plugin_attach_try_func_t)(int (*)(const char*, const work_meta_t*));
+typedef void (*plugin_set_room_callback_func_t)(void (*)(void*), void*);
+typedef const char* (*plugin_place_work_meta_func_t)(const char*, const work_meta_t*);
+typedef void (*plugin_attach_meta_func_t)(const char* (*)(const char*, const work_meta_t*));
+typedef int (*plugin_pending_func_t)(void);
+typedef void (*plugin_set_inline_func_t)(void);
+typedef void (*plugin_set_byte_budget_func_t)(size_t, byte_budget_t*, const char*);
+typedef void (*plugin_set_lane_weights_func_t)(const int*);
+typedef void (*plugin_set_perf_counters_func_t)(void);
+typedef void (*plugin_set_trace_func_t)(trace_t*, int);
+typedef const plugin_descriptor_t* (*plugin_get_descriptor_func_t)(void);
+typedef void (*plugin_set_patterns_func_t)(const char*, int);
+typedef void (*plugin_set_process_override_func_t)(const char* (*)(void*, const char*), void*);
+typedef void (*plugin_set_max_workers_func_t)(int);
+typedef int (*plugin_scale_workers_func_t)(int);
+typedef unsigned long long (*plugin_blocked_ns_func_t)(void);
+typedef void (*plugin_set_utf8_func_t)(int);
+typedef void (*plugin_set_overload_func_t)(const overload_policy_t*);
+typedef unsigned long (*plugin_dropped_func_t)(void);
+typedef void (*plugin_observe_func_t)(const char*, const work_meta_t*);
+typedef int (*plugin_add_tap_func_t)(void (*)(const char*, const work_meta_t*), int);
+
+typedef struct {
+    plugin_init_func_t init;
+    plugin_fini_func_t fini;
+    plugin_place_work_func_t place_work;
+    plugin_attach_func_t attach;
+    plugin_wait_finished_func_t wait_finished;
+    plugin_set_ready_callback_func_t set_ready_callback;    /* Optional - executor support */
+    plugin_run_slice_func_t run_slice;                      /* Optional - executor support */
+    plugin_try_place_work_func_t try_place_work;            /* Optional - executor support */
+    plugin_attach_try_func_t attach_try;                    /* Optional - executor support */
+    plugin_set_room_callback_func_t set_room_callback;      /* Optional - non-blocking producers */
+    plugin_pending_func_t pending;                          /* Optional - queue fill level */
+    plugin_set_inline_func_t set_inline;                    /* Optional - inline execution */
+    plugin_place_work_meta_func_t place_work_meta;          /* Optional - item metadata (stream ids) */
+    plugin_attach_meta_func_t attach_meta;                  /* Optional - item metadata (stream ids) */
+    plugin_set_byte_budget_func_t set_byte_budget;          /* Optional - byte budgets with spill to disk */
+    plugin_set_lane_weights_func_t set_lane_weights;        /* Optional - weighted priority lanes */
+    plugin_set_perf_counters_func_t set_perf_counters;      /* Optional - hardware counters per stage */
+    plugin_set_trace_func_t set_trace;                      /* Optional - timeline tracing */
+    plugin_get_descriptor_func_t get_descriptor;            /* Optional - transform composition */
+    plugin_set_process_override_func_t set_process_override; /* Optional - transform composition */
+    plugin_set_patterns_func_t set_patterns;                /* Optional - pattern filtering */
+    plugin_set_max_workers_func_t set_max_workers;          /* Optional - elastic consumer threads */
+    plugin_scale_workers_func_t scale_workers;              /* Optional - elastic consumer threads */
+    plugin_blocked_ns_func_t blocked_ns;                    /* Optional - producer blocked time */
+    plugin_set_utf8_func_t set_utf8;                        /* Optional - UTF-8 text */
+    plugin_set_overload_func_t set_overload;                /* Optional - load shedding */
+    plugin_dropped_func_t dropped;                          /* Optional - load shedding */
+    plugin_observe_func_t observe;                          /* Optional - tap plugins only */
+    plugin_add_tap_func_t add_tap;                          /* Optional - tap stages */
+    plugin_observe_func_t input_taps[PLUGIN_HOST_MAX_TAPS]; /* Taps planned in front of the plugin */
+    int num_input_taps;                                     /* Number of input_taps */
+    plugin_observe_func_t output_taps[PLUGIN_HOST_MAX_TAPS]; /* Taps planned behind the plugin */
+    int num_output_taps;                                    /* Number of output_taps */
+    char* name;
+    void* handle;
+} plugin_handle_t;
+
+#endif
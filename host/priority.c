@@ -0,0 +1,193 @@
+#include "priority.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* class_names[WORK_PRIORITY_CLASSES] = {"high", "normal", "low"};
+
+// The sinks are plain place_work functions, so they find the latency state here
+static priority_t* active_priority = NULL;
+
+static long long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Parse NAME=CLASS into a rule, the name is everything before the last '='
+static const char* parse_rule(const char* spec, priority_rule_t* rule) {
+    const char* separator = strrchr(spec, '=');
+    if (!separator || separator == spec) {
+        return "Expected NAME=CLASS";
+    }
+    
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        if (strcmp(separator + 1, class_names[i]) == 0) {
+            rule->match = spec;
+            rule->match_length = separator - spec;
+            rule->priority = WORK_PRIORITY_HIGH + i;
+            return NULL;
+        }
+    }
+    
+    return "Priority class must be high, normal or low";
+}
+
+const char* priority_add_rule(priority_t* priority, const char* spec) {
+    if (priority->num_rules == PRIORITY_MAX_RULES) {
+        return "Too many priority rules";
+    }
+    
+    const char* error = parse_rule(spec, &priority->rules[priority->num_rules]);
+    if (error) {
+        return error;
+    }
+    
+    priority->num_rules++;
+    priority->enabled = 1;
+    return NULL;
+}
+
+const char* priority_add_source(priority_t* priority, const char* spec) {
+    if (priority->num_sources == PRIORITY_MAX_RULES) {
+        return "Too many source priorities";
+    }
+    
+    const char* error = parse_rule(spec, &priority->sources[priority->num_sources]);
+    if (error) {
+        return error;
+    }
+    
+    priority->num_sources++;
+    priority->enabled = 1;
+    return NULL;
+}
+
+const char* priority_set_lanes(priority_t* priority, const char* spec) {
+    priority->enabled = 1;
+    if (strcmp(spec, "strict") == 0) {
+        memset(priority->weights, 0, sizeof(priority->weights));
+        return NULL;
+    }
+    
+    const char* cursor = spec;
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        size_t digits = strspn(cursor, "0123456789");
+        if (digits == 0 || digits > 6 || atoi(cursor) <= 0) {
+            return "Lane weights must be positive numbers";
+        }
+        priority->weights[i] = atoi(cursor);
+        cursor += digits;
+        
+        char expected = (i == WORK_PRIORITY_CLASSES - 1) ? '\0' : ',';
+        if (*cursor != expected) {
+            return "Expected strict or one weight per class (high,normal,low)";
+        }
+        cursor++;
+    }
+    
+    return NULL;
+}
+
+void priority_start(priority_t* priority) {
+    active_priority = priority;
+}
+
+void priority_stamp(const char* line, const char* source, work_meta_t* meta) {
+    priority_t* priority = active_priority;
+    if (!priority) {
+        return;
+    }
+    
+    meta->ingest_ns = now_ns();
+    meta->priority = WORK_PRIORITY_NORMAL;
+    
+    for (int i = 0; i < priority->num_rules; i++) {
+        if (strncmp(line, priority->rules[i].match, priority->rules[i].match_length) == 0) {
+            meta->priority = priority->rules[i].priority;
+            return;
+        }
+    }
+    
+    for (int i = 0; source && i < priority->num_sources; i++) {
+        priority_rule_t* setting = &priority->sources[i];
+        if (strlen(source) == setting->match_length && strncmp(source, setting->match, setting->match_length) == 0) {
+            meta->priority = setting->priority;
+            return;
+        }
+    }
+}
+
+void priority_record(const work_meta_t* meta) {
+    priority_t* priority = active_priority;
+    if (!priority || !meta || meta->ingest_ns == 0) {
+        return;
+    }
+    
+    int lane = WORK_PRIORITY_LANE(meta->priority);
+    if (lane < 0 || lane >= WORK_PRIORITY_CLASSES) {
+        return;
+    }
+    
+    long long elapsed = now_ns() - meta->ingest_ns;
+    int bucket = 0;
+    while (bucket < PRIORITY_LATENCY_BUCKETS - 1 && (1LL << bucket) <= elapsed) {
+        bucket++;
+    }
+    
+    priority_latency_t* latency = &priority->latency[lane];
+    latency->items++;
+    latency->total_ns += elapsed;
+    if (elapsed > latency->max_ns) {
+        latency->max_ns = elapsed;
+    }
+    latency->histogram[bucket]++;
+}
+
+const char* priority_sink(const char* str, const work_meta_t* meta) {
+    if (strcmp(str, "<END>") != 0) {
+        priority_record(meta);
+    }
+    return NULL;
+}
+
+// Upper bound of the bucket that holds the given fraction of the lines, capped at the slowest line
+static double percentile_us(const priority_latency_t* latency, double fraction) {
+    unsigned long wanted = (unsigned long)(latency->items * fraction + 0.999);
+    unsigned long seen = 0;
+    for (int i = 0; i < PRIORITY_LATENCY_BUCKETS; i++) {
+        seen += latency->histogram[i];
+        if (seen >= wanted) {
+            double bound = (double)(1LL << i);
+            return (bound < latency->max_ns ? bound : latency->max_ns) / 1000.0;
+        }
+    }
+    return latency->max_ns / 1000.0;
+}
+
+void priority_report(const priority_t* priority) {
+    if (!priority || !priority->enabled) {
+        return;
+    }
+    
+    if (priority->weights[0] > 0) {
+        fprintf(stderr, "[STATS][priority] - lanes: weighted round-robin %d,%d,%d\n",
+                priority->weights[0], priority->weights[1], priority->weights[2]);
+    } else {
+        fprintf(stderr, "[STATS][priority] - lanes: strict\n");
+    }
+    
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        const priority_latency_t* latency = &priority->latency[i];
+        if (latency->items == 0) {
+            fprintf(stderr, "[STATS][priority] - %s: 0 items\n", class_names[i]);
+            continue;
+        }
+        
+        fprintf(stderr, "[STATS][priority] - %s: %lu items, latency avg %.1f us, p50 <= %.1f us, "
+                "p99 <= %.1f us, max %.1f us\n", class_names[i], latency->items,
+                latency->total_ns / latency->items / 1000.0, percentile_us(latency, 0.5),
+                percentile_us(latency, 0.99), latency->max_ns / 1000.0);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef PRIORITY_H
+#define PRIORITY_H
+
+#include <stddef.h>
+#include "plugin_host.h"
+
+/** 
+ * Priority classes for incoming lines 
+ * A line gets the class of the first prefix rule it matches, else the class set for the 
+ * source it was read from, else the normal class. The queues keep one lane per class (see 
+ * consumer_producer_t). Lines are stamped with the time they entered the pipeline, and the 
+ * sink after the last plugin records the end-to-end latency of every class. 
+ */
+
+// Maximum number of prefix rules and of source settings
+#define PRIORITY_MAX_RULES 32
+
+// Latency histogram buckets, bucket b counts latencies below 2^b nanoseconds
+#define PRIORITY_LATENCY_BUCKETS 48
+
+typedef struct
+{
+    const char* match;                       /* Line prefix or source name */
+    size_t match_length;                     /* Length of match */
+    int priority;                            /* Class given on a match (one of WORK_PRIORITY_*) */
+} priority_rule_t;
+
+typedef struct
+{
+    unsigned long items;                     /* Lines that reached the sink */
+    double total_ns;                         /* Sum of their latencies */
+    double max_ns;                           /* Slowest line */
+    unsigned long histogram[PRIORITY_LATENCY_BUCKETS]; /* Lines per log2 latency bucket */
+} priority_latency_t;
+
+typedef struct
+{
+    priority_rule_t rules[PRIORITY_MAX_RULES];   /* Prefix rules, first match wins */
+    int num_rules;                           /* Number of prefix rules */
+    priority_rule_t sources[PRIORITY_MAX_RULES]; /* Class of each named source */
+    int num_sources;                         /* Number of source settings */
+    int weights[WORK_PRIORITY_CLASSES];      /* Round-robin lane weights (all 0 = strict priority) */
+    int enabled;                             /* A class or lane option was given */
+    priority_latency_t latency[WORK_PRIORITY_CLASSES]; /* Latency of each class, most urgent first */
+} priority_t;
+
+/** 
+ * Add a prefix rule 
+ * @param priority Pointer to priority structure 
+ * @param spec PREFIX=CLASS, CLASS is high, normal or low (spec must outlive the rule) 
+ * @return NULL on success, error message on failure 
+ */
+const char* priority_add_rule(priority_t* priority, const char* spec);
+
+/** 
+ * Set the class of every line read from a source 
+ * @param priority Pointer to priority structure 
+ * @param spec NAME=CLASS, NAME is the basename of an --input path (spec must outlive the setting) 
+ * @return NULL on success, error message on failure 
+ */
+const char* priority_add_source(priority_t* priority, const char* spec);
+
+/** 
+ * Choose how the queues take items from their lanes 
+ * @param priority Pointer to priority structure 
+ * @param spec "strict", or the comma separated round-robin weights of the high, normal and low lanes 
+ * @return NULL on success, error message on failure 
+ */
+const char* priority_set_lanes(priority_t* priority, const char* spec);
+
+/** 
+ * Make priority the state used by priority_stamp and priority_record 
+ * @param priority Pointer to priority structure (NULL to stop) 
+ */
+void priority_start(priority_t* priority);
+
+/** 
+ * Classify a line and stamp it with the current time - does nothing unless started 
+ * @param line Line that is about to be placed into the first plugin 
+ * @param source Name of the source it was read from (NULL if unnamed) 
+ * @param meta Metadata placed with the line, receives the class and the time 
+ */
+void priority_stamp(const char* line, const char* source, work_meta_t* meta);
+
+/** 
+ * Record the latency of a result that reached the end of the pipeline - called by the sinks 
+ * on the last plugin's thread, does nothing unless started 
+ * @param meta Result metadata 
+ */
+void priority_record(const work_meta_t* meta);
+
+/** 
+ * Sink for the last plugin's place_work_meta when reading stdin - only records latency 
+ * @param str Result string 
+ * @param meta Result metadata 
+ * @return NULL 
+ */
+const char* priority_sink(const char* str, const work_meta_t* meta);
+
+/** 
+ * Print the lane policy and the latency of every class 
+ * @param priority Pointer to priority structure 
+ */
+void priority_report(const priority_t* priority);
+
+#endif
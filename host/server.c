@@ -0,0 +1,677 @@
+#include "server.h"
+#include "capture.h"
+#include "priority.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_MAX_EVENTS 64
+
+// epoll tags above the connection slots
+#define SERVER_TAG_UNIX    (SERVER_MAX_CONNECTIONS + 0)
+#define SERVER_TAG_TCP     (SERVER_MAX_CONNECTIONS + 1)
+#define SERVER_TAG_WAKE    (SERVER_MAX_CONNECTIONS + 2)
+#define SERVER_TAG_SIGNAL  (SERVER_MAX_CONNECTIONS + 3)
+
+// The sink is a plain place_work function, so it finds its connections here
+static server_t* active_server = NULL;
+
+static int watch_fd(server_t* server, int fd, unsigned int events, uint64_t tag) {
+    struct epoll_event event = {0};
+    event.events = events;
+    event.data.u64 = tag;
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static int set_nonblocking(int fd) {
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static int open_unix_listener(const char* path) {
+    struct sockaddr_un address = {0};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+    
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    set_nonblocking(fd);
+    return fd;
+}
+
+static int open_tcp_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    set_nonblocking(fd);
+    return fd;
+}
+
+static server_connection_t* find_connection(server_t* server, int id) {
+    if (!server || id < 1) {
+        return NULL;
+    }
+    
+    server_connection_t* connection = &server->connections[(id - 1) % SERVER_MAX_CONNECTIONS];
+    return (connection->fd >= 0 && connection->id == id) ? connection : NULL;
+}
+
+static void accept_connections(server_t* server, int listener) {
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        
+        int slot = -1;
+        for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+            if (server->connections[i].fd < 0 && !server->connections[i].end_pending) {
+                slot = i;
+                break;
+            }
+        }
+        
+        if (slot < 0) {
+            close(fd);
+            continue;
+        }
+        
+        set_nonblocking(fd);
+        server_connection_t* connection = &server->connections[slot];
+        
+        pthread_mutex_lock(&server->mutex);
+        memset(connection, 0, sizeof(*connection));
+        connection->fd = fd;
+        connection->id = server->next_generation * SERVER_MAX_CONNECTIONS + slot + 1;
+        connection->events = EPOLLIN;
+        pthread_mutex_unlock(&server->mutex);
+        
+        // Stream ids stay positive and unique until the generation counter wraps around
+        server->next_generation = (server->next_generation + 1) % (0x7fffffff / SERVER_MAX_CONNECTIONS - 1);
+        
+        if (watch_fd(server, fd, connection->events, (uint64_t)slot) != 0) {
+            close(fd);
+            connection->fd = -1;
+            continue;
+        }
+        connection->watched = 1;
+        server->active_connections++;
+    }
+}
+
+// Place the complete line into the pipeline without waiting - returns 0 once it is placed, 1 while
+// the first queue is full and -1 on error. A line of <END> closes the connection's stream
+static int place_line(server_connection_t* connection, plugin_handle_t* first, const char** error) {
+    int end = strcmp(connection->line, "<END>") == 0;
+    work_meta_t meta = {0};
+    meta.stream = connection->id;
+    if (!end) {
+        priority_stamp(connection->line, NULL, &meta);
+    }
+    
+    // Without a non-blocking entry the line waits for room as before
+    int result;
+    if (first->try_place_work) {
+        result = first->try_place_work(connection->line, &meta);
+    } else {
+        *error = first->place_work_meta(connection->line, &meta);
+        result = *error ? -1 : 0;
+    }
+    
+    if (result == 1) {
+        return 1;
+    }
+    if (result < 0) {
+        if (!*error) {
+            *error = "Failed to place a line into the pipeline";
+        }
+        return -1;
+    }
+    
+    connection->line_ready = 0;
+    connection->line_length = 0;
+    if (end) {
+        connection->input_ended = 1;
+    } else {
+        capture_record(connection->line);
+    }
+    return 0;
+}
+
+// Split the bytes read so far into lines and place them - returns 1 if the first queue is full,
+// then everything not placed yet stays in the connection for the next try
+static int drain_connection(server_connection_t* connection, plugin_handle_t* first, const char** error) {
+    while (!connection->input_ended) {
+        if (connection->line_ready) {
+            int result = place_line(connection, first, error);
+            if (result != 0) {
+                return result;
+            }
+            continue;
+        }
+        
+        if (connection->chunk_start < connection->chunk_length) {
+            char c = connection->chunk[connection->chunk_start++];
+            if (c != '\n') {
+                connection->line[connection->line_length++] = c;
+                if (connection->line_length < SERVER_LINE_MAX) {
+                    continue;
+                }
+            }
+            connection->line[connection->line_length] = '\0';
+            connection->line_ready = 1;
+            continue;
+        }
+        
+        if (!connection->input_closed) {
+            return 0;
+        }
+        
+        // The client is done sending - its last partial line and then its <END> go in, its
+        // results are still delivered
+        if (connection->line_length == 0) {
+            strcpy(connection->line, "<END>");
+        } else {
+            connection->line[connection->line_length] = '\0';
+        }
+        connection->line_ready = 1;
+    }
+    return 0;
+}
+
+// Close the stream towards the pipeline without waiting (a tagged <END> closes only this stream) -
+// returns 1 while the first queue is full, the <END> then stays pending on the slot
+static int end_input(server_connection_t* connection, plugin_handle_t* first, const char** error) {
+    if (connection->input_ended) {
+        return 0;
+    }
+    
+    // Whatever the client still had in flight is dropped, nobody reads its results
+    strcpy(connection->line, "<END>");
+    connection->line_ready = 1;
+    int result = place_line(connection, first, error);
+    connection->end_pending = result == 1;
+    return result;
+}
+
+// Close the socket - the slot stays taken while its <END> waits for room in the first queue
+static void close_connection(server_t* server, server_connection_t* connection, plugin_handle_t* first) {
+    const char* error = NULL;
+    end_input(connection, first, &error);
+    
+    pthread_mutex_lock(&server->mutex);
+    if (connection->watched) {
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    }
+    close(connection->fd);
+    connection->fd = -1;
+    free(connection->output);
+    connection->output = NULL;
+    connection->output_length = 0;
+    connection->output_capacity = 0;
+    pthread_mutex_unlock(&server->mutex);
+    
+    if (!connection->end_pending) {
+        server->active_connections--;
+    }
+}
+
+// Read one chunk per event, so a busy client cannot starve the others
+static const char* read_connection(server_t* server, server_connection_t* connection, plugin_handle_t* first) {
+    // The previous chunk is not placed yet, it is retried once the first queue has room
+    if (connection->blocked) {
+        return NULL;
+    }
+    
+    ssize_t bytes = recv(connection->fd, connection->chunk, sizeof(connection->chunk), 0);
+    if (bytes < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return NULL;
+        }
+        close_connection(server, connection, first);
+        return NULL;
+    }
+    
+    connection->chunk_start = 0;
+    connection->chunk_length = (size_t)bytes;
+    if (bytes == 0) {
+        connection->input_closed = 1;
+    }
+    
+    const char* error = NULL;
+    connection->blocked = drain_connection(connection, first, &error) == 1;
+    return error;
+}
+
+// Write as much queued output as the socket takes, returns -1 if the client is gone
+static int flush_connection(server_t* server, server_connection_t* connection) {
+    int result = 0;
+    
+    pthread_mutex_lock(&server->mutex);
+    size_t written = 0;
+    while (written < connection->output_length) {
+        ssize_t bytes = send(connection->fd, connection->output + written,
+                             connection->output_length - written, MSG_NOSIGNAL);
+        if (bytes > 0) {
+            written += (size_t)bytes;
+            continue;
+        }
+        
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            break;
+        }
+        
+        result = -1;
+        break;
+    }
+    
+    memmove(connection->output, connection->output + written, connection->output_length - written);
+    connection->output_length -= written;
+    pthread_mutex_unlock(&server->mutex);
+    return result;
+}
+
+// Register interest in reading only while the pipeline and the connection have room. A blocked
+// connection with nothing to write leaves the epoll set, which would report its EPOLLHUP over
+// and over - the room callback brings the loop back once the first queue can take its lines
+static void update_events(server_t* server, server_connection_t* connection) {
+    pthread_mutex_lock(&server->mutex);
+    size_t output_length = connection->output_length;
+    pthread_mutex_unlock(&server->mutex);
+    
+    unsigned int events = 0;
+    if (!connection->input_ended && !connection->blocked && output_length < SERVER_MAX_CONNECTION_OUTPUT) {
+        events |= EPOLLIN;
+    }
+    if (output_length > 0) {
+        events |= EPOLLOUT;
+    }
+    
+    int watched = events != 0 || !connection->blocked;
+    if (watched != connection->watched || events != connection->events) {
+        struct epoll_event event = {0};
+        event.events = events;
+        event.data.u64 = (uint64_t)(connection - server->connections);
+        int operation = !watched ? EPOLL_CTL_DEL : connection->watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        epoll_ctl(server->epoll_fd, operation, connection->fd, &event);
+        connection->watched = watched;
+        connection->events = events;
+    }
+}
+
+static const char* stop_listening(server_t* server, plugin_handle_t* first) {
+    server->stopping = 1;
+    
+    if (server->unix_fd >= 0) {
+        close(server->unix_fd);
+        server->unix_fd = -1;
+    }
+    if (server->tcp_fd >= 0) {
+        close(server->tcp_fd);
+        server->tcp_fd = -1;
+    }
+    
+    // Every connection ends as if its client closed its side - the <END> goes in behind the lines
+    // already read, a blocked connection places it once the first queue has room
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+        server_connection_t* connection = &server->connections[i];
+        if (connection->fd < 0) {
+            continue;
+        }
+        
+        connection->input_closed = 1;
+        if (!connection->blocked) {
+            const char* error = NULL;
+            connection->blocked = drain_connection(connection, first, &error) == 1;
+            if (error) {
+                return error;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Room callback of the first plugin - runs on a plugin thread
+static void server_room(void* arg) {
+    server_t* server = (server_t*)arg;
+    uint64_t one = 1;
+    if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+        // Only fails once the counter is about to overflow, the loop is woken anyway
+    }
+}
+
+const char* server_open(server_t* server, const char* unix_path, int tcp_port) {
+    if (!server || (!unix_path && tcp_port <= 0)) {
+        return "Invalid parameters entered to server_open";
+    }
+    
+    memset(server, 0, sizeof(*server));
+    server->unix_fd = -1;
+    server->tcp_fd = -1;
+    server->wake_fd = -1;
+    server->signal_fd = -1;
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+        server->connections[i].fd = -1;
+    }
+    pthread_mutex_init(&server->mutex, NULL);
+    
+    server->epoll_fd = epoll_create1(0);
+    if (server->epoll_fd < 0) {
+        server_close(server);
+        return "Failed to create epoll instance";
+    }
+    
+    // Threads created later inherit the blocked mask, so only the signalfd sees these
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    server->signal_fd = signalfd(-1, &signals, SFD_NONBLOCK);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (server->signal_fd < 0 || server->wake_fd < 0 ||
+        watch_fd(server, server->signal_fd, EPOLLIN, SERVER_TAG_SIGNAL) != 0 ||
+        watch_fd(server, server->wake_fd, EPOLLIN, SERVER_TAG_WAKE) != 0) {
+        server_close(server);
+        return "Failed to set up server events";
+    }
+    
+    if (unix_path) {
+        server->unix_fd = open_unix_listener(unix_path);
+        if (server->unix_fd < 0 || watch_fd(server, server->unix_fd, EPOLLIN, SERVER_TAG_UNIX) != 0) {
+            fprintf(stderr, "Error listening on %s: %s\n", unix_path, strerror(errno));
+            server_close(server);
+            return "Failed to listen on unix socket";
+        }
+        server->unix_path = unix_path;
+    }
+    
+    if (tcp_port > 0) {
+        server->tcp_fd = open_tcp_listener(tcp_port);
+        if (server->tcp_fd < 0 || watch_fd(server, server->tcp_fd, EPOLLIN, SERVER_TAG_TCP) != 0) {
+            fprintf(stderr, "Error listening on 127.0.0.1:%d: %s\n", tcp_port, strerror(errno));
+            server_close(server);
+            return "Failed to listen on tcp port";
+        }
+    }
+    
+    active_server = server;
+    return NULL;
+}
+
+static const char* serve(server_t* server, plugin_handle_t* first) {
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int blocked = 0;
+    int next_retry = 0;
+    
+    // Without a room callback nothing says when the first queue has room, so it is polled
+    int poll_ms = first->set_room_callback ? -1 : SERVER_BACKPRESSURE_POLL_MS;
+    
+    while (!server->stopping || server->active_connections > 0) {
+        int ready = epoll_wait(server->epoll_fd, events, SERVER_MAX_EVENTS, blocked ? poll_ms : -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return "Failed to wait for server events";
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            uint64_t tag = events[i].data.u64;
+            
+            if (tag == SERVER_TAG_UNIX || tag == SERVER_TAG_TCP) {
+                int listener = (tag == SERVER_TAG_UNIX) ? server->unix_fd : server->tcp_fd;
+                if (listener >= 0) {
+                    accept_connections(server, listener);
+                }
+
+            } else if (tag == SERVER_TAG_WAKE) {
+                uint64_t count;
+                while (read(server->wake_fd, &count, sizeof(count)) > 0) {
+                }
+
+            } else if (tag == SERVER_TAG_SIGNAL) {
+                struct signalfd_siginfo info;
+                while (read(server->signal_fd, &info, sizeof(info)) > 0) {
+                }
+                const char* error = stop_listening(server, first);
+                if (error) {
+                    return error;
+                }
+
+            } else {
+                server_connection_t* connection = &server->connections[tag];
+                if (connection->fd < 0) {
+                    continue;
+                }
+                
+                if (!connection->input_ended && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                    const char* error = read_connection(server, connection, first);
+                    if (error) {
+                        return error;
+                    }
+
+                } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    // Both directions are gone, nobody is left to receive the results
+                    close_connection(server, connection, first);
+                }
+            }
+        }
+        
+        // Connections whose lines did not fit go on where they stopped - the next round starts
+        // behind the first one that got room, so they take turns at the room that frees up
+        blocked = 0;
+        int served = -1;
+        for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+            int slot = (next_retry + i) % SERVER_MAX_CONNECTIONS;
+            server_connection_t* connection = &server->connections[slot];
+            if (connection->end_pending) {
+                // The client is gone, only its <END> is still owed to the pipeline
+                const char* error = NULL;
+                if (end_input(connection, first, &error) < 0) {
+                    return error;
+                }
+                if (!connection->end_pending) {
+                    server->active_connections--;
+                    if (served < 0) {
+                        served = slot;
+                    }
+                }
+                blocked |= connection->end_pending;
+                continue;
+            }
+            if (connection->fd < 0 || !connection->blocked) {
+                continue;
+            }
+            
+            size_t chunk_start = connection->chunk_start;
+            int line_ready = connection->line_ready;
+            const char* error = NULL;
+            connection->blocked = drain_connection(connection, first, &error) == 1;
+            if (error) {
+                return error;
+            }
+            
+            if (served < 0 && (connection->chunk_start != chunk_start || connection->line_ready != line_ready ||
+                               !connection->blocked)) {
+                served = slot;
+            }
+            blocked |= connection->blocked;
+        }
+        if (served >= 0) {
+            next_retry = (served + 1) % SERVER_MAX_CONNECTIONS;
+        }
+        
+        for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+            server_connection_t* connection = &server->connections[i];
+            if (connection->fd < 0) {
+                continue;
+            }
+            
+            if (flush_connection(server, connection) != 0) {
+                close_connection(server, connection, first);
+                blocked |= connection->end_pending;
+                continue;
+            }
+            
+            pthread_mutex_lock(&server->mutex);
+            int done = connection->input_ended && connection->results_ended && connection->output_length == 0;
+            pthread_mutex_unlock(&server->mutex);
+            
+            if (done) {
+                close_connection(server, connection, first);
+                continue;
+            }
+            
+            update_events(server, connection);
+        }
+    }
+    
+    return NULL;
+}
+
+const char* server_run(server_t* server, plugin_handle_t* first) {
+    if (!server || !first || !first->place_work_meta) {
+        return "Invalid parameters entered to server_run";
+    }
+    
+    if (first->set_room_callback) {
+        first->set_room_callback(server_room, server);
+    }
+    
+    const char* error = serve(server, first);
+    
+    if (first->set_room_callback) {
+        first->set_room_callback(NULL, NULL);
+    }
+    return error;
+}
+
+const char* server_sink(const char* str, const work_meta_t* meta) {
+    server_t* server = active_server;
+    if (!server || !meta) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&server->mutex);
+    server_connection_t* connection = find_connection(server, meta->stream);
+    if (!connection) {
+        // The final untagged <END>, or the client is already gone
+        pthread_mutex_unlock(&server->mutex);
+        return NULL;
+    }
+    
+    if (strcmp(str, "<END>") == 0) {
+        connection->results_ended = 1;
+
+    } else {
+        priority_record(meta);
+        size_t length = strlen(str);
+        if (connection->output_length + length + 1 > connection->output_capacity) {
+            size_t capacity = connection->output_capacity ? connection->output_capacity : SERVER_READ_CHUNK;
+            while (connection->output_length + length + 1 > capacity) {
+                capacity *= 2;
+            }
+            
+            char* output = (char*)realloc(connection->output, capacity);
+            if (!output) {
+                pthread_mutex_unlock(&server->mutex);
+                return "Failed to allocate memory for connection output";
+            }
+            connection->output = output;
+            connection->output_capacity = capacity;
+        }
+        
+        memcpy(connection->output + connection->output_length, str, length);
+        connection->output[connection->output_length + length] = '\n';
+        connection->output_length += length + 1;
+    }
+    pthread_mutex_unlock(&server->mutex);
+    
+    // Wake the epoll loop so it writes the result out
+    uint64_t one = 1;
+    if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+        return "Failed to wake the server";
+    }
+    return NULL;
+}
+
+void server_close(server_t* server) {
+    if (!server) {
+        return;
+    }
+    
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++) {
+        if (server->connections[i].fd >= 0) {
+            close(server->connections[i].fd);
+            server->connections[i].fd = -1;
+        }
+        free(server->connections[i].output);
+        server->connections[i].output = NULL;
+    }
+    
+    if (server->unix_fd >= 0) {
+        close(server->unix_fd);
+    }
+    if (server->unix_path) {
+        unlink(server->unix_path);
+    }
+    if (server->tcp_fd >= 0) {
+        close(server->tcp_fd);
+    }
+    if (server->wake_fd >= 0) {
+        close(server->wake_fd);
+    }
+    if (server->signal_fd >= 0) {
+        close(server->signal_fd);
+    }
+    if (server->epoll_fd >= 0) {
+        close(server->epoll_fd);
+    }
+    
+    if (active_server == server) {
+        active_server = NULL;
+    }
+    pthread_mutex_destroy(&server->mutex);
+}
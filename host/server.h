@@ -0,0 +1,107 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include "plugin_host.h"
+
+/** 
+ * Local socket server mode 
+ * Listens on a Unix domain socket and/or a loopback TCP port and serves many clients through 
+ * one epoll loop. Every connection is an ingest stream: its lines are tagged with the 
+ * connection's stream id, pushed into the running plugin chain, and the results are sent 
+ * back on the same connection. A client's <END> (or closing its side) ends its stream; the 
+ * connection is closed once all of its results were written. SIGINT/SIGTERM stop the server. 
+ * Lines are placed without waiting: a full first queue leaves the rest of the client's bytes 
+ * in its connection and stops reading from that client only, until the queue has room again. 
+ * The first plugin's room callback wakes the loop then; a blocked connection with nothing to 
+ * write leaves the epoll set meanwhile. A gone client's <END> waits in its slot the same way. 
+ */
+
+// Maximum number of simultaneous client connections
+#define SERVER_MAX_CONNECTIONS 1024
+
+// Longest line passed on as one item (longer lines are split)
+#define SERVER_LINE_MAX 1024
+
+// Stop reading a connection while this many result bytes wait to be sent to it
+#define SERVER_MAX_CONNECTION_OUTPUT (1024 * 1024)
+
+// How often the lines of blocked connections are offered to the first queue again when it has no
+// room callback, e.g. the ring in front of stage processes (milliseconds)
+#define SERVER_BACKPRESSURE_POLL_MS 5
+
+// Bytes read from a connection at once
+#define SERVER_READ_CHUNK 4096
+
+typedef struct
+{
+    int fd;                                  /* Client socket (-1 = free slot unless end_pending) */
+    int id;                                  /* Stream id carried in work_meta_t */
+    char line[SERVER_LINE_MAX + 1];          /* Partial line read so far */
+    size_t line_length;                      /* Bytes used in line */
+    int line_ready;                          /* line is complete and waits for room in the first queue */
+    char chunk[SERVER_READ_CHUNK];           /* Bytes read but not split into lines yet */
+    size_t chunk_start;                      /* First unconsumed byte of chunk */
+    size_t chunk_length;                     /* Bytes used in chunk */
+    int input_closed;                        /* The client shut its side, <END> still has to go in */
+    int blocked;                             /* The first queue was full, reading waits until it has room */
+    char* output;                            /* Results waiting to be written */
+    size_t output_length;                    /* Bytes used in output */
+    size_t output_capacity;                  /* Bytes allocated for output */
+    unsigned int events;                     /* epoll events currently registered */
+    int watched;                             /* fd is in the epoll set */
+    int end_pending;                         /* The client is gone, its <END> waits for room in the first queue */
+    int input_ended;                         /* <END> or EOF seen, stream closed towards the pipeline */
+    int results_ended;                       /* The stream's <END> came out of the pipeline */
+} server_connection_t;
+
+typedef struct
+{
+    int unix_fd;                             /* Unix domain listener (-1 if not used) */
+    int tcp_fd;                              /* Loopback TCP listener (-1 if not used) */
+    const char* unix_path;                   /* Socket path, removed on close */
+    int epoll_fd;                            /* epoll instance */
+    int wake_fd;                             /* eventfd written by the sink when output is queued */
+    int signal_fd;                           /* signalfd for SIGINT/SIGTERM */
+    int stopping;                            /* Shutdown requested */
+    int next_generation;                     /* Makes stream ids unique across slot reuse */
+    int active_connections;                  /* Connections not closed yet or still owing their <END> */
+    pthread_mutex_t mutex;                   /* Protects connection output (the sink runs on a plugin thread) */
+    server_connection_t connections[SERVER_MAX_CONNECTIONS];
+} server_t;
+
+/** 
+ * Create the listeners - must be called before the plugins start their threads, 
+ * so SIGINT/SIGTERM stay blocked in every thread and are only seen by the server 
+ * @param server Pointer to server structure 
+ * @param unix_path Unix domain socket path (NULL for none) 
+ * @param tcp_port Loopback TCP port (0 for none) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* server_open(server_t* server, const char* unix_path, int tcp_port);
+
+/** 
+ * Serve clients until SIGINT/SIGTERM, then finish every open connection 
+ * Does not send the final (untagged) <END> that shuts the pipeline down 
+ * @param server Pointer to server structure 
+ * @param first First plugin of the chain 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* server_run(server_t* server, plugin_handle_t* first);
+
+/** 
+ * Sink for the last plugin's place_work_meta - queues each result for its connection 
+ * @param str Result string 
+ * @param meta Result metadata (stream id) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* server_sink(const char* str, const work_meta_t* meta);
+
+/** 
+ * Close the listeners and every connection 
+ * @param server Pointer to server structure 
+ */ 
+void server_close(server_t* server);
+
+#endif
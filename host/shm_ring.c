@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include "shm_ring.h"
+#include <limits.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Marks the unused end of the data area, the next record starts at offset 0
+#define SHM_RING_WRAP UINT_MAX
+
+// Record in the data area: header followed by the item bytes and their terminator
+typedef struct
+{
+    unsigned int length;                     /* Item length (SHM_RING_WRAP = continue at offset 0) */
+    unsigned int size;                       /* Bytes of header, item and padding */
+    work_meta_t meta;
+} shm_record_t;
+
+static unsigned long record_size(size_t length) {
+    return (sizeof(shm_record_t) + length + 1 + 7) & ~7UL;
+}
+
+// The futex words live in a shared mapping, so they must not use FUTEX_PRIVATE_FLAG
+static void futex_wait(atomic_uint* word, unsigned int seen) {
+    struct timespec timeout = {0, SHM_RING_WAIT_NS};
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT, seen, &timeout, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* word) {
+    atomic_fetch_add(word, 1);
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static int has_space(shm_ring_header_t* header, unsigned long tail, unsigned long needed) {
+    unsigned long head = atomic_load_explicit(&header->head, memory_order_acquire);
+    unsigned long items = atomic_load_explicit(&header->items_put, memory_order_relaxed) -
+                          atomic_load_explicit(&header->items_taken, memory_order_acquire);
+    return tail + needed - head <= header->capacity && items < header->max_items;
+}
+
+static int has_data(shm_ring_header_t* header, unsigned long head) {
+    return atomic_load_explicit(&header->tail, memory_order_acquire) != head;
+}
+
+const char* shm_ring_create(shm_ring_t* ring, size_t bytes, int max_items) {
+    if (!ring || max_items <= 0) {
+        return "Invalid parameters entered to shm_ring_create";
+    }
+    
+    memset(ring, 0, sizeof(*ring));
+    unsigned long capacity = 4096;
+    while (capacity < bytes) {
+        capacity <<= 1;
+    }
+    
+    size_t mapped = sizeof(shm_ring_header_t) + capacity;
+    int fd = memfd_create("pipeline-ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        return "Failed to create shared memory";
+    }
+    
+    if (ftruncate(fd, mapped) != 0) {
+        close(fd);
+        return "Failed to size shared memory";
+    }
+    
+    // The mapping keeps the memory alive, the descriptor is not needed any more
+    void* memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return "Failed to map shared memory";
+    }
+    
+    // A new memfd is zero-filled, which is the empty ring
+    ring->header = (shm_ring_header_t*)memory;
+    ring->header->capacity = capacity;
+    ring->header->max_items = max_items;
+    ring->data = (char*)memory + sizeof(shm_ring_header_t);
+    ring->mapped = mapped;
+    return NULL;
+}
+
+// Write an item at the tail and wake a sleeping consumer - the caller has checked for space
+static void publish(shm_ring_t* ring, unsigned long tail, unsigned long skip, const char* item, size_t length, const work_meta_t* meta) {
+    static const work_meta_t default_meta = {0};
+    shm_ring_header_t* header = ring->header;
+    unsigned long offset = skip > 0 ? 0 : tail & (header->capacity - 1);
+    unsigned long size = record_size(length);
+    
+    if (skip >= sizeof(shm_record_t)) {
+        ((shm_record_t*)(ring->data + (tail & (header->capacity - 1))))->length = SHM_RING_WRAP;
+    }
+    
+    shm_record_t* record = (shm_record_t*)(ring->data + offset);
+    record->length = length;
+    record->size = size;
+    record->meta = meta ? *meta : default_meta;
+    memcpy(record + 1, item, length + 1);
+    
+    // Count the item before publishing it, so the count never goes below zero
+    atomic_fetch_add_explicit(&header->items_put, 1, memory_order_relaxed);
+    atomic_store_explicit(&header->tail, tail + skip + size, memory_order_release);
+    
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&header->consumer_waiting, memory_order_relaxed)) {
+        futex_wake(&header->data_seq);
+    }
+}
+
+// Bytes skipped at the end of the data area before a record of size bytes (0 if it fits)
+static unsigned long wrap_skip(shm_ring_header_t* header, unsigned long tail, unsigned long size) {
+    unsigned long offset = tail & (header->capacity - 1);
+    return offset + size > header->capacity ? header->capacity - offset : 0;
+}
+
+const char* shm_ring_put(shm_ring_t* ring, const char* item, const work_meta_t* meta) {
+    shm_ring_header_t* header = ring->header;
+    
+    size_t length = strlen(item);
+    unsigned long size = record_size(length);
+    if (size > header->capacity / 2) {
+        return "Item too large for the shared ring";
+    }
+    
+    // A record that does not fit before the end of the data area starts over at offset 0
+    unsigned long tail = atomic_load_explicit(&header->tail, memory_order_relaxed);
+    unsigned long skip = wrap_skip(header, tail, size);
+    
+    int yields = 0;
+    while (!has_space(header, tail, skip + size)) {
+        if (atomic_load(&header->broken)) {
+            return "Shared ring is broken";
+        }
+        
+        // Let the consumer catch up before paying for a sleep and a wakeup
+        if (yields++ < SHM_RING_YIELDS) {
+            sched_yield();
+            continue;
+        }
+        
+        // Announce the sleep before looking again, the consumer wakes us only if it sees it
+        unsigned int seen = atomic_load(&header->space_seq);
+        atomic_store(&header->producer_waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!has_space(header, tail, skip + size) && !atomic_load(&header->broken)) {
+            futex_wait(&header->space_seq, seen);
+        }
+        atomic_store(&header->producer_waiting, 0);
+    }
+    
+    if (atomic_load_explicit(&header->broken, memory_order_relaxed)) {
+        return "Shared ring is broken";
+    }
+    
+    publish(ring, tail, skip, item, length, meta);
+    return NULL;
+}
+
+int shm_ring_try_put(shm_ring_t* ring, const char* item, const work_meta_t* meta) {
+    shm_ring_header_t* header = ring->header;
+    
+    size_t length = strlen(item);
+    unsigned long size = record_size(length);
+    if (size > header->capacity / 2 || atomic_load(&header->broken)) {
+        return -1;
+    }
+    
+    unsigned long tail = atomic_load_explicit(&header->tail, memory_order_relaxed);
+    unsigned long skip = wrap_skip(header, tail, size);
+    if (!has_space(header, tail, skip + size)) {
+        return 1;
+    }
+    
+    publish(ring, tail, skip, item, length, meta);
+    return 0;
+}
+
+const char* shm_ring_get(shm_ring_t* ring, work_meta_t* meta) {
+    shm_ring_header_t* header = ring->header;
+    unsigned long head = atomic_load_explicit(&header->head, memory_order_relaxed);
+    
+    int yields = 0;
+    while (!has_data(header, head)) {
+        if (atomic_load(&header->broken)) {
+            return NULL;
+        }
+        
+        // Let the producer put a few more items before paying for a sleep and a wakeup
+        if (yields++ < SHM_RING_YIELDS) {
+            sched_yield();
+            continue;
+        }
+        
+        unsigned int seen = atomic_load(&header->data_seq);
+        atomic_store(&header->consumer_waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!has_data(header, head) && !atomic_load(&header->broken)) {
+            futex_wait(&header->data_seq, seen);
+        }
+        atomic_store(&header->consumer_waiting, 0);
+    }
+    
+    if (atomic_load_explicit(&header->broken, memory_order_relaxed)) {
+        return NULL;
+    }
+    
+    unsigned long offset = head & (header->capacity - 1);
+    unsigned long skip = 0;
+    if (header->capacity - offset < sizeof(shm_record_t) ||
+        ((shm_record_t*)(ring->data + offset))->length == SHM_RING_WRAP) {
+        skip = header->capacity - offset;
+        offset = 0;
+    }
+    
+    shm_record_t* record = (shm_record_t*)(ring->data + offset);
+    if (meta) {
+        *meta = record->meta;
+    }
+    
+    ring->pending = skip + record->size;
+    return (const char*)(record + 1);
+}
+
+void shm_ring_release(shm_ring_t* ring) {
+    shm_ring_header_t* header = ring->header;
+    if (ring->pending == 0) {
+        return;
+    }
+    
+    unsigned long head = atomic_load_explicit(&header->head, memory_order_relaxed);
+    atomic_fetch_add_explicit(&header->items_taken, 1, memory_order_relaxed);
+    atomic_store_explicit(&header->head, head + ring->pending, memory_order_release);
+    ring->pending = 0;
+    
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&header->producer_waiting, memory_order_relaxed)) {
+        futex_wake(&header->space_seq);
+    }
+}
+
+int shm_ring_count(shm_ring_t* ring) {
+    shm_ring_header_t* header = ring->header;
+    unsigned long taken = atomic_load(&header->items_taken);
+    return (int)(atomic_load(&header->items_put) - taken);
+}
+
+void shm_ring_break(shm_ring_t* ring) {
+    if (!ring->header) {
+        return;
+    }
+    
+    atomic_store(&ring->header->broken, 1);
+    futex_wake(&ring->header->data_seq);
+    futex_wake(&ring->header->space_seq);
+}
+
+void shm_ring_destroy(shm_ring_t* ring) {
+    if (!ring || !ring->header) {
+        return;
+    }
+    
+    munmap(ring->header, ring->mapped);
+    ring->header = NULL;
+    ring->data = NULL;
+}
@@ -0,0 +1,111 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include "../plugins/sync/work_meta.h"
+
+/** 
+ * Single-producer single-consumer ring in shared memory 
+ * The ring lives in a memfd mapping that is inherited across fork, so the producer and the 
+ * consumer may be different processes. Items are written straight into the ring with their 
+ * metadata and handed to the consumer in place - nothing is copied out and nothing is freed. 
+ * Like a consumer_producer_t queue it holds at most max_items items and blocks the producer 
+ * while full and the consumer while empty; sleeping sides are woken through a futex and only 
+ * when they announced that they sleep. Once a peer died the ring is broken and every wait fails. 
+ */
+
+// Default size of the data area of a ring
+#define SHM_RING_BYTES (1024 * 1024)
+
+// An empty or full side yields the CPU this many times before it sleeps
+#define SHM_RING_YIELDS 4
+
+// A sleeping side looks at the broken flag this often
+#define SHM_RING_WAIT_NS (100 * 1000 * 1000)
+
+typedef struct
+{
+    _Alignas(64) atomic_ulong tail;          /* Bytes produced (written by the producer only) */
+    atomic_ulong items_put;                  /* Items produced */
+    atomic_uint data_seq;                    /* Futex word, bumped when an item is published */
+    atomic_int consumer_waiting;             /* The consumer sleeps on data_seq */
+    _Alignas(64) atomic_ulong head;          /* Bytes consumed (written by the consumer only) */
+    atomic_ulong items_taken;                /* Items consumed */
+    atomic_uint space_seq;                   /* Futex word, bumped when an item is released */
+    atomic_int producer_waiting;             /* The producer sleeps on space_seq */
+    _Alignas(64) atomic_int broken;          /* A peer died, every wait fails */
+    unsigned long capacity;                  /* Bytes in the data area (power of two) */
+    unsigned long max_items;                 /* Items the ring may hold */
+} shm_ring_header_t;
+
+typedef struct
+{
+    shm_ring_header_t* header;               /* Shared state, followed by the data area */
+    char* data;                              /* Data area */
+    size_t mapped;                           /* Bytes mapped (header and data) */
+    unsigned long pending;                   /* Bytes of the item handed out by shm_ring_get */
+} shm_ring_t;
+
+/** 
+ * Create a ring in a new memfd mapping 
+ * @param ring Pointer to ring structure 
+ * @param bytes Size of the data area (rounded up to a power of two) 
+ * @param max_items Maximum number of items in the ring 
+ * @return NULL on success, error message on failure 
+ */
+const char* shm_ring_create(shm_ring_t* ring, size_t bytes, int max_items);
+
+/** 
+ * Copy an item into the ring (producer), blocks while the ring is full 
+ * @param ring Pointer to ring structure 
+ * @param item String to add 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @return NULL on success, error message on failure or if the ring is broken 
+ */
+const char* shm_ring_put(shm_ring_t* ring, const char* item, const work_meta_t* meta);
+
+/** 
+ * Copy an item into the ring (producer) if it has room, without waiting 
+ * @param ring Pointer to ring structure 
+ * @param item String to add 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @return 0 if the item was added, 1 if the ring is full, -1 if the item is too large or the ring is broken 
+ */
+int shm_ring_try_put(shm_ring_t* ring, const char* item, const work_meta_t* meta);
+
+/** 
+ * Take the oldest item in place (consumer), blocks while the ring is empty 
+ * The item stays valid until shm_ring_release, which has to be called before the next get 
+ * @param ring Pointer to ring structure 
+ * @param meta Receives the item metadata (may be NULL) 
+ * @return Item inside the ring or NULL if the ring is broken 
+ */
+const char* shm_ring_get(shm_ring_t* ring, work_meta_t* meta);
+
+/** 
+ * Give the space of the item taken by shm_ring_get back to the producer 
+ * @param ring Pointer to ring structure 
+ */
+void shm_ring_release(shm_ring_t* ring);
+
+/** 
+ * Get the current number of items in the ring 
+ * @param ring Pointer to ring structure 
+ * @return Number of items put and not released yet 
+ */
+int shm_ring_count(shm_ring_t* ring);
+
+/** 
+ * Mark the ring broken and wake both sides, every put and get fails from now on 
+ * @param ring Pointer to ring structure 
+ */
+void shm_ring_break(shm_ring_t* ring);
+
+/** 
+ * Unmap the ring (in this process only) 
+ * @param ring Pointer to ring structure 
+ */
+void shm_ring_destroy(shm_ring_t* ring);
+
+#endif
@@ -0,0 +1,97 @@
+#include "tap.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int is_tap(plugin_handle_t* plugin) {
+    return plugin->observe != NULL;
+}
+
+const char* tap_fold(plugin_handle_t* plugins, int* num_plugins) {
+    int count = *num_plugins;
+    int stages = 0;
+    for (int i = 0; i < count; i++) {
+        if (!is_tap(&plugins[i])) {
+            if (!plugins[i].add_tap) {
+                return NULL;
+            }
+            stages++;
+        }
+    }
+    
+    // Nothing to fold, or nothing to fold the taps into
+    if (stages == count || stages == 0) {
+        return NULL;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        if (!is_tap(&plugins[i])) {
+            continue;
+        }
+        
+        // Outputs of the plugin in front, else the items placed into the plugin behind
+        int neighbour = i - 1;
+        while (neighbour >= 0 && is_tap(&plugins[neighbour])) {
+            neighbour--;
+        }
+        int input = neighbour < 0;
+        if (input) {
+            neighbour = i + 1;
+            while (is_tap(&plugins[neighbour])) {
+                neighbour++;
+            }
+        }
+        
+        // Only planned here - fusion may still move the taps, tap_attach hands them over
+        plugin_handle_t* target = &plugins[neighbour];
+        int* num_taps = input ? &target->num_input_taps : &target->num_output_taps;
+        if (*num_taps == PLUGIN_HOST_MAX_TAPS) {
+            return "Too many taps on one plugin";
+        }
+        
+        if (input) {
+            target->input_taps[(*num_taps)++] = plugins[i].observe;
+        } else {
+            target->output_taps[(*num_taps)++] = plugins[i].observe;
+        }
+    }
+    
+    // The taps stay loaded behind the chain, like folded plugins, but are never initialized
+    plugin_handle_t* ordered = (plugin_handle_t*)malloc(count * sizeof(plugin_handle_t));
+    if (!ordered) {
+        return "Failed to allocate memory for plugins";
+    }
+    
+    int next = 0;
+    for (int i = 0; i < count; i++) {
+        if (!is_tap(&plugins[i])) {
+            ordered[next++] = plugins[i];
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (is_tap(&plugins[i])) {
+            ordered[next++] = plugins[i];
+        }
+    }
+    
+    memcpy(plugins, ordered, count * sizeof(plugin_handle_t));
+    free(ordered);
+    *num_plugins = stages;
+    return NULL;
+}
+
+const char* tap_attach(plugin_handle_t* plugins, int num_plugins) {
+    for (int i = 0; i < num_plugins; i++) {
+        plugin_handle_t* plugin = &plugins[i];
+        for (int t = 0; t < plugin->num_input_taps; t++) {
+            if (!plugin->add_tap(plugin->input_taps[t], 1)) {
+                return "Failed to attach a tap";
+            }
+        }
+        for (int t = 0; t < plugin->num_output_taps; t++) {
+            if (!plugin->add_tap(plugin->output_taps[t], 0)) {
+                return "Failed to attach a tap";
+            }
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef TAP_H
+#define TAP_H
+
+#include "plugin_host.h"
+
+/** 
+ * Tap stages 
+ * A tap (logger) only looks at the items that pass it, so it needs neither a queue nor a 
+ * thread of its own, and no copy of the item. Taps are taken out of the chain and attached to 
+ * the nearest plugin in front of them, which shows them every output before passing it on. A 
+ * tap at the head of the chain is attached to the first plugin behind it instead, which shows 
+ * it every item placed into the chain on the placing thread. Inside a fused run the kernel is 
+ * split at the tap, so the tap still sees the line as the plugin in front of it left it. 
+ */
+
+/** 
+ * Plan every tap on its neighbour (input_taps / output_taps of the handle) and move the taps 
+ * behind the chain - call before compose_fuse, which keeps the taps of fused plugins in place. 
+ * A chain of nothing but taps is left as it is 
+ * @param plugins Loaded plugins, in chain order 
+ * @param num_plugins Number of plugins, updated to the number of plugins left in the chain 
+ * @return NULL on success, error message on failure 
+ */
+const char* tap_fold(plugin_handle_t* plugins, int* num_plugins);
+
+/** 
+ * Attach the planned taps to their plugins - must be called before the plugins are initialized 
+ * @param plugins Plugins of the chain 
+ * @param num_plugins Number of plugins in the chain 
+ * @return NULL on success, error message on failure 
+ */
+const char* tap_attach(plugin_handle_t* plugins, int num_plugins);
+
+#endif
@@ -0,0 +1,286 @@
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+#define THREAD_POOL_INITIAL_DEQUE_CAPACITY 64
+
+typedef struct
+{
+    thread_pool_t* pool;
+    int index;
+} thread_pool_worker_arg_t;
+
+// Identity of the calling worker, used to route submissions to its own deque
+static __thread thread_pool_t* current_pool = NULL;
+static __thread int current_index = -1;
+
+static int deque_init(thread_pool_deque_t* deque) {
+    deque->tasks = (thread_pool_task_t*)malloc(THREAD_POOL_INITIAL_DEQUE_CAPACITY * sizeof(thread_pool_task_t));
+    if (!deque->tasks) {
+        return -1;
+    }
+    
+    if (pthread_mutex_init(&deque->mutex, NULL) != 0) {
+        free(deque->tasks);
+        return -1;
+    }
+    
+    deque->capacity = THREAD_POOL_INITIAL_DEQUE_CAPACITY;
+    deque->head = 0;
+    deque->count = 0;
+    return 0;
+}
+
+static void deque_destroy(thread_pool_deque_t* deque) {
+    free(deque->tasks);
+    pthread_mutex_destroy(&deque->mutex);
+}
+
+// Move the tasks into a buffer of new_capacity slots - caller holds deque->mutex
+static int deque_grow_locked(thread_pool_deque_t* deque, int new_capacity) {
+    thread_pool_task_t* tasks = (thread_pool_task_t*)malloc(new_capacity * sizeof(thread_pool_task_t));
+    if (!tasks) {
+        return -1;
+    }
+    
+    for (int i = 0; i < deque->count; i++) {
+        tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+    }
+    
+    free(deque->tasks);
+    deque->tasks = tasks;
+    deque->capacity = new_capacity;
+    deque->head = 0;
+    return 0;
+}
+
+static int deque_push_tail(thread_pool_deque_t* deque, thread_pool_task_t task) {
+    pthread_mutex_lock(&deque->mutex);
+    
+    if (deque->count == deque->capacity && deque_grow_locked(deque, deque->capacity * 2) != 0) {
+        pthread_mutex_unlock(&deque->mutex);
+        return -1;
+    }
+    
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_mutex_unlock(&deque->mutex);
+    return 0;
+}
+
+static int deque_pop_tail(thread_pool_deque_t* deque, thread_pool_task_t* task) {
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count == 0) {
+        pthread_mutex_unlock(&deque->mutex);
+        return -1;
+    }
+    
+    deque->count--;
+    *task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+    pthread_mutex_unlock(&deque->mutex);
+    return 0;
+}
+
+static int deque_pop_head(thread_pool_deque_t* deque, thread_pool_task_t* task) {
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count == 0) {
+        pthread_mutex_unlock(&deque->mutex);
+        return -1;
+    }
+    
+    *task = deque->tasks[deque->head];
+    deque->head = (deque->head + 1) % deque->capacity;
+    deque->count--;
+    pthread_mutex_unlock(&deque->mutex);
+    return 0;
+}
+
+// Own deque first, then the injection deque, then steal from the other workers
+static int find_task(thread_pool_t* pool, int index, thread_pool_task_t* task) {
+    if (deque_pop_tail(&pool->deques[index], task) == 0) {
+        return 0;
+    }
+    
+    if (deque_pop_head(&pool->deques[pool->num_workers], task) == 0) {
+        return 0;
+    }
+    
+    for (int offset = 1; offset < pool->num_workers; offset++) {
+        int victim = (index + offset) % pool->num_workers;
+        if (deque_pop_head(&pool->deques[victim], task) == 0) {
+            return 0;
+        }
+    }
+    
+    return -1;
+}
+
+static void* thread_pool_worker(void* arg) {
+    thread_pool_worker_arg_t* worker = (thread_pool_worker_arg_t*)arg;
+    thread_pool_t* pool = worker->pool;
+    int index = worker->index;
+    free(worker);
+    
+    current_pool = pool;
+    current_index = index;
+    
+    while (1) {
+        pthread_mutex_lock(&pool->idle_mutex);
+        while (pool->pending == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->idle_condition, &pool->idle_mutex);
+        }
+        
+        if (pool->pending == 0 && pool->stopping) {
+            pthread_mutex_unlock(&pool->idle_mutex);
+            break;
+        }
+        pthread_mutex_unlock(&pool->idle_mutex);
+        
+        thread_pool_task_t task;
+        if (find_task(pool, index, &task) != 0) {
+            // Another worker took it between the wake-up and the search
+            continue;
+        }
+        
+        pthread_mutex_lock(&pool->idle_mutex);
+        pool->pending--;
+        pthread_mutex_unlock(&pool->idle_mutex);
+        
+        task.func(task.arg);
+    }
+    
+    return NULL;
+}
+
+static const char* submit_to(thread_pool_t* pool, int index, thread_pool_task_func_t func, void* arg) {
+    if (!pool || !func) {
+        return "Invalid task";
+    }
+    
+    thread_pool_task_t task = { func, arg };
+    
+    // Count the task before it becomes visible so pending never goes negative
+    pthread_mutex_lock(&pool->idle_mutex);
+    pool->pending++;
+    pthread_mutex_unlock(&pool->idle_mutex);
+    
+    if (deque_push_tail(&pool->deques[index], task) != 0) {
+        pthread_mutex_lock(&pool->idle_mutex);
+        pool->pending--;
+        pthread_mutex_unlock(&pool->idle_mutex);
+        return "Failed to allocate memory for task";
+    }
+    
+    pthread_mutex_lock(&pool->idle_mutex);
+    pthread_cond_signal(&pool->idle_condition);
+    pthread_mutex_unlock(&pool->idle_mutex);
+    return NULL;
+}
+
+int thread_pool_default_size(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+const char* thread_pool_init(thread_pool_t* pool, int num_workers) {
+    if (!pool) {
+        return "Pool pointer cannot be null";
+    }
+    if (num_workers <= 0) {
+        return "Pool size must be positive";
+    }
+    
+    pool->num_workers = num_workers;
+    pool->pending = 0;
+    pool->stopping = 0;
+    pool->started = 0;
+    
+    pool->deques = (thread_pool_deque_t*)malloc((num_workers + 1) * sizeof(thread_pool_deque_t));
+    pool->workers = (pthread_t*)malloc(num_workers * sizeof(pthread_t));
+    if (!pool->deques || !pool->workers) {
+        free(pool->deques);
+        free(pool->workers);
+        return "Failed to allocate memory for pool";
+    }
+    
+    for (int i = 0; i <= num_workers; i++) {
+        if (deque_init(&pool->deques[i]) != 0) {
+            for (int j = 0; j < i; j++) {
+                deque_destroy(&pool->deques[j]);
+            }
+            free(pool->deques);
+            free(pool->workers);
+            return "Failed to initialize pool deque";
+        }
+    }
+    
+    pthread_mutex_init(&pool->idle_mutex, NULL);
+    pthread_cond_init(&pool->idle_condition, NULL);
+    
+    for (int i = 0; i < num_workers; i++) {
+        thread_pool_worker_arg_t* worker = (thread_pool_worker_arg_t*)malloc(sizeof(thread_pool_worker_arg_t));
+        if (!worker) {
+            thread_pool_destroy(pool);
+            return "Failed to allocate memory for worker";
+        }
+        
+        worker->pool = pool;
+        worker->index = i;
+        if (pthread_create(&pool->workers[i], NULL, thread_pool_worker, worker) != 0) {
+            free(worker);
+            thread_pool_destroy(pool);
+            return "Failed to create worker thread";
+        }
+        pool->started++;
+    }
+    
+    return NULL;
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    
+    pthread_mutex_lock(&pool->idle_mutex);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->idle_condition);
+    pthread_mutex_unlock(&pool->idle_mutex);
+    
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    
+    for (int i = 0; i <= pool->num_workers; i++) {
+        deque_destroy(&pool->deques[i]);
+    }
+    
+    pthread_cond_destroy(&pool->idle_condition);
+    pthread_mutex_destroy(&pool->idle_mutex);
+    free(pool->deques);
+    free(pool->workers);
+    pool->deques = NULL;
+    pool->workers = NULL;
+}
+
+const char* thread_pool_reserve(thread_pool_t* pool, int tasks) {
+    if (!pool || tasks < 0) {
+        return "Invalid parameters entered to thread_pool_reserve";
+    }
+    
+    for (int i = 0; i <= pool->num_workers; i++) {
+        thread_pool_deque_t* deque = &pool->deques[i];
+        pthread_mutex_lock(&deque->mutex);
+        int failed = deque->capacity < tasks && deque_grow_locked(deque, tasks) != 0;
+        pthread_mutex_unlock(&deque->mutex);
+        if (failed) {
+            return "Failed to allocate memory for tasks";
+        }
+    }
+    return NULL;
+}
+
+const char* thread_pool_submit(thread_pool_t* pool, thread_pool_task_func_t func, void* arg) {
+    int index = (current_pool == pool) ? current_index : pool->num_workers;
+    return submit_to(pool, index, func, arg);
+}
@@ -0,0 +1,80 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+/** 
+ * Fixed-size work-stealing thread pool 
+ * Every worker owns a deque: it pushes and pops its own tasks at the tail (LIFO, cache-warm) 
+ * while idle workers steal from the head of other deques (FIFO, oldest first). 
+ * Tasks submitted from outside the pool go to a shared injection deque. 
+ */
+
+typedef void (*thread_pool_task_func_t)(void* arg);
+
+typedef struct
+{
+    thread_pool_task_func_t func;    /* Task function */
+    void* arg;                       /* Task argument */
+} thread_pool_task_t;
+
+typedef struct
+{
+    thread_pool_task_t* tasks;       /* Circular task buffer (grows on demand) */
+    int capacity;                    /* Allocated slots */
+    int head;                        /* Index of oldest task (steal end) */
+    int count;                       /* Number of queued tasks */
+    pthread_mutex_t mutex;           /* Protects the deque */
+} thread_pool_deque_t;
+
+typedef struct thread_pool
+{
+    int num_workers;                 /* Number of worker threads */
+    pthread_t* workers;              /* Worker threads */
+    thread_pool_deque_t* deques;     /* num_workers worker deques + 1 injection deque */
+    pthread_mutex_t idle_mutex;      /* Protects pending and stopping */
+    pthread_cond_t idle_condition;   /* Signaled when work arrives or the pool stops */
+    int pending;                     /* Number of queued (not yet started) tasks */
+    int stopping;                    /* Set by thread_pool_destroy */
+    int started;                     /* Number of workers successfully started */
+} thread_pool_t;
+
+/** 
+ * Get the number of online CPUs (at least 1) 
+ * @return Default pool size 
+ */ 
+int thread_pool_default_size(void);
+
+/** 
+ * Create the pool and start its workers 
+ * @param pool Pointer to pool structure 
+ * @param num_workers Number of worker threads (must be positive) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* thread_pool_init(thread_pool_t* pool, int num_workers);
+
+/** 
+ * Stop the workers (after all queued tasks ran) and free the pool resources 
+ * @param pool Pointer to pool structure 
+ */ 
+void thread_pool_destroy(thread_pool_t* pool);
+
+/** 
+ * Make room for a number of queued tasks in every deque, so that as long as no more tasks 
+ * than that are queued at once, thread_pool_submit cannot fail 
+ * @param pool Pointer to pool structure 
+ * @param tasks Number of tasks 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* thread_pool_reserve(thread_pool_t* pool, int tasks);
+
+/** 
+ * Queue a task - onto the calling worker's own deque, or the injection deque otherwise 
+ * @param pool Pointer to pool structure 
+ * @param func Task function 
+ * @param arg Task argument 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* thread_pool_submit(thread_pool_t* pool, thread_pool_task_func_t func, void* arg);
+
+#endif
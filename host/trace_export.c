@@ -0,0 +1,76 @@
+#include "trace_export.h"
+#include <stdio.h>
+#include <unistd.h>
+
+static const char* kind_names[] = {"wait", "process", "forward"};
+
+// Stage names are plugin names, which need no JSON escaping
+static const char* stage_name(const trace_t* trace, int stage) {
+    return (stage >= 0 && stage < trace->num_stages) ? trace->stages[stage] : "unknown";
+}
+
+// A thread that runs several plugins owns one buffer per plugin, but is named only once
+static int named_before(const trace_t* trace, int index) {
+    for (int i = 0; i < index; i++) {
+        if (trace->buffers[i].events && trace->buffers[i].tid == trace->buffers[index].tid) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* trace_export(const trace_t* trace, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return "Failed to open trace file";
+    }
+    
+    int pid = (int)getpid();
+    int claimed = atomic_load(&trace->num_buffers);
+    int num_buffers = claimed < TRACE_MAX_BUFFERS ? claimed : TRACE_MAX_BUFFERS;
+    unsigned long events = 0;
+    unsigned long overwritten = 0;
+    
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"pipeline\"}}", pid);
+    
+    for (int i = 0; i < num_buffers; i++) {
+        const trace_buffer_t* buffer = &trace->buffers[i];
+        if (!buffer->events) {
+            continue;
+        }
+        
+        // Plugin threads are named after their stage, threads shared by several stages after their id
+        if (buffer->stage >= 0) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    pid, buffer->tid, stage_name(trace, buffer->stage));
+        } else if (!named_before(trace, i)) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                    pid, buffer->tid, buffer->tid);
+        }
+        
+        // Oldest kept event first
+        unsigned long kept = buffer->written < TRACE_BUFFER_EVENTS ? buffer->written : TRACE_BUFFER_EVENTS;
+        unsigned long first = buffer->written - kept;
+        for (unsigned long j = first; j < buffer->written; j++) {
+            const trace_event_t* event = &buffer->events[j % TRACE_BUFFER_EVENTS];
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":%d,\"tid\":%d,\"args\":{\"stream\":%d}}",
+                    kind_names[event->kind], stage_name(trace, event->stage),
+                    (event->start_ns - trace->origin_ns) / 1000.0, event->duration_ns / 1000.0,
+                    pid, buffer->tid, event->stream);
+        }
+        
+        events += kept;
+        overwritten += first;
+    }
+    
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        return "Failed to write trace file";
+    }
+    
+    fprintf(stderr, "[STATS][trace] - %lu events from %d buffers written to %s, %lu overwritten, %d buffers dropped\n",
+            events, num_buffers, path, overwritten, claimed - num_buffers);
+    return NULL;
+}
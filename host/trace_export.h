@@ -0,0 +1,20 @@
+#ifndef TRACE_EXPORT_H
+#define TRACE_EXPORT_H
+
+#include "../plugins/sync/trace.h"
+
+/** 
+ * Chrome trace-event export of a recorded timeline 
+ * Every event becomes a complete ("X") event on the thread that recorded it, with the stage 
+ * as category, so the file opens in chrome://tracing and in Perfetto. 
+ */
+
+/** 
+ * Write the trace as Chrome trace-event JSON - only once every recording thread was joined 
+ * @param trace Pointer to trace structure 
+ * @param path Output file 
+ * @return NULL on success, error message on failure 
+ */
+const char* trace_export(const trace_t* trace, const char* path);
+
+#endif
@@ -3,36 +3,111 @@
 #include <string.h>
 #include <dlfcn.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
-typedef const char* (*plugin_init_func_t)(int);
-typedef const char* (*plugin_fini_func_t)(void);
-typedef const char* (*plugin_place_work_func_t)(const char*);
-typedef void (*plugin_attach_func_t)(const char* (*)(const char*));
-typedef const char* (*plugin_wait_finished_func_t)(void);
-typedef const char* (*plugin_get_name_func_t)(void);
+#include "host/plugin_host.h"
+#include "host/executor.h"
+#include "host/ingest.h"
+#include "host/server.h"
+#include "host/compose.h"
+#include "host/priority.h"
+#include "host/trace_export.h"
+#include "host/multiprocess.h"
+#include "host/capture.h"
+#include "host/autoscale.h"
+#include "host/overload.h"
+#include "host/tap.h"
 
+// Command line options given before <queue_size>
 typedef struct {
-    plugin_init_func_t init;
-    plugin_fini_func_t fini;
-    plugin_place_work_func_t place_work;
-    plugin_attach_func_t attach;
-    plugin_wait_finished_func_t wait_finished;
-    char* name;
-    void* handle;
-} plugin_handle_t;
+    int pool_workers;    // Run the plugins on a work-stealing pool of this size (0 = one thread per plugin)
+    int inline_mode;     // Run the whole chain depth-first on the reading thread
+    int processes;       // Run the chain as stage processes connected by shared-memory rings
+    const char* process_groups; // Plugins per stage process, e.g. "2,1" (NULL = one each)
+    int fuse;            // Collapse runs of pure plugins into one kernel
+    int utf8;            // Text plugins transform UTF-8 characters instead of bytes
+    int autoscale;       // Scale the consumer threads of stateless plugins with their load
+    int thread_budget;   // Most plugin threads when autoscaling (0 = plugins plus CPU count)
+    int perf;            // Count hardware events of every plugin thread
+    const char* trace_path; // Write a Chrome trace-event timeline here (NULL = off)
+    unsigned int trace_sample; // Trace one item in every trace_sample items
+    size_t memo_limit;   // Result cache in front of every run of pure plugins, in bytes (0 = off)
+    size_t queue_bytes;  // Bytes each queue may hold in memory before spilling (0 = unlimited)
+    size_t pipeline_bytes; // Bytes all queues together may hold in memory before spilling (0 = unlimited)
+    const char* spill_dir; // Directory for spill segment files (NULL = $TMPDIR or /tmp)
+    char** inputs;       // Input sources read instead of stdin (one stream each)
+    int num_inputs;      // Number of input sources
+    const char* output_dir; // Directory for per-stream results (NULL = tagged stdout)
+    const char* listen_path; // Serve clients on this Unix domain socket
+    int listen_port;     // Serve clients on this loopback TCP port (0 = off)
+    priority_t priority; // Priority classes of incoming lines and how the queues serve them
+    overload_t overload; // What the producers of a full queue do, per plugin
+    const char* filter_path; // Pattern file handed to the filter plugin (NULL = none)
+    int filter_drop;     // Drop lines that contain a pattern instead of keeping only those
+    const char* capture_path; // Record every incoming line with its arrival time here (NULL = off)
+    const char* replay_path; // Feed this capture into the chain instead of reading input (NULL = off)
+    double replay_speed; // Replay speed factor (0 = as fast as possible)
+} pipeline_options_t;
+
+// Everything main() sets up, released together by release_host
+typedef struct {
+    pipeline_options_t* options;
+    plugin_handle_t* plugins;
+    int num_plugins;
+    executor_t executor;
+    ingest_t ingest;
+    server_t* server;
+    composer_t composer;
+    multiprocess_t processes;
+    autoscaler_t autoscaler;
+    byte_budget_t budget;
+    trace_t trace;
+    capture_t capture;
+    replay_t replay;
+    const char* trace_output; // Set once the run completed, the trace is written on release
+} pipeline_host_t;
 
 void print_usage(char* program_name) {
-    printf("Usage: %s <queue_size> <plugin1> <plugin2> ... <pluginN>\n", program_name);
+    printf("Usage: %s [options] <queue_size> <plugin1> <plugin2> ... <pluginN>\n", program_name);
     printf("Arguments:\n");
     printf("  queue_size    Maximum number of items in each plugin's queue\n");
     printf("  plugin1..N    Names of plugins to load (without .so extension)\n");
+    printf("Options:\n");
+    printf("  --pool[=N]    Run plugins as tasks on a work-stealing pool of N threads (default: CPU count)\n");
+    printf("  --inline      Run all plugins on the reading thread, without queues or threads\n");
+    printf("  --processes[=N,M,..]  Run every plugin (or every group of N, M, .. plugins) in a process of its own\n");
+    printf("  --autoscale[=N]  Add and retire threads of stateless plugins by queue load, N threads in total\n");
+    printf("  --utf8        Let uppercaser, rotator and flipper work on UTF-8 characters instead of bytes\n");
+    printf("  --fuse        Fuse runs of pure transforms (uppercaser, rotator, flipper, expander) into one pass\n");
+    printf("  --perf        Report IPC, cache/branch misses and context switches per plugin (perf_event_open)\n");
+    printf("  --trace PATH  Write a Chrome/Perfetto trace-event timeline of every plugin to PATH\n");
+    printf("  --trace-sample N  Trace one item in every N (default 1, long waits are always traced)\n");
+    printf("  --memo[=SIZE] Cache the results of pure plugin runs for repeated lines (SIZE bytes, K/M/G suffix, default 64M)\n");
+    printf("  --queue-bytes SIZE     Spill a queue's items to disk beyond SIZE bytes in memory (K/M/G suffix)\n");
+    printf("  --pipeline-bytes SIZE  Spill to disk once all queues together hold SIZE bytes (K/M/G suffix)\n");
+    printf("  --spill-dir DIR        Directory for spill files (default: $TMPDIR or /tmp)\n");
+    printf("  --input PATH  Read PATH (file or FIFO) as a separate stream instead of stdin, repeatable\n");
+    printf("  --output-dir DIR  Write each input stream's results to DIR/<id>-<name>.out\n");
+    printf("  --listen PATH Serve clients on a Unix domain socket until SIGINT/SIGTERM\n");
+    printf("  --listen-tcp PORT  Serve clients on 127.0.0.1:PORT until SIGINT/SIGTERM\n");
+    printf("  --priority PREFIX=CLASS  Lines starting with PREFIX get CLASS (high, normal or low), repeatable\n");
+    printf("  --source-priority NAME=CLASS  Lines read from the --input named NAME get CLASS, repeatable\n");
+    printf("  --lanes strict|H,N,L  Serve the classes by strict priority (default) or weighted round-robin\n");
+    printf("  --overload [NAME=]POLICY  When a queue (of plugin NAME) is full: block, block:MS, drop-newest,\n");
+    printf("                drop-oldest or sample:N (keep 1 in N), repeatable\n");
+    printf("  --filter-keep PATH  Let the filter plugin keep only lines that contain a pattern listed in PATH\n");
+    printf("  --filter-drop PATH  Let the filter plugin drop lines that contain a pattern listed in PATH\n");
+    printf("  --capture PATH  Record every incoming line and its arrival time into the capture file PATH\n");
+    printf("  --replay PATH Feed the capture file PATH into the chain instead of reading input\n");
+    printf("  --replay-speed max|N  Replay N times faster than captured (default 1) or without any gaps\n");
     printf("Available plugins:\n");
-    printf("  logger        - Logs all strings that pass through\n");
+    printf("  logger        - Logs all strings that pass through (a tap, runs on the thread of its neighbour)\n");
     printf("  typewriter    - Simulates typewriter effect with delays\n");
     printf("  uppercaser    - Converts strings to uppercase\n");
     printf("  rotator       - Move every character to the right. Last character moves to the beginning.\n");
     printf("  flipper       - Reverses the order of characters\n");
     printf("  expander      - Expands each character with spaces\n");
+    printf("  filter        - Keeps or drops lines by literal patterns (put it first in the chain)\n");
     printf("Example:\n");
     printf("  %s 20 uppercaser rotator logger\n", program_name);
 }
@@ -112,10 +187,332 @@ int load_plugin(const char* plugin_name, plugin_handle_t* plugin, char* program_
         return 1;
     }
     
+    // Optional entry points - only needed by the pooled executor
+    plugin->set_ready_callback = (plugin_set_ready_callback_func_t)dlsym(plugin->handle, "plugin_set_ready_callback");
+    plugin->run_slice = (plugin_run_slice_func_t)dlsym(plugin->handle, "plugin_run_slice");
+    plugin->try_place_work = (plugin_try_place_work_func_t)dlsym(plugin->handle, "plugin_try_place_work");
+    plugin->attach_try = (plugin_attach_try_func_t)dlsym(plugin->handle, "plugin_attach_try");
+    plugin->set_room_callback = (plugin_set_room_callback_func_t)dlsym(plugin->handle, "plugin_set_room_callback");
+    plugin->pending = (plugin_pending_func_t)dlsym(plugin->handle, "plugin_pending");
+    plugin->set_inline = (plugin_set_inline_func_t)dlsym(plugin->handle, "plugin_set_inline");
+    plugin->place_work_meta = (plugin_place_work_meta_func_t)dlsym(plugin->handle, "plugin_place_work_meta");
+    plugin->attach_meta = (plugin_attach_meta_func_t)dlsym(plugin->handle, "plugin_attach_meta");
+    plugin->set_byte_budget = (plugin_set_byte_budget_func_t)dlsym(plugin->handle, "plugin_set_byte_budget");
+    plugin->set_lane_weights = (plugin_set_lane_weights_func_t)dlsym(plugin->handle, "plugin_set_lane_weights");
+    plugin->set_perf_counters = (plugin_set_perf_counters_func_t)dlsym(plugin->handle, "plugin_set_perf_counters");
+    plugin->set_trace = (plugin_set_trace_func_t)dlsym(plugin->handle, "plugin_set_trace");
+    plugin->get_descriptor = (plugin_get_descriptor_func_t)dlsym(plugin->handle, "plugin_get_descriptor");
+    plugin->set_process_override = (plugin_set_process_override_func_t)dlsym(plugin->handle, "plugin_set_process_override");
+    plugin->set_patterns = (plugin_set_patterns_func_t)dlsym(plugin->handle, "plugin_set_patterns");
+    plugin->set_max_workers = (plugin_set_max_workers_func_t)dlsym(plugin->handle, "plugin_set_max_workers");
+    plugin->scale_workers = (plugin_scale_workers_func_t)dlsym(plugin->handle, "plugin_scale_workers");
+    plugin->blocked_ns = (plugin_blocked_ns_func_t)dlsym(plugin->handle, "plugin_blocked_ns");
+    plugin->set_utf8 = (plugin_set_utf8_func_t)dlsym(plugin->handle, "plugin_set_utf8");
+    plugin->set_overload = (plugin_set_overload_func_t)dlsym(plugin->handle, "plugin_set_overload");
+    plugin->dropped = (plugin_dropped_func_t)dlsym(plugin->handle, "plugin_dropped");
+    plugin->observe = (plugin_observe_func_t)dlsym(plugin->handle, "plugin_observe");
+    plugin->add_tap = (plugin_add_tap_func_t)dlsym(plugin->handle, "plugin_add_tap");
+    
     plugin->name = strdup(plugin_name);
     return 0;
 }
 
+// Parse a byte count with an optional K, M or G suffix, returns 0 if invalid
+size_t parse_size(const char* value) {
+    size_t digits = strspn(value, "0123456789");
+    if (digits == 0 || digits > 12) {
+        return 0;
+    }
+    
+    size_t size = strtoull(value, NULL, 10);
+    const char* suffix = value + digits;
+    if (strcmp(suffix, "K") == 0) {
+        size *= 1024;
+    } else if (strcmp(suffix, "M") == 0) {
+        size *= 1024 * 1024;
+    } else if (strcmp(suffix, "G") == 0) {
+        size *= 1024 * 1024 * 1024;
+    } else if (*suffix != '\0') {
+        return 0;
+    }
+    
+    return size;
+}
+
+// Parse the leading --options, returns the index of the first positional argument or -1 on error
+int parse_options(int argc, char* argv[], pipeline_options_t* options) {
+    memset(options, 0, sizeof(*options));
+    options->replay_speed = 1;
+    options->inputs = (char**)malloc(argc * sizeof(char*));
+    if (!options->inputs) {
+        fprintf(stderr, "Error: Failed to allocate memory for options\n");
+        return -1;
+    }
+    
+    int arg_index = 1;
+    while (arg_index < argc && strncmp(argv[arg_index], "--", 2) == 0) {
+        const char* option = argv[arg_index];
+        
+        if (strcmp(option, "--pool") == 0) {
+            options->pool_workers = thread_pool_default_size();
+
+        } else if (strncmp(option, "--pool=", 7) == 0) {
+            const char* value = option + 7;
+            if (*value == '\0' || strspn(value, "0123456789") != strlen(value) || atoi(value) <= 0) {
+                fprintf(stderr, "Error: Invalid pool size\n");
+                free(options->inputs);
+                return -1;
+            }
+            options->pool_workers = atoi(value);
+
+        } else if (strcmp(option, "--inline") == 0) {
+            options->inline_mode = 1;
+        
+        } else if (strcmp(option, "--processes") == 0) {
+            options->processes = 1;
+        
+        } else if (strncmp(option, "--processes=", 12) == 0) {
+            options->processes = 1;
+            options->process_groups = option + 12;
+        
+        } else if (strcmp(option, "--autoscale") == 0) {
+            options->autoscale = 1;
+        
+        } else if (strncmp(option, "--autoscale=", 12) == 0) {
+            const char* value = option + 12;
+            if (*value == '\0' || strspn(value, "0123456789") != strlen(value) || atoi(value) <= 0) {
+                fprintf(stderr, "Error: Invalid thread budget\n");
+                free(options->inputs);
+                return -1;
+            }
+            options->autoscale = 1;
+            options->thread_budget = atoi(value);
+        
+        } else if (strcmp(option, "--utf8") == 0) {
+            options->utf8 = 1;
+        
+        } else if (strcmp(option, "--fuse") == 0) {
+            options->fuse = 1;
+        
+        } else if (strcmp(option, "--perf") == 0) {
+            options->perf = 1;
+        
+        } else if (strcmp(option, "--memo") == 0) {
+            options->memo_limit = MEMO_DEFAULT_LIMIT;
+
+        } else if (strncmp(option, "--memo=", 7) == 0) {
+            options->memo_limit = parse_size(option + 7);
+            if (options->memo_limit == 0) {
+                fprintf(stderr, "Error: Invalid memo size\n");
+                free(options->inputs);
+                return -1;
+            }
+
+        } else if (strcmp(option, "--input") == 0 || strcmp(option, "--output-dir") == 0 ||
+                   strcmp(option, "--listen") == 0 || strcmp(option, "--listen-tcp") == 0 ||
+                   strcmp(option, "--queue-bytes") == 0 || strcmp(option, "--pipeline-bytes") == 0 ||
+                   strcmp(option, "--spill-dir") == 0 || strcmp(option, "--priority") == 0 ||
+                   strcmp(option, "--source-priority") == 0 || strcmp(option, "--lanes") == 0 ||
+                   strcmp(option, "--trace") == 0 || strcmp(option, "--trace-sample") == 0 ||
+                   strcmp(option, "--filter-keep") == 0 || strcmp(option, "--filter-drop") == 0 ||
+                   strcmp(option, "--capture") == 0 || strcmp(option, "--replay") == 0 ||
+                   strcmp(option, "--replay-speed") == 0 || strcmp(option, "--overload") == 0) {
+            if (arg_index + 1 >= argc) {
+                fprintf(stderr, "Error: Missing value for %s\n", option);
+                free(options->inputs);
+                return -1;
+            }
+            
+            arg_index++;
+            const char* value = argv[arg_index];
+            if (strcmp(option, "--input") == 0) {
+                options->inputs[options->num_inputs++] = (char*)value;
+            } else if (strcmp(option, "--output-dir") == 0) {
+                options->output_dir = value;
+            } else if (strcmp(option, "--listen") == 0) {
+                options->listen_path = value;
+            } else if (strcmp(option, "--spill-dir") == 0) {
+                options->spill_dir = value;
+            } else if (strcmp(option, "--trace") == 0) {
+                options->trace_path = value;
+            } else if (strcmp(option, "--capture") == 0) {
+                options->capture_path = value;
+            } else if (strcmp(option, "--replay") == 0) {
+                options->replay_path = value;
+            } else if (strcmp(option, "--replay-speed") == 0) {
+                char* end = NULL;
+                double speed = strcmp(value, "max") == 0 ? 0 : strtod(value, &end);
+                if (end && (*end == 'x' || *end == 'X')) {
+                    end++;
+                }
+                if (end && (end == value || *end != '\0' || !(speed > 0))) {
+                    fprintf(stderr, "Error: Invalid replay speed\n");
+                    free(options->inputs);
+                    return -1;
+                }
+                options->replay_speed = speed;
+            } else if (strcmp(option, "--filter-keep") == 0 || strcmp(option, "--filter-drop") == 0) {
+                if (options->filter_path) {
+                    fprintf(stderr, "Error: Only one of --filter-keep and --filter-drop can be given\n");
+                    free(options->inputs);
+                    return -1;
+                }
+                options->filter_path = value;
+                options->filter_drop = strcmp(option, "--filter-drop") == 0;
+            } else if (strcmp(option, "--trace-sample") == 0) {
+                if (strspn(value, "0123456789") != strlen(value) || atoi(value) <= 0) {
+                    fprintf(stderr, "Error: Invalid trace sample\n");
+                    free(options->inputs);
+                    return -1;
+                }
+                options->trace_sample = atoi(value);
+            } else if (strcmp(option, "--overload") == 0) {
+                const char* error = overload_add_rule(&options->overload, value);
+                if (error) {
+                    fprintf(stderr, "Error: Invalid --overload: %s\n", error);
+                    free(options->inputs);
+                    return -1;
+                }
+            } else if (strcmp(option, "--priority") == 0 || strcmp(option, "--source-priority") == 0 ||
+                       strcmp(option, "--lanes") == 0) {
+                const char* error;
+                if (strcmp(option, "--priority") == 0) {
+                    error = priority_add_rule(&options->priority, value);
+                } else if (strcmp(option, "--source-priority") == 0) {
+                    error = priority_add_source(&options->priority, value);
+                } else {
+                    error = priority_set_lanes(&options->priority, value);
+                }
+                if (error) {
+                    fprintf(stderr, "Error: Invalid %s: %s\n", option, error);
+                    free(options->inputs);
+                    return -1;
+                }
+            } else if (strcmp(option, "--queue-bytes") == 0 || strcmp(option, "--pipeline-bytes") == 0) {
+                size_t size = parse_size(value);
+                if (size == 0) {
+                    fprintf(stderr, "Error: Invalid byte budget\n");
+                    free(options->inputs);
+                    return -1;
+                }
+                if (strcmp(option, "--queue-bytes") == 0) {
+                    options->queue_bytes = size;
+                } else {
+                    options->pipeline_bytes = size;
+                }
+            } else {
+                if (strspn(value, "0123456789") != strlen(value) || atoi(value) <= 0 || atoi(value) > 65535) {
+                    fprintf(stderr, "Error: Invalid port\n");
+                    free(options->inputs);
+                    return -1;
+                }
+                options->listen_port = atoi(value);
+            }
+
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", option);
+            free(options->inputs);
+            return -1;
+        }
+        
+        arg_index++;
+    }
+    
+    if (options->pool_workers > 0 && options->inline_mode) {
+        fprintf(stderr, "Error: --pool and --inline cannot be combined\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    if (options->trace_sample == 0) {
+        options->trace_sample = 1;
+    }
+    
+    // Counters are opened per plugin thread, which only the threaded mode has
+    if (options->perf && (options->pool_workers > 0 || options->inline_mode)) {
+        fprintf(stderr, "Error: --perf cannot be combined with --pool or --inline\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // Inline plugins have no queues to put a budget on
+    if (options->inline_mode && (options->queue_bytes > 0 || options->pipeline_bytes > 0)) {
+        fprintf(stderr, "Error: --inline cannot be combined with byte budgets\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // Inline plugins have no lanes to choose from
+    if (options->inline_mode && options->priority.weights[0] > 0) {
+        fprintf(stderr, "Error: --inline cannot be combined with weighted lanes\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // The spill store is one FIFO behind all lanes, read only once every lane is empty, so an
+    // urgent line would wait behind the whole spilled backlog
+    if (options->priority.enabled && (options->queue_bytes > 0 || options->pipeline_bytes > 0)) {
+        fprintf(stderr, "Error: --priority, --source-priority and --lanes cannot be combined with byte budgets\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // Inline plugins have no queue to fill up, and a spilling queue is never full
+    if (options->overload.num_rules > 0 && (options->inline_mode || options->processes ||
+                                            options->queue_bytes > 0 || options->pipeline_bytes > 0)) {
+        fprintf(stderr, "Error: --overload cannot be combined with --inline, --processes or byte budgets\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // Pool workers and the socket server never wait on a full queue, they retry later, so a
+    // block:MS timeout would never run out
+    if (overload_has_timeout(&options->overload) && (options->pool_workers > 0 || options->listen_path ||
+                                                     options->listen_port > 0)) {
+        fprintf(stderr, "Error: --overload block:MS cannot be combined with --pool or --listen\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // Stage processes run their plugins inline, so nothing that needs plugin threads or queues
+    // applies, and the counters of the children would never reach the host
+    if (options->processes && (options->pool_workers > 0 || options->inline_mode || options->perf ||
+                               options->trace_path || options->memo_limit > 0 || options->queue_bytes > 0 ||
+                               options->pipeline_bytes > 0 || options->priority.weights[0] > 0)) {
+        fprintf(stderr, "Error: --processes cannot be combined with --pool, --inline, --perf, --trace, --memo, byte budgets or weighted lanes\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // Only plugin threads of their own can be added, and fused or traced stages keep per-thread state
+    if (options->autoscale && (options->pool_workers > 0 || options->inline_mode || options->processes ||
+                               options->fuse || options->memo_limit > 0 || options->perf || options->trace_path)) {
+        fprintf(stderr, "Error: --autoscale cannot be combined with --pool, --inline, --processes, --fuse, --memo, --perf or --trace\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    if (options->num_inputs > 0 && (options->listen_path || options->listen_port > 0)) {
+        fprintf(stderr, "Error: --input and --listen cannot be combined\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // A replay is the only source of lines
+    if (options->replay_path && (options->num_inputs > 0 || options->listen_path || options->listen_port > 0)) {
+        fprintf(stderr, "Error: --replay cannot be combined with --input or --listen\n");
+        free(options->inputs);
+        return -1;
+    }
+    
+    // Replayed lines are stamped on placement, so their latency per class is always reported
+    if (options->replay_path) {
+        options->priority.enabled = 1;
+    }
+    
+    return arg_index;
+}
+
 void cleanup_plugins(plugin_handle_t* plugins, int count) {
     for (int i = 0; i < count; i++) {
         if (plugins[i].fini) {
@@ -132,12 +529,66 @@ void cleanup_plugins(plugin_handle_t* plugins, int count) {
     }
 }
 
+// Stop the executor, unload the plugins and release everything else main() set up
+void release_host(pipeline_host_t* host) {
+    autoscale_destroy(&host->autoscaler);
+    executor_destroy(&host->executor);
+    multiprocess_close(&host->processes);
+    cleanup_plugins(host->plugins, host->num_plugins);
+    
+    // Every recording thread is joined now
+    if (host->trace_output) {
+        const char* error = trace_export(&host->trace, host->trace_output);
+        if (error) {
+            fprintf(stderr, "Error writing trace: %s\n", error);
+        }
+    }
+    trace_destroy(&host->trace);
+    
+    ingest_close(&host->ingest);
+    capture_close(&host->capture);
+    replay_close(&host->replay);
+    
+    if (host->server) {
+        server_close(host->server);
+        free(host->server);
+        host->server = NULL;
+    }
+    
+    priority_start(NULL);
+    compose_destroy(&host->composer);
+    free(host->plugins);
+    free(host->options->inputs);
+}
+
 int main(int argc, char* argv[]) {
     char* program_name = argv[0];
+    pipeline_options_t options;
+
+    int arg_index = parse_options(argc, argv, &options);
+    if (arg_index < 0) {
+        print_usage(program_name);
+        return 1;
+    }
+    
+    // Plugins write stdout without flushing it. Only a run over a file on stdin (or a replay) is
+    // sure to end; a pipe, a server or a reader of long-lived inputs may run until it is killed,
+    // and a stage process can be killed on its own, so there every line is flushed as it is written
+    struct stat input_stat;
+    int file_input = options.replay_path || (fstat(STDIN_FILENO, &input_stat) == 0 && S_ISREG(input_stat.st_mode));
+    if (!file_input || options.listen_path || options.listen_port > 0 || options.num_inputs > 0 ||
+        options.processes) {
+        setvbuf(stdout, NULL, _IOLBF, 0);
+    }
+    
+    // Skip the options, the positional arguments keep their usual positions
+    argc -= arg_index - 1;
+    argv += arg_index - 1;
 
     if (argc < 3) {
         fprintf(stderr, "Error: Invalid number of arguments\n");
         print_usage(program_name);
+        free(options.inputs);
         return 1;
     }
 
@@ -146,6 +597,7 @@ int main(int argc, char* argv[]) {
         if (*char_in_arg < '0' || *char_in_arg > '9') {
             fprintf(stderr, "Error: Invalid queue size\n");
             print_usage(program_name);
+            free(options.inputs);
             return 1;
         }
     }
@@ -155,67 +607,389 @@ int main(int argc, char* argv[]) {
     if (queue_size <= 0) {
         fprintf(stderr, "Error: Invalid queue size\n");
         print_usage(program_name);
+        free(options.inputs);
         return 1;
     }
     
-    int num_plugins = argc - 2;
-    plugin_handle_t* plugins = malloc(num_plugins * sizeof(plugin_handle_t));
-    if (!plugins) {
+    pipeline_host_t host;
+    memset(&host, 0, sizeof(host));
+    host.options = &options;
+    host.num_plugins = argc - 2;
+    host.plugins = malloc(host.num_plugins * sizeof(plugin_handle_t));
+    if (!host.plugins) {
         fprintf(stderr, "Error: Failed to allocate memory for plugins\n");
+        free(options.inputs);
         return 1;
     }
     
     // Initialize plugins array
+    plugin_handle_t* plugins = host.plugins;
+    int num_plugins = host.num_plugins;
     memset(plugins, 0, num_plugins * sizeof(plugin_handle_t));
     
     // Load all plugins
     for (int i = 0; i < num_plugins; i++) {
         if (load_plugin(argv[i + 2], &plugins[i], program_name) != 0) {
-            cleanup_plugins(plugins, i);
-            free(plugins);
+            host.num_plugins = i;
+            release_host(&host);
             print_usage(program_name);
             return 1;
         }
     }
     
+    // Text plugins decide whether they describe a fusable byte transform by their mode
+    if (options.utf8) {
+        for (int i = 0; i < num_plugins; i++) {
+            if (plugins[i].set_utf8) {
+                plugins[i].set_utf8(1);
+            }
+        }
+    }
+    
+    // Taps watch a neighbouring plugin instead of running as stages, unless every stage is
+    // counted, traced or isolated in a process on its own - folded first, so fusion sees past them
+    if (!options.perf && !options.trace_path && !options.processes) {
+        const char* error = tap_fold(plugins, &num_plugins);
+        if (error) {
+            fprintf(stderr, "Error attaching taps: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // Folded plugins move behind the chain, from here on only the first num_plugins take part
+    if (options.fuse || options.memo_limit > 0) {
+        host.composer.memo_limit = options.memo_limit;
+        const char* error = compose_fuse(&host.composer, plugins, &num_plugins);
+        if (error) {
+            fprintf(stderr, "Error fusing plugins: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // Only now the taps are handed over, after fusion moved the ones inside a run into its kernel
+    if (!options.perf && !options.trace_path && !options.processes) {
+        const char* error = tap_attach(plugins, num_plugins);
+        if (error) {
+            fprintf(stderr, "Error attaching taps: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // Every input stream (and every client) is tagged, so the whole chain has to pass item metadata on
+    int serving = options.listen_path || options.listen_port > 0;
+    int prioritized = options.priority.enabled;
+    if (options.num_inputs > 0 || serving || prioritized) {
+        for (int i = 0; i < num_plugins; i++) {
+            if (!plugins[i].place_work_meta || !plugins[i].attach_meta) {
+                fprintf(stderr, "Error initializing plugin %s: Plugin does not support input streams\n", plugins[i].name);
+                release_host(&host);
+                return 2;
+            }
+        }
+    }
+    
+    if (options.num_inputs > 0) {
+        const char* error = ingest_open(&host.ingest, options.inputs, options.num_inputs, options.output_dir);
+        if (error) {
+            fprintf(stderr, "Error opening inputs: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    if (options.capture_path) {
+        const char* error = capture_open(&host.capture, options.capture_path);
+        if (error) {
+            fprintf(stderr, "Error opening capture: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    if (options.replay_path) {
+        const char* error = replay_open(&host.replay, options.replay_path, options.replay_speed);
+        if (error) {
+            fprintf(stderr, "Error opening replay: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // The listeners are set up before any pool or plugin thread exists, see server_open
+    if (serving) {
+        server_t* server = (server_t*)malloc(sizeof(server_t));
+        const char* error = server ? server_open(server, options.listen_path, options.listen_port)
+                                   : "Failed to allocate memory for server";
+        if (error) {
+            fprintf(stderr, "Error starting server: %s\n", error);
+            free(server);
+            release_host(&host);
+            return 2;
+        }
+        host.server = server;
+    }
+    
+    // Hand the plugins over to the pool before they start their own threads
+    if (options.pool_workers > 0) {
+        const char* error = executor_init(&host.executor, plugins, num_plugins, options.pool_workers);
+        if (error) {
+            fprintf(stderr, "Error starting executor: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // Queues over their budget spill to disk instead of blocking the reader
+    if (options.queue_bytes > 0 || options.pipeline_bytes > 0) {
+        const char* spill_dir = options.spill_dir;
+        if (!spill_dir) {
+            spill_dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+        }
+        
+        host.budget.limit = options.pipeline_bytes;
+        for (int i = 0; i < num_plugins; i++) {
+            if (!plugins[i].set_byte_budget) {
+                fprintf(stderr, "Error initializing plugin %s: Plugin does not support byte budgets\n", plugins[i].name);
+                release_host(&host);
+                return 2;
+            }
+            plugins[i].set_byte_budget(options.queue_bytes, options.pipeline_bytes > 0 ? &host.budget : NULL, spill_dir);
+        }
+    }
+    
+    // Every queue serves its priority lanes by the same weights
+    if (options.priority.weights[0] > 0) {
+        for (int i = 0; i < num_plugins; i++) {
+            if (!plugins[i].set_lane_weights) {
+                fprintf(stderr, "Error initializing plugin %s: Plugin does not support weighted lanes\n", plugins[i].name);
+                release_host(&host);
+                return 2;
+            }
+            plugins[i].set_lane_weights(options.priority.weights);
+        }
+    }
+    
+    // Full queues shed items by the policy of their plugin instead of blocking the producer
+    if (options.overload.num_rules > 0) {
+        const char* error = overload_apply(&options.overload, plugins, num_plugins);
+        if (error) {
+            fprintf(stderr, "Error applying --overload: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    if (options.perf) {
+        for (int i = 0; i < num_plugins; i++) {
+            if (!plugins[i].set_perf_counters) {
+                fprintf(stderr, "Error initializing plugin %s: Plugin does not support performance counters\n", plugins[i].name);
+                release_host(&host);
+                return 2;
+            }
+            plugins[i].set_perf_counters();
+        }
+    }
+    
+    // Every plugin records into its own stage of the timeline
+    if (options.trace_path) {
+        trace_init(&host.trace, options.trace_sample);
+        for (int i = 0; i < num_plugins; i++) {
+            if (!plugins[i].set_trace) {
+                fprintf(stderr, "Error initializing plugin %s: Plugin does not support tracing\n", plugins[i].name);
+                release_host(&host);
+                return 2;
+            }
+            plugins[i].set_trace(&host.trace, trace_add_stage(&host.trace, plugins[i].name));
+        }
+    }
+    
+    // Every stage process takes items from its ring and passes them inline through its group
+    if (options.processes) {
+        for (int i = 0; i < num_plugins; i++) {
+            if (!plugins[i].set_inline || !plugins[i].place_work_meta || !plugins[i].attach_meta) {
+                fprintf(stderr, "Error initializing plugin %s: Plugin does not support stage processes\n", plugins[i].name);
+                release_host(&host);
+                return 2;
+            }
+        }
+        
+        const char* error = multiprocess_set_groups(&host.processes, options.process_groups, num_plugins);
+        if (error) {
+            fprintf(stderr, "Error starting stage processes: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // The pattern file goes to every filtering plugin of the chain
+    if (options.filter_path) {
+        int filters = 0;
+        for (int i = 0; i < num_plugins; i++) {
+            if (plugins[i].set_patterns) {
+                plugins[i].set_patterns(options.filter_path, options.filter_drop);
+                filters++;
+            }
+        }
+        if (filters == 0) {
+            fprintf(stderr, "Error: --filter-keep and --filter-drop need the filter plugin in the chain\n");
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // Stateless plugins get elastic consumer threads, all plugins share the thread budget
+    if (options.autoscale) {
+        int budget = options.thread_budget > 0 ? options.thread_budget : num_plugins + thread_pool_default_size();
+        const char* error = autoscale_init(&host.autoscaler, plugins, num_plugins, budget);
+        if (error) {
+            fprintf(stderr, "Error starting autoscaler: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+    }
+    
+    // Inline plugins call straight into each other on the reading thread
+    if (options.inline_mode || options.processes) {
+        for (int i = 0; i < num_plugins; i++) {
+            if (!plugins[i].set_inline) {
+                fprintf(stderr, "Error initializing plugin %s: Plugin does not support inline execution\n", plugins[i].name);
+                release_host(&host);
+                return 2;
+            }
+            plugins[i].set_inline();
+        }
+    }
+    
     // Initialize all plugins
     for (int i = 0; i < num_plugins; i++) {
         const char* error = plugins[i].init(queue_size);
         if (error) {
             fprintf(stderr, "Error initializing plugin %s: %s\n", plugins[i].name, error);
-            cleanup_plugins(plugins, num_plugins);
-            free(plugins);
+            release_host(&host);
             return 2;
         }
     }
     
-    // Attach plugins together
+    // Attach plugins together, keeping item metadata when both sides support it
     for (int i = 0; i < num_plugins - 1; i++) {
-        plugins[i].attach(plugins[i + 1].place_work);
+        if (plugins[i].attach_meta && plugins[i + 1].place_work_meta) {
+            plugins[i].attach_meta(plugins[i + 1].place_work_meta);
+        } else {
+            plugins[i].attach(plugins[i + 1].place_work);
+        }
+        if (options.pool_workers > 0) {
+            plugins[i].attach_try(plugins[i + 1].try_place_work);
+        }
+    }
+    
+    // Lines are classified and stamped as they come in, the sinks record their latency
+    if (prioritized) {
+        priority_start(&options.priority);
+    }
+    
+    // The chain is entered at its first plugin and left after its last one, unless it runs in
+    // stage processes - then a stand-in handle feeds the first ring and drains the last one
+    plugin_handle_t* first = &plugins[0];
+    plugin_handle_t* last = &plugins[num_plugins - 1];
+    if (options.processes) {
+        const char* error = multiprocess_start(&host.processes, plugins, queue_size);
+        if (error) {
+            fprintf(stderr, "Error starting stage processes: %s\n", error);
+            release_host(&host);
+            return 2;
+        }
+        first = &host.processes.entry;
+        last = &host.processes.entry;
     }
     
-    // Read input and process
-    char line[1025];
-    while (fgets(line, sizeof(line), stdin)) {
-        int len = strlen(line);
-        if (len > 0 && line[len - 1] == '\n') {
-            line[len - 1] = '\0';
+    if (options.autoscale) {
+        const char* error = autoscale_start(&host.autoscaler, queue_size);
+        if (error) {
+            fprintf(stderr, "Error starting autoscaler: %s\n", error);
+            release_host(&host);
+            return 2;
         }
+    }
+    
+    if (serving) {
+        // Results go back to the client connection they came from
+        last->attach_meta(server_sink);
         
-        if (num_plugins > 0) {
-            const char* error = plugins[0].place_work(line);
-            if (error) {
-                fprintf(stderr, "Error placing work: %s\n", error);
-                break;
-            }
+        const char* error = server_run(host.server, first);
+        if (error) {
+            fprintf(stderr, "Error serving clients: %s\n", error);
+        }
+        
+        // Stopped and every connection is finished, shut the pipeline down
+        first->place_work("<END>");
+    
+    } else if (options.num_inputs > 0) {
+        // Results are split back per stream by the sink after the last plugin
+        last->attach_meta(ingest_sink);
+        
+        const char* error = ingest_run(&host.ingest, first);
+        if (error) {
+            fprintf(stderr, "Error reading input: %s\n", error);
         }
         
-        if (strcmp(line, "<END>") == 0) {
-            break;
+        // All streams are closed, shut the pipeline down
+        first->place_work("<END>");
+    
+    } else if (options.replay_path) {
+        // Nothing consumes the results, the sink only records their latency
+        last->attach_meta(priority_sink);
+        
+        // The queues are sampled as the lines arrive, a stage process group has only its ring
+        plugin_handle_t* queues = options.processes ? &host.processes.entry : plugins;
+        const char* error = replay_run(&host.replay, first, queues, options.processes ? 1 : num_plugins, queue_size);
+        if (error) {
+            fprintf(stderr, "Error replaying capture: %s\n", error);
+        }
+        
+        // The whole capture is placed, shut the pipeline down
+        first->place_work("<END>");
+    
+    } else {
+        // Nothing consumes the results, the sink only records their latency
+        if (prioritized) {
+            last->attach_meta(priority_sink);
+        }
+        
+        // Read input and process
+        char line[1025];
+        while (fgets(line, sizeof(line), stdin)) {
+            int len = strlen(line);
+            if (len > 0 && line[len - 1] == '\n') {
+                line[len - 1] = '\0';
+            }
+            
+            capture_record(line);
+            if (num_plugins > 0) {
+                work_meta_t meta = {0};
+                priority_stamp(line, NULL, &meta);
+                const char* error = prioritized ? first->place_work_meta(line, &meta) : first->place_work(line);
+                if (error) {
+                    fprintf(stderr, "Error placing work: %s\n", error);
+                    break;
+                }
+            }
+            
+            if (strcmp(line, "<END>") == 0) {
+                break;
+            }
         }
     }
     
     // Wait for all plugins to finish
+    if (options.processes) {
+        const char* error = multiprocess_wait(&host.processes);
+        if (error) {
+            fprintf(stderr, "Error waiting for stage processes: %s\n", error);
+        }
+    }
     for (int i = 0; i < num_plugins; i++) {
         const char* error = plugins[i].wait_finished();
         if (error) {
@@ -223,9 +997,17 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    autoscale_stop(&host.autoscaler);
+    
+    compose_report(&host.composer);
+    autoscale_report(&host.autoscaler);
+    overload_report(&options.overload, plugins, num_plugins);
+    replay_report(&host.replay);
+    priority_report(&options.priority);
+    host.trace_output = options.trace_path;
+    
     // Cleanup
-    cleanup_plugins(plugins, num_plugins);
-    free(plugins);
+    release_host(&host);
     
     // Finalize
     printf("Pipeline shutdown complete\n");
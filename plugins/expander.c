@@ -31,6 +31,23 @@ const char* plugin_transform(const char* input) {
     return result_of_transform; 
 }
 
+// A space between every two characters
+static int expand_length(int length) {
+    return length > 0 ? length + (length - 1) : 0;
+}
+
+// Even output positions hold the input characters, odd ones the fill space
+static int expand_source(int index, int length) {
+    (void)length;
+    return index % 2 == 0 ? index / 2 : -1;
+}
+
+static const plugin_descriptor_t descriptor = { TRANSFORM_EXPAND, NULL, expand_length, expand_source, ' ' };
+
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return &descriptor;
+}
+
 const char* plugin_init(int queue_size) {
     return common_plugin_init(plugin_transform, "expander", queue_size);
 }
@@ -0,0 +1,417 @@
+#include "plugin_common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILTER_HAVE_SSSE3 1
+#endif
+
+/** 
+ * Literal multi-pattern line filter 
+ * Small pattern sets are searched with Teddy: the first bytes of every pattern are folded into 
+ * nibble masks, so 16 positions of a line are checked against all patterns with a few shuffles, 
+ * and only positions that survive are compared in full. Large sets would crowd the Teddy buckets 
+ * and go to an Aho-Corasick automaton instead, which looks at every byte once. The automaton 
+ * keeps a full 256-entry row only for its root and sibling lists with failure links for every 
+ * other state, so it takes a few ints per pattern byte. 
+ */
+
+// Teddy compares up to this many leading bytes of every pattern at once
+#define TEDDY_PREFIX 3
+
+// Teddy buckets, one bit of a candidate byte each
+#define TEDDY_BUCKETS 8
+
+// Larger pattern sets are matched by the automaton
+#define TEDDY_MAX_PATTERNS 64
+
+// Limit on all pattern bytes together (the automaton has a state per byte)
+#define FILTER_MAX_PATTERN_BYTES (64 * 1024)
+
+typedef struct
+{
+    char** patterns;                             /* Literal patterns */
+    size_t* lengths;                             /* Length of each pattern */
+    int num_patterns;                            /* Number of patterns */
+    size_t pattern_bytes;                        /* Bytes of all patterns */
+    int prefix;                                  /* Leading bytes folded into the Teddy masks */
+    unsigned char low_masks[TEDDY_PREFIX][16];   /* Buckets allowed per low nibble, per prefix position */
+    unsigned char high_masks[TEDDY_PREFIX][16];  /* Buckets allowed per high nibble, per prefix position */
+    int bucket_patterns[TEDDY_BUCKETS][TEDDY_MAX_PATTERNS]; /* Patterns of each bucket */
+    int bucket_sizes[TEDDY_BUCKETS];             /* Number of patterns in each bucket */
+    int root[256];                               /* Automaton: next state of the root per byte */
+    int* first_child;                            /* Automaton: first trie child of each state (-1 = none, NULL = Teddy) */
+    int* next_sibling;                           /* Automaton: next trie child of the same parent (-1 = none) */
+    unsigned char* labels;                       /* Automaton: byte on the edge into each state */
+    int* failure;                                /* Automaton: longest proper suffix of each state that is a prefix */
+    unsigned char* accepting;                    /* Automaton: a pattern ends in this state */
+    int (*search)(const char*, size_t);          /* Matcher picked for the pattern set and the CPU */
+    const char* search_name;                     /* Name of the matcher, for the report */
+} filter_matcher_t;
+
+static filter_matcher_t matcher;
+static const char* pattern_path = NULL;
+static int drop_matches = 0;
+
+static unsigned long lines_seen = 0;
+static unsigned long lines_dropped = 0;
+static size_t bytes_scanned = 0;
+static double start_ns = 0;
+
+static double now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Compare every pattern of the candidate buckets at position in full
+static int verify(const char* text, size_t length, size_t position, unsigned int buckets) {
+    while (buckets) {
+        int bucket = __builtin_ctz(buckets);
+        buckets &= buckets - 1;
+        
+        for (int i = 0; i < matcher.bucket_sizes[bucket]; i++) {
+            int pattern = matcher.bucket_patterns[bucket][i];
+            size_t pattern_length = matcher.lengths[pattern];
+            if (position + pattern_length <= length &&
+                memcmp(text + position, matcher.patterns[pattern], pattern_length) == 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Teddy one position at a time, for CPUs without byte shuffles
+static int teddy_search_scalar(const char* text, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)text;
+    
+    for (size_t i = 0; i + matcher.prefix <= length; i++) {
+        unsigned int candidates = 0xff;
+        for (int k = 0; k < matcher.prefix; k++) {
+            unsigned char c = bytes[i + k];
+            candidates &= matcher.low_masks[k][c & 0x0f] & matcher.high_masks[k][c >> 4];
+        }
+        
+        if (candidates && verify(text, length, i, candidates)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#ifdef FILTER_HAVE_SSSE3
+// Teddy on 16 positions at a time: a byte of the candidate vector holds the buckets whose
+// patterns start with the bytes found at that position
+__attribute__((target("ssse3")))
+static int teddy_search_ssse3(const char* text, size_t length) {
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i low[TEDDY_PREFIX];
+    __m128i high[TEDDY_PREFIX];
+    for (int k = 0; k < matcher.prefix; k++) {
+        low[k] = _mm_loadu_si128((const __m128i*)matcher.low_masks[k]);
+        high[k] = _mm_loadu_si128((const __m128i*)matcher.high_masks[k]);
+    }
+    
+    // The last block is copied into a zero-padded buffer, verify rejects matches past the end
+    unsigned char padded[16 + TEDDY_PREFIX];
+    
+    for (size_t i = 0; i < length; i += 16) {
+        const unsigned char* block = (const unsigned char*)text + i;
+        if (i + 16 + TEDDY_PREFIX - 1 > length) {
+            memset(padded, 0, sizeof(padded));
+            memcpy(padded, text + i, length - i);
+            block = padded;
+        }
+        
+        __m128i candidates = _mm_set1_epi8((char)0xff);
+        for (int k = 0; k < matcher.prefix; k++) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(block + k));
+            __m128i low_buckets = _mm_shuffle_epi8(low[k], _mm_and_si128(bytes, nibble));
+            __m128i high_buckets = _mm_shuffle_epi8(high[k], _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+            candidates = _mm_and_si128(candidates, _mm_and_si128(low_buckets, high_buckets));
+        }
+        
+        unsigned int positions = ~_mm_movemask_epi8(_mm_cmpeq_epi8(candidates, _mm_setzero_si128())) & 0xffff;
+        if (positions == 0) {
+            continue;
+        }
+        
+        unsigned char buckets[16];
+        _mm_storeu_si128((__m128i*)buckets, candidates);
+        while (positions) {
+            int position = __builtin_ctz(positions);
+            positions &= positions - 1;
+            if (verify(text, length, i + position, buckets[position])) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+#endif
+
+// Trie child of state along byte c, -1 if there is none
+static int child(int state, unsigned char c) {
+    int next = matcher.first_child[state];
+    while (next >= 0 && matcher.labels[next] != c) {
+        next = matcher.next_sibling[next];
+    }
+    return next;
+}
+
+// Next state of the automaton: follow failure links until a state has a child along c
+static int step(int state, unsigned char c) {
+    while (state != 0) {
+        int next = child(state, c);
+        if (next >= 0) {
+            return next;
+        }
+        state = matcher.failure[state];
+    }
+    return matcher.root[c];
+}
+
+static int automaton_search(const char* text, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)text;
+    int state = 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        state = step(state, bytes[i]);
+        if (matcher.accepting[state]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void build_teddy(void) {
+    matcher.prefix = TEDDY_PREFIX;
+    for (int i = 0; i < matcher.num_patterns; i++) {
+        if ((int)matcher.lengths[i] < matcher.prefix) {
+            matcher.prefix = matcher.lengths[i];
+        }
+    }
+    
+    for (int i = 0; i < matcher.num_patterns; i++) {
+        int bucket = i % TEDDY_BUCKETS;
+        matcher.bucket_patterns[bucket][matcher.bucket_sizes[bucket]++] = i;
+        
+        for (int k = 0; k < matcher.prefix; k++) {
+            unsigned char c = (unsigned char)matcher.patterns[i][k];
+            matcher.low_masks[k][c & 0x0f] |= 1 << bucket;
+            matcher.high_masks[k][c >> 4] |= 1 << bucket;
+        }
+    }
+    
+    matcher.search = teddy_search_scalar;
+    matcher.search_name = "teddy";
+#ifdef FILTER_HAVE_SSSE3
+    if (__builtin_cpu_supports("ssse3")) {
+        matcher.search = teddy_search_ssse3;
+        matcher.search_name = "teddy-ssse3";
+    }
+#endif
+}
+
+// Trie of all patterns, with failure links set breadth-first
+static const char* build_automaton(void) {
+    int max_states = matcher.pattern_bytes + 1;
+    matcher.first_child = (int*)malloc(max_states * sizeof(int));
+    matcher.next_sibling = (int*)malloc(max_states * sizeof(int));
+    matcher.labels = (unsigned char*)malloc(max_states);
+    matcher.failure = (int*)calloc(max_states, sizeof(int));
+    matcher.accepting = (unsigned char*)calloc(max_states, 1);
+    int* order = (int*)malloc(max_states * sizeof(int));
+    if (!matcher.first_child || !matcher.next_sibling || !matcher.labels || !matcher.failure ||
+        !matcher.accepting || !order) {
+        free(order);
+        return "Failed to allocate memory for the pattern automaton";
+    }
+    
+    int num_states = 1;
+    matcher.first_child[0] = -1;
+    for (int i = 0; i < matcher.num_patterns; i++) {
+        int state = 0;
+        for (size_t k = 0; k < matcher.lengths[i]; k++) {
+            unsigned char c = (unsigned char)matcher.patterns[i][k];
+            int next = child(state, c);
+            if (next < 0) {
+                next = num_states++;
+                matcher.labels[next] = c;
+                matcher.first_child[next] = -1;
+                matcher.next_sibling[next] = matcher.first_child[state];
+                matcher.first_child[state] = next;
+            }
+            state = next;
+        }
+        matcher.accepting[state] = 1;
+    }
+    
+    // The root row is complete, a byte that starts no pattern stays in the root
+    memset(matcher.root, 0, sizeof(matcher.root));
+    int head = 0;
+    int tail = 0;
+    for (int next = matcher.first_child[0]; next >= 0; next = matcher.next_sibling[next]) {
+        matcher.root[matcher.labels[next]] = next;
+        order[tail++] = next;
+    }
+    
+    // A state's failure is where its parent's failure steps along the same byte
+    while (head < tail) {
+        int state = order[head++];
+        for (int next = matcher.first_child[state]; next >= 0; next = matcher.next_sibling[next]) {
+            int fallback = step(matcher.failure[state], matcher.labels[next]);
+            matcher.failure[next] = fallback;
+            matcher.accepting[next] |= matcher.accepting[fallback];
+            order[tail++] = next;
+        }
+    }
+    
+    free(order);
+    matcher.search = automaton_search;
+    matcher.search_name = "aho-corasick";
+    return NULL;
+}
+
+static void free_patterns(void) {
+    for (int i = 0; i < matcher.num_patterns; i++) {
+        free(matcher.patterns[i]);
+    }
+    free(matcher.patterns);
+    free(matcher.lengths);
+    free(matcher.first_child);
+    free(matcher.next_sibling);
+    free(matcher.labels);
+    free(matcher.failure);
+    free(matcher.accepting);
+    memset(&matcher, 0, sizeof(matcher));
+}
+
+// One literal pattern per line, empty lines are skipped
+static const char* load_patterns(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return "Failed to open pattern file";
+    }
+    
+    const char* error = NULL;
+    int capacity = 0;
+    char* line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_capacity, file)) >= 0) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length == 0) {
+            continue;
+        }
+        
+        matcher.pattern_bytes += length;
+        if (matcher.pattern_bytes > FILTER_MAX_PATTERN_BYTES) {
+            error = "Pattern file too large";
+            break;
+        }
+        
+        if (matcher.num_patterns == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char** patterns = (char**)realloc(matcher.patterns, capacity * sizeof(char*));
+            size_t* lengths = patterns ? (size_t*)realloc(matcher.lengths, capacity * sizeof(size_t)) : NULL;
+            if (patterns) {
+                matcher.patterns = patterns;
+            }
+            if (!lengths) {
+                error = "Failed to allocate memory for patterns";
+                break;
+            }
+            matcher.lengths = lengths;
+        }
+        
+        matcher.patterns[matcher.num_patterns] = strdup(line);
+        if (!matcher.patterns[matcher.num_patterns]) {
+            error = "Failed to allocate memory for patterns";
+            break;
+        }
+        matcher.lengths[matcher.num_patterns++] = length;
+    }
+    
+    free(line);
+    fclose(file);
+    if (!error && matcher.num_patterns == 0) {
+        error = "Pattern file has no patterns";
+    }
+    return error;
+}
+
+// Returns the line itself to keep it (nothing is copied) or NULL to drop it
+const char* plugin_transform(const char* input) {
+    if (!input) {
+        return NULL;
+    }
+    
+    size_t length = strlen(input);
+    int matched = matcher.search(input, length);
+    
+    lines_seen++;
+    bytes_scanned += length;
+    if (matched == drop_matches) {
+        lines_dropped++;
+        return NULL;
+    }
+    
+    return input;
+}
+
+// A copy that never saw a line (e.g. the host's, with stage processes) has nothing to report
+// The run is timed once, from init until every line was filtered, instead of around every line -
+// so the rate includes the time the filter waited for its input
+static void report_and_free(void) {
+    if (lines_seen > 0) {
+        double run_ns = now_ns() - start_ns;
+        fprintf(stderr, "[STATS][filter] - %d patterns (%s), %s matching lines: %lu lines, %lu dropped (%.1f%%), "
+                "%zu bytes scanned at %.1f MB/s over the run\n",
+                matcher.num_patterns, matcher.search_name, drop_matches ? "dropped" : "kept",
+                lines_seen, lines_dropped, 100.0 * lines_dropped / lines_seen,
+                bytes_scanned, run_ns > 0 ? bytes_scanned / run_ns * 1000.0 : 0.0);
+    }
+    free_patterns();
+    lines_seen = 0;
+    lines_dropped = 0;
+    bytes_scanned = 0;
+}
+
+void plugin_set_patterns(const char* path, int drop) {
+    pattern_path = path;
+    drop_matches = drop ? 1 : 0;
+}
+
+const char* plugin_init(int queue_size) {
+    if (!pattern_path) {
+        return "No pattern file given (use --filter-keep or --filter-drop)";
+    }
+    
+    const char* error = load_patterns(pattern_path);
+    if (!error && matcher.num_patterns > TEDDY_MAX_PATTERNS) {
+        error = build_automaton();
+    } else if (!error) {
+        build_teddy();
+    }
+    if (!error) {
+        error = common_plugin_init(plugin_transform, "filter", queue_size);
+    }
+    if (error) {
+        free_patterns();
+        return error;
+    }
+    
+    common_plugin_set_fini(report_and_free);
+    start_ns = now_ns();
+    return NULL;
+}
+
+const char* plugin_get_name(void) {
+    return "filter";
+}
@@ -1,14 +1,29 @@
 #include "plugin_common.h"
+#include "utf8.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+// Transform code points instead of bytes, set by plugin_set_utf8
+static int utf8_mode = 0;
+
+static int flip_source(int index, int length);
+
 const char* plugin_transform(const char* input) {
     if (!input) {
         return NULL;
     }
 
     int length_of_input = strlen(input);
+    
+    // Reverse the characters, not the bytes, when the line has more than ASCII in UTF-8 mode
+    if (utf8_mode && !utf8_is_ascii(input, length_of_input)) {
+        char* moved = utf8_transform(input, length_of_input, flip_source, NULL);
+        if (moved) {
+            return moved;
+        }
+    }
+    
     char* result_of_transform = malloc(length_of_input + 1);
     if (!result_of_transform) {
         return NULL;
@@ -23,6 +38,25 @@ const char* plugin_transform(const char* input) {
     return result_of_transform;
 }
 
+// Output byte (or character, in UTF-8 mode) i comes from the mirrored input position
+static int flip_source(int index, int length) {
+    return length - 1 - index;
+}
+
+static const plugin_descriptor_t descriptor = { TRANSFORM_PERMUTE, NULL, NULL, flip_source, 0 };
+
+// Byte positions only match character positions without UTF-8 mode
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return utf8_mode ? NULL : &descriptor;
+}
+
+void plugin_set_utf8(int enabled) {
+    utf8_mode = enabled;
+    if (enabled) {
+        utf8_init();
+    }
+}
+
 const char* plugin_init(int queue_size) {
     return common_plugin_init(plugin_transform, "flipper", queue_size);
 }
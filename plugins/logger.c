@@ -3,14 +3,21 @@
 #include <string.h>
 #include <stdlib.h>
 
+// Logging only reads the line, so it is passed on as it is, without a copy; stdout is
+// not flushed per line, the host line-buffers it unless the input is a file that will end
 const char* plugin_transform(const char* input) {
     if (!input) {
         return NULL;
     }
-    
+
     printf("[logger] %s\n", input);
-    fflush(stdout);
-    return strdup(input);
+    return input;
+}
+
+// As a tap the logger sees the line on the thread of the plugin in front of it
+void plugin_observe(const char* str, const work_meta_t* meta) {
+    (void)meta;
+    plugin_transform(str);
 }
 
 const char* plugin_init(int queue_size) {
@@ -0,0 +1,163 @@
+#define _GNU_SOURCE
+#include "perf_counters.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+static const char* phase_names[PERF_NUM_PHASES] = {"process", "wait"};
+
+static double now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Count one event for the calling thread on any CPU
+static int open_counter(unsigned int type, unsigned long long config, int exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static unsigned long long read_counter(const perf_counters_t* counters, int counter) {
+    if (counter == PERF_COUNTER_CONTEXT_SWITCHES && counters->rusage_switches) {
+        struct rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+            return 0;
+        }
+        return usage.ru_nvcsw + usage.ru_nivcsw;
+    }
+    
+    unsigned long long value = 0;
+    if (counters->fds[counter] < 0 || read(counters->fds[counter], &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+static int available(const perf_counters_t* counters, int counter) {
+    return counters->fds[counter] >= 0 || (counter == PERF_COUNTER_CONTEXT_SWITCHES && counters->rusage_switches);
+}
+
+int perf_counters_open(perf_counters_t* counters) {
+    static const struct {
+        unsigned int type;
+        unsigned long long config;
+    } events[PERF_NUM_COUNTERS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    };
+    
+    memset(counters, 0, sizeof(*counters));
+    int opened = 0;
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        // With perf_event_paranoid >= 2 only user space may be counted
+        int fd = open_counter(events[i].type, events[i].config, 0);
+        if (fd < 0 && i != PERF_COUNTER_CONTEXT_SWITCHES) {
+            fd = open_counter(events[i].type, events[i].config, 1);
+        }
+        
+        if (fd < 0 && i != PERF_COUNTER_CONTEXT_SWITCHES && counters->open_error == 0) {
+            counters->open_error = errno;
+        }
+        
+        counters->fds[i] = fd;
+        if (fd >= 0) {
+            opened++;
+        }
+    }
+    
+    // Switches happen in the kernel, so they cannot be counted from user space alone
+    counters->rusage_switches = (counters->fds[PERF_COUNTER_CONTEXT_SWITCHES] < 0);
+    
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        counters->last[i] = read_counter(counters, i);
+    }
+    counters->last_ns = now_ns();
+    return opened;
+}
+
+void perf_counters_mark(perf_counters_t* counters, int phase) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (!available(counters, i)) {
+            continue;
+        }
+        
+        unsigned long long value = read_counter(counters, i);
+        counters->totals[phase][i] += value - counters->last[i];
+        counters->last[i] = value;
+    }
+    
+    double now = now_ns();
+    counters->ns[phase] += now - counters->last_ns;
+    counters->last_ns = now;
+}
+
+// Print value / divisor, or n/a if the counter is missing
+static void format_ratio(char* buffer, size_t size, const perf_counters_t* counters, int counter,
+                         unsigned long long value, double divisor) {
+    if (!available(counters, counter) || divisor <= 0) {
+        snprintf(buffer, size, "n/a");
+    } else {
+        snprintf(buffer, size, "%.2f", value / divisor);
+    }
+}
+
+void perf_counters_report(const perf_counters_t* counters, const char* name) {
+    if (counters->open_error != 0) {
+        fprintf(stderr, "[STATS][%s] - perf: some hardware counters are unavailable (%s), shown as n/a\n",
+                name, strerror(counters->open_error));
+    }
+    
+    for (int phase = 0; phase < PERF_NUM_PHASES; phase++) {
+        const unsigned long long* totals = counters->totals[phase];
+        char ipc[32], cycles[32], l1d[32], l1d_bytes[32], llc[32], llc_bytes[32], branches[32], switches[32];
+        
+        if (available(counters, PERF_COUNTER_INSTRUCTIONS) && available(counters, PERF_COUNTER_CYCLES)) {
+            format_ratio(ipc, sizeof(ipc), counters, PERF_COUNTER_INSTRUCTIONS, totals[PERF_COUNTER_INSTRUCTIONS],
+                         (double)totals[PERF_COUNTER_CYCLES]);
+        } else {
+            snprintf(ipc, sizeof(ipc), "n/a");
+        }
+        format_ratio(cycles, sizeof(cycles), counters, PERF_COUNTER_CYCLES, totals[PERF_COUNTER_CYCLES], counters->items);
+        format_ratio(l1d, sizeof(l1d), counters, PERF_COUNTER_L1D_MISSES, totals[PERF_COUNTER_L1D_MISSES], counters->items);
+        format_ratio(l1d_bytes, sizeof(l1d_bytes), counters, PERF_COUNTER_L1D_MISSES, totals[PERF_COUNTER_L1D_MISSES], counters->bytes);
+        format_ratio(llc, sizeof(llc), counters, PERF_COUNTER_LLC_MISSES, totals[PERF_COUNTER_LLC_MISSES], counters->items);
+        format_ratio(llc_bytes, sizeof(llc_bytes), counters, PERF_COUNTER_LLC_MISSES, totals[PERF_COUNTER_LLC_MISSES], counters->bytes);
+        format_ratio(branches, sizeof(branches), counters, PERF_COUNTER_BRANCH_MISSES, totals[PERF_COUNTER_BRANCH_MISSES], counters->items);
+        if (available(counters, PERF_COUNTER_CONTEXT_SWITCHES)) {
+            snprintf(switches, sizeof(switches), "%llu", totals[PERF_COUNTER_CONTEXT_SWITCHES]);
+        } else {
+            snprintf(switches, sizeof(switches), "n/a");
+        }
+        
+        fprintf(stderr, "[STATS][%s] - perf %s: %lu items, %zu bytes, %.3f ms, IPC %s, cycles/item %s, "
+                "L1D misses/item %s (/byte %s), LLC misses/item %s (/byte %s), branch misses/item %s, "
+                "context switches %s\n", name, phase_names[phase], counters->items, counters->bytes,
+                counters->ns[phase] / 1e6, ipc, cycles, l1d, l1d_bytes, llc, llc_bytes, branches, switches);
+    }
+}
+
+void perf_counters_close(perf_counters_t* counters) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+}
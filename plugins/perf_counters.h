@@ -0,0 +1,70 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stddef.h>
+
+/** 
+ * Per-thread hardware and software counters of a stage, read with perf_event_open 
+ * The consumer thread marks every switch between waiting on a queue and processing an item, 
+ * so the counts can be split between the two. Counters the kernel or the machine does not 
+ * offer (no PMU, perf_event_paranoid, seccomp, ...) are left out and reported as n/a; 
+ * context switches then fall back to getrusage(RUSAGE_THREAD). 
+ */
+
+typedef enum
+{
+    PERF_COUNTER_CYCLES = 0,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_L1D_MISSES,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_CONTEXT_SWITCHES,
+    PERF_NUM_COUNTERS
+} perf_counter_t;
+
+/* What the thread was doing since the previous mark */
+#define PERF_PHASE_PROCESS  0    /* Running the transform */
+#define PERF_PHASE_WAIT     1    /* Waiting for an item, or for room in the next queue */
+#define PERF_NUM_PHASES     2
+
+typedef struct
+{
+    int fds[PERF_NUM_COUNTERS];              /* Counter descriptors (-1 = unavailable) */
+    int rusage_switches;                     /* Context switches come from getrusage instead */
+    int open_error;                          /* errno of the first hardware counter that failed (0 = none) */
+    unsigned long long last[PERF_NUM_COUNTERS]; /* Readings at the previous mark */
+    double last_ns;                          /* Time of the previous mark */
+    unsigned long long totals[PERF_NUM_PHASES][PERF_NUM_COUNTERS]; /* Counts per phase */
+    double ns[PERF_NUM_PHASES];              /* Time per phase */
+    unsigned long items;                     /* Items processed */
+    size_t bytes;                            /* Input bytes processed */
+} perf_counters_t;
+
+/** 
+ * Open the counters of the calling thread and take the first reading 
+ * @param counters Pointer to counters structure 
+ * @return Number of perf counters that could be opened (0 is not an error) 
+ */
+int perf_counters_open(perf_counters_t* counters);
+
+/** 
+ * Attribute everything counted since the previous mark to a phase 
+ * @param counters Pointer to counters structure 
+ * @param phase PERF_PHASE_PROCESS or PERF_PHASE_WAIT 
+ */
+void perf_counters_mark(perf_counters_t* counters, int phase);
+
+/** 
+ * Print IPC and misses per item and per byte for both phases 
+ * @param counters Pointer to counters structure 
+ * @param name Stage name used in the report 
+ */
+void perf_counters_report(const perf_counters_t* counters, const char* name);
+
+/** 
+ * Close every counter 
+ * @param counters Pointer to counters structure 
+ */
+void perf_counters_close(perf_counters_t* counters);
+
+#endif
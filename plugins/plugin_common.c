@@ -5,28 +5,132 @@
 
 static plugin_context_t plugin_context = {0};
 
+// Pass an output (with its metadata) to the next plugin if exists
+static const char* forward(plugin_context_t* context, const char* output, const work_meta_t* meta) {
+    if (context->next_place_work_meta) {
+        return context->next_place_work_meta(output, meta);
+    }
+    
+    if (context->next_place_work) {
+        return context->next_place_work(output);
+    }
+    
+    return NULL;
+}
+
+// Run the plugin's own transform, or the host kernel that replaced it
+static const char* process_item(plugin_context_t* context, const char* item) {
+    if (context->process_override) {
+        return context->process_override(context->process_override_arg, item);
+    }
+    
+    return context->process_function(item);
+}
+
+// Show an output to the taps behind the plugin before it is passed on
+static void observe_output(plugin_context_t* context, const char* output, const work_meta_t* meta) {
+    for (int i = 0; i < context->num_output_taps; i++) {
+        context->output_taps[i](output, meta);
+    }
+}
+
+// Show an accepted item to the taps in front of the plugin
+static void observe_input(plugin_context_t* context, const char* item, const work_meta_t* meta) {
+    if (context->num_input_taps == 0 || strcmp(item, "<END>") == 0) {
+        return;
+    }
+    
+    for (int i = 0; i < context->num_input_taps; i++) {
+        context->input_taps[i](item, meta);
+    }
+}
+
+// Start time of a timeline event (0 when not tracing)
+static long long trace_start(plugin_context_t* context) {
+    return context->trace ? trace_now() : 0;
+}
+
+// Decide whether the events of a newly taken item are recorded
+static void trace_item(plugin_context_t* context) {
+    if (context->trace) {
+        context->trace_sampled = trace_sampled(context->trace, &context->trace_items);
+    }
+}
+
+// Record a timeline event that started at start for the current item
+static void trace_event(plugin_context_t* context, int kind, long long start, const work_meta_t* meta, int dedicated) {
+    if (context->trace) {
+        trace_record(context->trace, context->trace_stage, kind, start, meta ? meta->stream : 0,
+                     context->trace_sampled, dedicated);
+    }
+}
+
+// A broken queue ends the plugin early - the error is reported and an <END> is passed on, so
+// the plugins behind it still shut down instead of waiting for it forever
+static void end_broken_queue(plugin_context_t* context) {
+    fprintf(stderr, "[ERROR][%s] - %s\n", context->name, consumer_producer_error(context->queue));
+    
+    work_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    forward(context, "<END>", &meta);
+}
+
 void* plugin_consumer_thread(void* arg) {
     plugin_context_t* context = (plugin_context_t*)arg;
     
+    // Counters are per thread, so they are opened by the thread they count
+    if (context->perf_enabled) {
+        perf_counters_open(&context->perf);
+    }
+    
     while (1) {
-        char* item = consumer_producer_get(context->queue);
+        work_meta_t meta;
+        long long wait_start = trace_start(context);
+        char* item = consumer_producer_get_meta(context->queue, &meta);
+        if (context->perf_enabled) {
+            perf_counters_mark(&context->perf, PERF_PHASE_WAIT);
+        }
         if (!item) {
+            if (consumer_producer_error(context->queue)) {
+                end_broken_queue(context);
+            }
             break;
         }
         
+        trace_item(context);
+        trace_event(context, TRACE_WAIT, wait_start, &meta, 1);
+        
         if (strcmp(item, "<END>") == 0) {
-            if (context->next_place_work) {
-                context->next_place_work(item);
-            }
-            
+            forward(context, item, &meta);
             free(item);
+            
+            // An <END> of an ingest stream only closes that stream
+            if (meta.stream != 0) {
+                continue;
+            }
             break;
         }
         
-        const char* processed = context->process_function(item);
+        long long process_start = trace_start(context);
+        const char* processed = process_item(context, item);
+        trace_event(context, TRACE_PROCESS, process_start, &meta, 1);
+        if (context->perf_enabled) {
+            perf_counters_mark(&context->perf, PERF_PHASE_PROCESS);
+            context->perf.items++;
+            context->perf.bytes += strlen(item);
+        }
+        
         // Move to the next plugin if exists
-        if (context->next_place_work && processed) {
-            context->next_place_work(processed);
+        long long forward_start = trace_start(context);
+        if (processed) {
+            observe_output(context, processed, &meta);
+            forward(context, processed, &meta);
+        }
+        trace_event(context, TRACE_FORWARD, forward_start, &meta, 1);
+        
+        // A full next queue blocks forward, which counts as waiting
+        if (context->perf_enabled) {
+            perf_counters_mark(&context->perf, PERF_PHASE_WAIT);
         }
         
         // Free when the processed string is different from original
@@ -42,6 +146,317 @@ void* plugin_consumer_thread(void* arg) {
     return NULL;
 }
 
+// Retire the calling worker if the plugin has more threads than wanted - returns 1 if it has to exit
+static int retire_worker(plugin_context_t* context, plugin_worker_t* worker) {
+    pthread_mutex_lock(&context->scale_mutex);
+    int retire = context->live_workers > context->target_workers;
+    if (retire) {
+        context->live_workers--;
+        worker->exited = 1;
+    }
+    pthread_mutex_unlock(&context->scale_mutex);
+    return retire;
+}
+
+// Wait until every item taken before sequence has been forwarded
+static void wait_turn(plugin_context_t* context, unsigned long sequence) {
+    pthread_mutex_lock(&context->turn_mutex);
+    while (context->next_forward != sequence) {
+        pthread_cond_wait(&context->turn_cond, &context->turn_mutex);
+    }
+    pthread_mutex_unlock(&context->turn_mutex);
+}
+
+// Let the worker holding the next item forward it
+static void end_turn(plugin_context_t* context) {
+    pthread_mutex_lock(&context->turn_mutex);
+    context->next_forward++;
+    pthread_cond_broadcast(&context->turn_cond);
+    pthread_mutex_unlock(&context->turn_mutex);
+}
+
+// Elastic consumer thread: items are numbered as they are taken, processed in parallel with
+// the other workers and forwarded strictly in the order they were taken
+static void* plugin_worker_thread(void* arg) {
+    plugin_context_t* context = &plugin_context;
+    plugin_worker_t* worker = (plugin_worker_t*)arg;
+    
+    while (1) {
+        // A worker only waits for the queue once it holds take_mutex, so the retirement check
+        // is made there too - a worker that was queued on the mutex retires without waiting
+        work_meta_t meta;
+        int woken = 0;
+        pthread_mutex_lock(&context->take_mutex);
+        if (retire_worker(context, worker)) {
+            pthread_mutex_unlock(&context->take_mutex);
+            break;
+        }
+        char* item = consumer_producer_get_wakeable(context->queue, &meta, &woken);
+        unsigned long sequence = woken ? 0 : context->next_take++;
+        pthread_mutex_unlock(&context->take_mutex);
+        if (woken) {
+            continue;
+        }
+        if (!item) {
+            // A broken queue wakes every worker - the first to get its turn ends the plugin
+            if (consumer_producer_error(context->queue)) {
+                wait_turn(context, sequence);
+                if (!context->finished) {
+                    end_broken_queue(context);
+                    context->finished = 1;
+                }
+                end_turn(context);
+            }
+            
+            // The final <END> has been forwarded by another worker
+            pthread_mutex_lock(&context->scale_mutex);
+            context->live_workers--;
+            worker->exited = 1;
+            pthread_mutex_unlock(&context->scale_mutex);
+            break;
+        }
+        
+        if (strcmp(item, "<END>") == 0) {
+            wait_turn(context, sequence);
+            forward(context, item, &meta);
+            free(item);
+            
+            // An <END> of an ingest stream only closes that stream
+            if (meta.stream != 0) {
+                end_turn(context);
+                continue;
+            }
+            
+            // Everything before the <END> is forwarded, the other workers wake up with nothing to take
+            pthread_mutex_lock(&context->scale_mutex);
+            context->scaling_closed = 1;
+            context->live_workers--;
+            worker->exited = 1;
+            pthread_mutex_unlock(&context->scale_mutex);
+            context->finished = 1;
+            consumer_producer_signal_finished(context->queue);
+            break;
+        }
+        
+        const char* processed = process_item(context, item);
+        
+        wait_turn(context, sequence);
+        if (processed) {
+            observe_output(context, processed, &meta);
+            forward(context, processed, &meta);
+        }
+        end_turn(context);
+        
+        if (processed && processed != item) {
+            free((void*)processed);
+        }
+        
+        free(item);
+    }
+    
+    return NULL;
+}
+
+// Start workers until the wanted number runs - caller holds scale_mutex
+static const char* start_workers(plugin_context_t* context) {
+    for (int i = 0; i < context->max_workers && context->live_workers < context->target_workers; i++) {
+        plugin_worker_t* worker = &context->workers[i];
+        if (worker->started && !worker->exited) {
+            continue;
+        }
+        
+        // A retired worker's slot is reused once its thread is joined
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+            worker->started = 0;
+        }
+        
+        worker->exited = 0;
+        if (pthread_create(&worker->thread, NULL, plugin_worker_thread, worker) != 0) {
+            return "Failed to create consumer thread";
+        }
+        worker->started = 1;
+        context->live_workers++;
+    }
+    return NULL;
+}
+
+// Join every worker thread that was started
+static void join_workers(plugin_context_t* context) {
+    pthread_mutex_lock(&context->scale_mutex);
+    context->scaling_closed = 1;
+    pthread_mutex_unlock(&context->scale_mutex);
+    
+    for (int i = 0; i < context->max_workers; i++) {
+        if (context->workers[i].started) {
+            pthread_join(context->workers[i].thread, NULL);
+            context->workers[i].started = 0;
+        }
+    }
+}
+
+static void destroy_workers(plugin_context_t* context) {
+    pthread_cond_destroy(&context->turn_cond);
+    pthread_mutex_destroy(&context->turn_mutex);
+    pthread_mutex_destroy(&context->take_mutex);
+    pthread_mutex_destroy(&context->scale_mutex);
+}
+
+// Create the first worker of an elastic plugin
+static const char* init_workers(plugin_context_t* context) {
+    pthread_mutex_init(&context->scale_mutex, NULL);
+    pthread_mutex_init(&context->take_mutex, NULL);
+    pthread_mutex_init(&context->turn_mutex, NULL);
+    pthread_cond_init(&context->turn_cond, NULL);
+    memset(context->workers, 0, sizeof(context->workers));
+    context->target_workers = 1;
+    context->live_workers = 0;
+    context->scaling_closed = 0;
+    context->next_take = 0;
+    context->next_forward = 0;
+    
+    pthread_mutex_lock(&context->scale_mutex);
+    const char* error = start_workers(context);
+    pthread_mutex_unlock(&context->scale_mutex);
+    if (error) {
+        destroy_workers(context);
+    }
+    return error;
+}
+
+// Inline mode: process on the caller's thread and pass the result on depth-first
+static const char* process_inline(plugin_context_t* context, const char* str, const work_meta_t* meta) {
+    if (context->finished) {
+        return "Plugin already finished";
+    }
+    
+    if (strcmp(str, "<END>") == 0) {
+        if (!meta || meta->stream == 0) {
+            context->finished = 1;
+        }
+        return forward(context, str, meta);
+    }
+    
+    trace_item(context);
+    long long process_start = trace_start(context);
+    const char* error = NULL;
+    const char* processed = process_item(context, str);
+    trace_event(context, TRACE_PROCESS, process_start, meta, 0);
+    
+    // Downstream plugins run inside this call, so their events nest under forward
+    long long forward_start = trace_start(context);
+    if (processed) {
+        observe_output(context, processed, meta);
+        error = forward(context, processed, meta);
+    }
+    trace_event(context, TRACE_FORWARD, forward_start, meta, 0);
+    
+    if (processed && processed != str) {
+        free((void*)processed);
+    }
+    
+    return error;
+}
+
+// Hand an output to the next plugin without blocking - returns 1 if it has to be held back
+static int try_forward(plugin_context_t* context, const char* output, const work_meta_t* meta) {
+    if (context->next_try_place_work) {
+        return context->next_try_place_work(output, meta) == 1;
+    }
+    
+    forward(context, output, meta);
+    return 0;
+}
+
+static void finish_slices(plugin_context_t* context) {
+    consumer_producer_signal_finished(context->queue);
+    context->finished = 1;
+}
+
+int plugin_run_slice(int max_items) {
+    plugin_context_t* context = &plugin_context;
+    
+    if (!context->initialized || context->finished) {
+        return PLUGIN_SLICE_DONE;
+    }
+    
+    // Flush the output that was held back by the previous slice first
+    if (context->held_output) {
+        if (try_forward(context, context->held_output, &context->held_meta)) {
+            return PLUGIN_SLICE_BLOCKED;
+        }
+        
+        free(context->held_output);
+        context->held_output = NULL;
+        
+        if (context->held_end) {
+            finish_slices(context);
+            return PLUGIN_SLICE_DONE;
+        }
+    }
+    
+    for (int i = 0; i < max_items; i++) {
+        work_meta_t meta;
+        char* item = consumer_producer_try_get(context->queue, &meta);
+        if (!item && consumer_producer_error(context->queue)) {
+            fprintf(stderr, "[ERROR][%s] - %s\n", context->name, consumer_producer_error(context->queue));
+            item = strdup("<END>");
+            memset(&meta, 0, sizeof(meta));
+        }
+        if (!item) {
+            return PLUGIN_SLICE_IDLE;
+        }
+        
+        if (strcmp(item, "<END>") == 0) {
+            int stream_end = (meta.stream != 0);
+            if (try_forward(context, item, &meta)) {
+                context->held_output = item;
+                context->held_meta = meta;
+                context->held_end = !stream_end;
+                return PLUGIN_SLICE_BLOCKED;
+            }
+            
+            free(item);
+            if (stream_end) {
+                continue;
+            }
+            finish_slices(context);
+            return PLUGIN_SLICE_DONE;
+        }
+        
+        trace_item(context);
+        long long process_start = trace_start(context);
+        const char* processed = process_item(context, item);
+        trace_event(context, TRACE_PROCESS, process_start, &meta, 0);
+        
+        // A held output is retried later, but the taps see it only once
+        long long forward_start = trace_start(context);
+        if (processed) {
+            observe_output(context, processed, &meta);
+        }
+        int held = processed && try_forward(context, processed, &meta);
+        trace_event(context, TRACE_FORWARD, forward_start, &meta, 0);
+        if (held) {
+            // Keep the output until the next plugin has room for it
+            context->held_output = (char*)processed;
+            context->held_meta = meta;
+            context->held_end = 0;
+            if (processed != item) {
+                free(item);
+            }
+            return PLUGIN_SLICE_BLOCKED;
+        }
+        
+        if (processed && processed != item) {
+            free((void*)processed);
+        }
+        
+        free(item);
+    }
+    
+    return consumer_producer_count(context->queue) > 0 ? PLUGIN_SLICE_MORE : PLUGIN_SLICE_IDLE;
+}
+
 // void log_error(plugin_context_t* context, const char* message) {
 //     fprintf(stderr, "[ERROR][%s] - %s\n", context->name, message);
 // }
@@ -62,8 +477,21 @@ const char* common_plugin_init(const char* (*process_function)(const char*), con
     plugin_context.name = name;
     plugin_context.process_function = process_function;
     plugin_context.next_place_work = NULL;
+    plugin_context.next_try_place_work = NULL;
+    plugin_context.next_place_work_meta = NULL;
+    plugin_context.held_output = NULL;
+    plugin_context.held_end = 0;
+    plugin_context.fini_function = NULL;
+    plugin_context.has_thread = 0;
     plugin_context.finished = 0;
     
+    // Inline plugins run on the caller's thread and need neither a queue nor a thread
+    if (plugin_context.inline_mode) {
+        plugin_context.queue = NULL;
+        plugin_context.initialized = 1;
+        return NULL;
+    }
+    
     plugin_context.queue = (consumer_producer_t*)malloc(sizeof(consumer_producer_t)); 
     if (!plugin_context.queue) {
         return "Failed to allocate memory for queue";
@@ -76,6 +504,58 @@ const char* common_plugin_init(const char* (*process_function)(const char*), con
         return queue_error;
     }
     
+    if (plugin_context.spill_dir) {
+        queue_error = consumer_producer_set_budget(plugin_context.queue, plugin_context.byte_budget,
+                                                   plugin_context.pipeline_budget, plugin_context.spill_dir);
+        if (queue_error) {
+            consumer_producer_destroy(plugin_context.queue);
+            free(plugin_context.queue);
+            plugin_context.queue = NULL;
+            return queue_error;
+        }
+    }
+    
+    if (plugin_context.lane_weights) {
+        queue_error = consumer_producer_set_lanes(plugin_context.queue, plugin_context.lane_weights);
+        if (queue_error) {
+            consumer_producer_destroy(plugin_context.queue);
+            free(plugin_context.queue);
+            plugin_context.queue = NULL;
+            return queue_error;
+        }
+    }
+    
+    if (plugin_context.overload) {
+        queue_error = consumer_producer_set_overload(plugin_context.queue, plugin_context.overload);
+        if (queue_error) {
+            consumer_producer_destroy(plugin_context.queue);
+            free(plugin_context.queue);
+            plugin_context.queue = NULL;
+            return queue_error;
+        }
+    }
+    
+    // An external executor drains the queue, so no consumer thread is needed
+    if (plugin_context.ready_callback) {
+        plugin_context.initialized = 1;
+        return NULL;
+    }
+    
+    // Stateless plugins may run on several consumer threads, started with one
+    if (plugin_context.max_workers > 0) {
+        queue_error = init_workers(&plugin_context);
+        if (queue_error) {
+            consumer_producer_destroy(plugin_context.queue);
+            free(plugin_context.queue);
+            plugin_context.queue = NULL;
+            return queue_error;
+        }
+        
+        plugin_context.has_thread = 1;
+        plugin_context.initialized = 1;
+        return NULL;
+    }
+    
     if (pthread_create(&plugin_context.consumer_thread, NULL, plugin_consumer_thread, &plugin_context) != 0) {
         consumer_producer_destroy(plugin_context.queue);
         free(plugin_context.queue);
@@ -83,18 +563,78 @@ const char* common_plugin_init(const char* (*process_function)(const char*), con
         return "Failed to create consumer thread";
     }
     
+    plugin_context.has_thread = 1;
     plugin_context.initialized = 1;
     return NULL;
 }
 
+void common_plugin_set_fini(void (*fini)(void)) {
+    if (plugin_context.initialized) {
+        plugin_context.fini_function = fini;
+    }
+}
+
+// Print the memory and spill figures of a budgeted queue
+static void report_queue(plugin_context_t* context) {
+    consumer_producer_t* queue = context->queue;
+    spill_t* spill = queue->spill;
+    
+    fprintf(stderr, "[STATS][%s] - queue peak %zu bytes in memory, spilled %lu items (%zu bytes) in %d segments, "
+            "peak %zu bytes on disk, read-back avg %.1f us max %.1f us\n",
+            context->name, queue->peak_bytes, spill->items, spill->bytes, spill->segments, spill->peak_bytes,
+            spill->items > 0 ? spill->read_ns_total / spill->items / 1000.0 : 0.0, spill->read_ns_max / 1000.0);
+}
+
 const char* plugin_fini(void) {
     if (!plugin_context.initialized) {
         return "Plugin not initialized";
     }
     
-    pthread_join(plugin_context.consumer_thread, NULL);
+    if (plugin_context.has_thread && plugin_context.max_workers > 0) {
+        join_workers(&plugin_context);
+        destroy_workers(&plugin_context);
+        plugin_context.has_thread = 0;
+    }
+    
+    if (plugin_context.has_thread) {
+        pthread_join(plugin_context.consumer_thread, NULL);
+        plugin_context.has_thread = 0;
+        
+        if (plugin_context.perf_enabled) {
+            perf_counters_report(&plugin_context.perf, plugin_context.name);
+            perf_counters_close(&plugin_context.perf);
+        }
+    }
+    
+    // Every item has been processed, the plugin can report and release its own state
+    if (plugin_context.fini_function) {
+        plugin_context.fini_function();
+        plugin_context.fini_function = NULL;
+    }
+    
+    free(plugin_context.held_output);
+    plugin_context.held_output = NULL;
+    plugin_context.ready_callback = NULL;
+    plugin_context.ready_arg = NULL;
+    plugin_context.inline_mode = 0;
+    plugin_context.process_override = NULL;
+    plugin_context.process_override_arg = NULL;
+    plugin_context.byte_budget = 0;
+    plugin_context.pipeline_budget = NULL;
+    plugin_context.spill_dir = NULL;
+    plugin_context.lane_weights = NULL;
+    plugin_context.overload = NULL;
+    plugin_context.num_input_taps = 0;
+    plugin_context.num_output_taps = 0;
+    plugin_context.perf_enabled = 0;
+    plugin_context.trace = NULL;
+    plugin_context.trace_items = 0;
+    plugin_context.max_workers = 0;
     
     if (plugin_context.queue) {
+        if (plugin_context.queue->spill) {
+            report_queue(&plugin_context);
+        }
         consumer_producer_destroy(plugin_context.queue);
         free(plugin_context.queue);
         plugin_context.queue = NULL;
@@ -105,11 +645,63 @@ const char* plugin_fini(void) {
 }
 
 const char* plugin_place_work(const char* str) {
+    return plugin_place_work_meta(str, NULL);
+}
+
+const char* plugin_place_work_meta(const char* str, const work_meta_t* meta) {
     if (!plugin_context.initialized || !str) {
         return "Plugin not initialized or invalid string";
     }
     
-    return consumer_producer_put(plugin_context.queue, str);
+    if (plugin_context.inline_mode) {
+        observe_input(&plugin_context, str, meta);
+        return process_inline(&plugin_context, str, meta);
+    }
+    
+    // Before the put, so the taps log an item before anything the plugin makes of it - unless the
+    // overload policy may drop it, the taps only see items that were queued
+    const overload_policy_t* policy = &plugin_context.queue->overload;
+    int may_drop = policy->kind != OVERLOAD_BLOCK || policy->timeout_ns > 0;
+    if (!may_drop) {
+        observe_input(&plugin_context, str, meta);
+    }
+    
+    const char* error = NULL;
+    int dropped = consumer_producer_put_checked(plugin_context.queue, str, meta, &error);
+    if (dropped == 0 && may_drop) {
+        observe_input(&plugin_context, str, meta);
+    }
+    if (!error && plugin_context.ready_callback) {
+        plugin_context.ready_callback(plugin_context.ready_arg);
+    }
+    
+    return error;
+}
+
+int plugin_try_place_work(const char* str, const work_meta_t* meta) {
+    if (!plugin_context.initialized || !str) {
+        return -1;
+    }
+    
+    if (plugin_context.inline_mode) {
+        observe_input(&plugin_context, str, meta);
+        return process_inline(&plugin_context, str, meta) ? -1 : 0;
+    }
+    
+    // A full queue makes the caller retry, so the taps only see the item once it is queued - an
+    // item the overload policy dropped is done with, but never seen
+    int result = consumer_producer_try_put(plugin_context.queue, str, meta);
+    if (result == 2) {
+        return 0;
+    }
+    if (result == 0) {
+        observe_input(&plugin_context, str, meta);
+    }
+    if (result == 0 && plugin_context.ready_callback) {
+        plugin_context.ready_callback(plugin_context.ready_arg);
+    }
+    
+    return result;
 }
 
 void plugin_attach(const char* (*next_place_work)(const char*)) {
@@ -118,11 +710,161 @@ void plugin_attach(const char* (*next_place_work)(const char*)) {
     }
 }
 
+void plugin_attach_meta(const char* (*next_place_work_meta)(const char*, const work_meta_t*)) {
+    if (plugin_context.initialized) {
+        plugin_context.next_place_work_meta = next_place_work_meta;
+    }
+}
+
+void plugin_attach_try(int (*next_try_place_work)(const char*, const work_meta_t*)) {
+    if (plugin_context.initialized) {
+        plugin_context.next_try_place_work = next_try_place_work;
+    }
+}
+
+void plugin_set_room_callback(void (*room)(void*), void* room_arg) {
+    if (plugin_context.initialized && plugin_context.queue) {
+        consumer_producer_set_room_callback(plugin_context.queue, room, room_arg);
+    }
+}
+
+void plugin_set_ready_callback(void (*ready)(void*), void* ready_arg) {
+    if (!plugin_context.initialized) {
+        plugin_context.ready_callback = ready;
+        plugin_context.ready_arg = ready_arg;
+    }
+}
+
+void plugin_set_inline(void) {
+    if (!plugin_context.initialized) {
+        plugin_context.inline_mode = 1;
+    }
+}
+
+void plugin_set_byte_budget(size_t byte_budget, byte_budget_t* pipeline_budget, const char* spill_dir) {
+    if (!plugin_context.initialized) {
+        plugin_context.byte_budget = byte_budget;
+        plugin_context.pipeline_budget = pipeline_budget;
+        plugin_context.spill_dir = spill_dir;
+    }
+}
+
+void plugin_set_lane_weights(const int* weights) {
+    if (!plugin_context.initialized) {
+        plugin_context.lane_weights = weights;
+    }
+}
+
+void plugin_set_overload(const overload_policy_t* policy) {
+    if (!plugin_context.initialized) {
+        plugin_context.overload = policy;
+    }
+}
+
+unsigned long plugin_dropped(void) {
+    if (!plugin_context.initialized) {
+        return 0;
+    }
+    
+    return consumer_producer_dropped(plugin_context.queue);
+}
+
+int plugin_add_tap(void (*observe)(const char*, const work_meta_t*), int input) {
+    int* count = input ? &plugin_context.num_input_taps : &plugin_context.num_output_taps;
+    if (plugin_context.initialized || !observe || *count == PLUGIN_MAX_TAPS) {
+        return 0;
+    }
+    
+    if (input) {
+        plugin_context.input_taps[(*count)++] = observe;
+    } else {
+        plugin_context.output_taps[(*count)++] = observe;
+    }
+    return 1;
+}
+
+void plugin_set_perf_counters(void) {
+    if (!plugin_context.initialized) {
+        plugin_context.perf_enabled = 1;
+    }
+}
+
+void plugin_set_trace(trace_t* trace, int stage) {
+    if (!plugin_context.initialized) {
+        plugin_context.trace = trace;
+        plugin_context.trace_stage = stage;
+        plugin_context.trace_items = 0;
+    }
+}
+
+void plugin_set_process_override(const char* (*process)(void*, const char*), void* process_arg) {
+    if (!plugin_context.initialized) {
+        plugin_context.process_override = process;
+        plugin_context.process_override_arg = process_arg;
+    }
+}
+
+void plugin_set_max_workers(int max_workers) {
+    if (!plugin_context.initialized) {
+        plugin_context.max_workers = max_workers < PLUGIN_MAX_WORKERS ? max_workers : PLUGIN_MAX_WORKERS;
+    }
+}
+
+int plugin_scale_workers(int workers) {
+    if (!plugin_context.initialized || plugin_context.max_workers == 0) {
+        return 0;
+    }
+    
+    if (workers < 1) {
+        workers = 1;
+    } else if (workers > plugin_context.max_workers) {
+        workers = plugin_context.max_workers;
+    }
+    
+    pthread_mutex_lock(&plugin_context.scale_mutex);
+    if (!plugin_context.scaling_closed) {
+        // The worker waiting on an empty queue is woken to retire, instead of when the next item comes
+        if (workers < plugin_context.target_workers) {
+            consumer_producer_wake(plugin_context.queue);
+        }
+        plugin_context.target_workers = workers;
+        const char* error = start_workers(&plugin_context);
+        if (error) {
+            fprintf(stderr, "[ERROR][%s] - %s\n", plugin_context.name, error);
+            plugin_context.target_workers = plugin_context.live_workers;
+        }
+    }
+    int target = plugin_context.target_workers;
+    pthread_mutex_unlock(&plugin_context.scale_mutex);
+    return target;
+}
+
+unsigned long long plugin_blocked_ns(void) {
+    if (!plugin_context.initialized) {
+        return 0;
+    }
+    
+    return consumer_producer_blocked_ns(plugin_context.queue);
+}
+
+int plugin_pending(void) {
+    if (!plugin_context.initialized) {
+        return 0;
+    }
+    
+    return consumer_producer_count(plugin_context.queue);
+}
+
 const char* plugin_wait_finished(void) {
     if (!plugin_context.initialized) {
         return "Plugin not initialized";
     }
     
+    // Inline plugins are done as soon as the caller's place_work returned
+    if (plugin_context.inline_mode) {
+        return NULL;
+    }
+    
     if (consumer_producer_wait_finished(plugin_context.queue) != 0) {
         return "Failed to wait for finished signal";
     }
@@ -2,12 +2,28 @@
 #define PLUGIN_COMMON_H
 
 #include <pthread.h>
+#include "plugin_sdk.h"
 #include "sync/consumer_producer.h"
+#include "perf_counters.h"
 
 /** 
  * Common SDK structures and functions for plugin implementation 
  */
 
+// Most consumer threads a stateless plugin can be scaled to
+#define PLUGIN_MAX_WORKERS 16
+
+// Most taps attached in front of or behind a plugin
+#define PLUGIN_MAX_TAPS 8
+
+// Elastic consumer thread of a stateless plugin
+typedef struct
+{
+    pthread_t thread;                                    // Worker thread
+    int started;                                         // thread was created and not joined yet
+    int exited;                                          // thread has returned (or is about to)
+} plugin_worker_t;
+
 // Plugin context structure 
 typedef struct
 {
@@ -16,6 +32,44 @@ typedef struct
     pthread_t consumer_thread;                           // Consumer thread
     const char* (*next_place_work)(const char*);        // Next plugin's place_work function
     const char* (*process_function)(const char*);       // Plugin-specific processing function
+    const char* (*process_override)(void*, const char*); // Host kernel that replaces process_function (fused mode)
+    void* process_override_arg;                          // Argument passed to process_override
+    const char* (*next_place_work_meta)(const char*, const work_meta_t*); // Next plugin's place_work with metadata
+    int (*next_try_place_work)(const char*, const work_meta_t*); // Next plugin's non-blocking place_work (pooled mode)
+    void (*ready_callback)(void*);                       // Executor hook, set when the host drives the plugin
+    void* ready_arg;                                     // Argument passed to ready_callback
+    char* held_output;                                   // Output the next plugin could not accept yet (pooled mode)
+    work_meta_t held_meta;                               // Metadata of held_output
+    int held_end;                                        // held_output is the <END> marker
+    int has_thread;                                      // consumer_thread was created
+    int inline_mode;                                     // Process on the caller's thread, no queue or thread
+    size_t byte_budget;                                  // Bytes the queue may hold in memory (0 = unlimited)
+    byte_budget_t* pipeline_budget;                      // Budget shared with the other plugins' queues
+    const char* spill_dir;                               // Spill directory, set when a budget is used
+    const int* lane_weights;                             // Round-robin weights of the priority lanes (NULL = strict)
+    const overload_policy_t* overload;                   // What producers do when the queue is full (NULL = block)
+    void (*input_taps[PLUGIN_MAX_TAPS])(const char*, const work_meta_t*);  // Taps that see every item placed
+    int num_input_taps;                                  // Number of input taps
+    void (*output_taps[PLUGIN_MAX_TAPS])(const char*, const work_meta_t*); // Taps that see every output
+    int num_output_taps;                                 // Number of output taps
+    int perf_enabled;                                    // Count cycles, misses, ... of the consumer thread
+    perf_counters_t perf;                                // Counters, split into processing and queue waits
+    trace_t* trace;                                      // Timeline the plugin records into (NULL = off)
+    int trace_stage;                                     // Stage id in the timeline
+    unsigned long trace_items;                           // Items seen, for sampling
+    int trace_sampled;                                   // The current item's events are recorded
+    void (*fini_function)(void);                         // Plugin-specific teardown, run by plugin_fini (NULL = none)
+    int max_workers;                                     // Elastic consumer threads allowed (0 = one consumer thread)
+    plugin_worker_t workers[PLUGIN_MAX_WORKERS];         // Elastic consumer threads
+    int target_workers;                                  // Consumer threads the host asked for
+    int live_workers;                                    // Consumer threads running
+    int scaling_closed;                                  // The final <END> was forwarded, no more threads start
+    pthread_mutex_t scale_mutex;                         // Protects the worker fields above
+    pthread_mutex_t take_mutex;                          // Makes taking an item and numbering it one step
+    pthread_mutex_t turn_mutex;                          // Protects next_forward
+    pthread_cond_t turn_cond;                            // Signalled when next_forward advances
+    unsigned long next_take;                             // Sequence number of the next item taken
+    unsigned long next_forward;                          // Sequence number of the next item forwarded
     int initialized;                                     // Initialization flag
     int finished;                                        // Finished processing flag
 } plugin_context_t;
@@ -58,6 +112,13 @@ const char* plugin_get_name(void);
  */ 
 const char* common_plugin_init(const char* (*process_function)(const char*), const char* name, int queue_size);
 
+/** 
+ * Register plugin-specific teardown (e.g. printing statistics) - call after common_plugin_init 
+ * plugin_fini runs it once the consumer thread has been joined, so it sees every processed item 
+ * @param fini Teardown function 
+ */ 
+void common_plugin_set_fini(void (*fini)(void));
+
 /** 
  * Initialize the plugin with the specified queue size - calls common_plugin_init 
  * This function should be implemented by each plugin 
@@ -89,6 +150,23 @@ const char* plugin_place_work(const char* str);
 __attribute__((visibility("default")))  
 void plugin_attach(const char* (*next_place_work)(const char*));
 
+/** 
+ * Place work together with its metadata into the plugin's queue 
+ * @param str The string to process 
+ * @param meta Item metadata, passed on with the processed string (NULL for default metadata) 
+ * @return NULL on success, error message on failure 
+ */ 
+__attribute__((visibility("default")))  
+const char* plugin_place_work_meta(const char* str, const work_meta_t* meta);
+
+/** 
+ * Attach this plugin to the next plugin in the chain, keeping item metadata 
+ * Takes precedence over plugin_attach 
+ * @param next_place_work_meta Function pointer to the next plugin's place_work_meta function 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_attach_meta(const char* (*next_place_work_meta)(const char*, const work_meta_t*));
+
 /** 
  * Wait until the plugin has finished processing all work and is ready to shutdown 
  * This is a blocking function used for graceful shutdown coordination
@@ -97,4 +175,202 @@ void plugin_attach(const char* (*next_place_work)(const char*));
 __attribute__((visibility("default")))  
 const char* plugin_wait_finished(void);
 
+/** 
+ * Hand the plugin over to an external executor - must be called before plugin_init 
+ * No consumer thread is created; the executor drains the queue with plugin_run_slice 
+ * @param ready Called (with ready_arg) every time work is placed into the queue 
+ * @param ready_arg Opaque executor argument 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_ready_callback(void (*ready)(void*), void* ready_arg);
+
+/** 
+ * Process up to max_items queued items on the calling thread without blocking 
+ * Must not be called concurrently for the same plugin 
+ * @param max_items Maximum number of items to process 
+ * @return One of the PLUGIN_SLICE_* status codes 
+ */ 
+__attribute__((visibility("default")))  
+int plugin_run_slice(int max_items);
+
+/** 
+ * Place work into the plugin's queue without blocking 
+ * @param str The string to process 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @return 0 once the item is queued (or dropped by the overload policy), 1 if the queue is full, 
+ *         -1 on failure 
+ */ 
+__attribute__((visibility("default")))  
+int plugin_try_place_work(const char* str, const work_meta_t* meta);
+
+/** 
+ * Attach the non-blocking place_work of the next plugin (used by plugin_run_slice) 
+ * @param next_try_place_work Function pointer to the next plugin's try_place_work function 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_attach_try(int (*next_try_place_work)(const char*, const work_meta_t*));
+
+/** 
+ * Tell a caller of plugin_try_place_work when to retry - after it found the queue full, room is 
+ * called once an item leaves the queue or the queue finishes. Call after plugin_init. 
+ * Runs on a plugin or executor thread, so it should only wake the caller 
+ * @param room Callback (NULL = none) 
+ * @param room_arg Argument passed to room 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_room_callback(void (*room)(void*), void* room_arg);
+
+/** 
+ * Get the number of items waiting in the plugin's queue 
+ * @return Number of queued items 
+ */ 
+__attribute__((visibility("default")))  
+int plugin_pending(void);
+
+/** 
+ * Run the plugin inline - must be called before plugin_init 
+ * No queue and no thread are created; plugin_place_work processes the string on the 
+ * caller's thread and passes the result straight to the next plugin's place_work 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_inline(void);
+
+/** 
+ * Limit the bytes held by the plugin's queue - must be called before plugin_init 
+ * Items beyond a budget are spilled to segment files in spill_dir and read back in order, 
+ * so producers are not blocked by bursts. Spill statistics are printed by plugin_fini 
+ * @param byte_budget Bytes the queue may hold in memory (0 = unlimited) 
+ * @param pipeline_budget Budget shared by all queues of the pipeline (NULL = none) 
+ * @param spill_dir Writable directory for spill segment files 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_byte_budget(size_t byte_budget, byte_budget_t* pipeline_budget, const char* spill_dir);
+
+/** 
+ * Take items from the queue's priority lanes by weighted round-robin instead of strict 
+ * priority - must be called before plugin_init 
+ * @param weights Items each lane takes per round, one per WORK_PRIORITY_* class, most urgent first 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_lane_weights(const int* weights);
+
+/** 
+ * Choose what producers do when the plugin's queue is full - must be called before plugin_init 
+ * Shedding policies drop items instead of blocking the producer, so an overloaded plugin no 
+ * longer stalls the reader and the plugins before it. The <END> marker is never dropped 
+ * @param policy Overload policy, must outlive the plugin (NULL = block, the default) 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_overload(const overload_policy_t* policy);
+
+/** 
+ * Get the number of items the overload policy dropped 
+ * @return Items dropped since plugin_init 
+ */ 
+__attribute__((visibility("default")))  
+unsigned long plugin_dropped(void);
+
+/** 
+ * Count hardware and software events of the consumer thread - must be called before plugin_init 
+ * The counts are split between processing items and waiting on the queues, and printed by 
+ * plugin_fini. Only the threaded mode has a consumer thread to count 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_perf_counters(void);
+
+/** 
+ * Record the plugin's waits, processing and forwarding into a timeline - must be called before plugin_init 
+ * Every thread that runs the plugin records into its own ring buffer of the trace, without locking 
+ * @param trace Timeline owned by the host 
+ * @param stage Stage id of this plugin in the timeline 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_trace(trace_t* trace, int stage);
+
+/** 
+ * Run the plugin on elastic consumer threads - must be called before plugin_init 
+ * The plugin starts with one thread and plugin_scale_workers adds or retires threads at run 
+ * time. Items are numbered as they are taken from the queue, processed in parallel and 
+ * forwarded in the order they were taken, so only stateless plugins may be scaled 
+ * @param max_workers Most consumer threads (up to PLUGIN_MAX_WORKERS) 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_max_workers(int max_workers);
+
+/** 
+ * Change the number of consumer threads of an elastic plugin 
+ * New threads start right away, surplus threads retire before they take their next item 
+ * @param workers Consumer threads wanted (clamped to 1..max_workers) 
+ * @return Consumer threads wanted from now on, 0 if the plugin is not elastic 
+ */ 
+__attribute__((visibility("default")))  
+int plugin_scale_workers(int workers);
+
+/** 
+ * Get the time producers spent blocked on the plugin's full queue 
+ * @return Nanoseconds blocked since plugin_init 
+ */ 
+__attribute__((visibility("default")))  
+unsigned long long plugin_blocked_ns(void);
+
+/** 
+ * Let a tap look at the plugin's items - must be called before plugin_init 
+ * An input tap sees every item placed into the plugin, on the placing thread, before the plugin 
+ * gets it (a non-blocking place shows it only once it is accepted). An output tap sees every output on the thread that produced it, before 
+ * it is passed on. Either way the tap gets the plugin's own string and must not keep it; the 
+ * <END> marker is not shown to taps 
+ * @param observe Tap, e.g. another plugin's plugin_observe 
+ * @param input 1 to see the items placed into the plugin, 0 to see its outputs 
+ * @return 1 if the tap was attached, 0 if the plugin is initialized or has PLUGIN_MAX_TAPS taps 
+ */ 
+__attribute__((visibility("default")))  
+int plugin_add_tap(void (*observe)(const char*, const work_meta_t*), int input);
+
+/** 
+ * Look at an item without taking part in the chain 
+ * Only implemented by tap plugins (logger) - the host looks it up with dlsym, takes the plugin 
+ * out of the chain and attaches this function to a neighbouring plugin with plugin_add_tap 
+ * @param str Item, read-only and only valid during the call 
+ * @param meta Item metadata (may be NULL) 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_observe(const char* str, const work_meta_t* meta);
+
+/** 
+ * Describe the plugin's transform as a fusable primitive 
+ * Only implemented by pure plugins - the host looks it up with dlsym and treats a missing 
+ * export as an opaque stage 
+ * @return The plugin's descriptor (should not be modified or freed) 
+ */ 
+__attribute__((visibility("default")))  
+const plugin_descriptor_t* plugin_get_descriptor(void);
+
+/** 
+ * Load the literal patterns of the filter plugin - must be called before plugin_init 
+ * Only implemented by the filter plugin - the host looks it up with dlsym 
+ * @param path Pattern file, one literal pattern per line 
+ * @param drop 1 to drop lines that contain a pattern, 0 to keep only those lines 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_patterns(const char* path, int drop);
+
+/** 
+ * Treat lines as UTF-8 text - must be called before plugin_init 
+ * Lines with characters beyond ASCII are transformed by code point (and lines that are not 
+ * valid UTF-8 byte by byte, as without UTF-8 mode); the plugin then exports no descriptor. 
+ * Only implemented by the text plugins (uppercaser, rotator, flipper) - the host looks it up with dlsym 
+ * @param enabled 1 for UTF-8 mode, 0 for bytes 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_utf8(int enabled);
+
+/** 
+ * Replace the plugin's transform - must be called before plugin_init 
+ * The queue, thread and forwarding stay the same; only the processing of each item changes 
+ * @param process Called with process_arg instead of the plugin's transform, returns a newly allocated string 
+ * @param process_arg Opaque argument passed to process 
+ */ 
+__attribute__((visibility("default")))  
+void plugin_set_process_override(const char* (*process)(void*, const char*), void* process_arg);
+
 #endif
\ No newline at end of file
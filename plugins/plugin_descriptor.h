@@ -0,0 +1,28 @@
+#ifndef PLUGIN_DESCRIPTOR_H
+#define PLUGIN_DESCRIPTOR_H
+
+/** 
+ * Self-description of a pure transform, exported through plugin_get_descriptor 
+ * A plugin that can be written as one of these primitives may be fused by the host with its 
+ * neighbours into a single pass over the line. Plugins with side effects (or anything else 
+ * that does not fit) simply do not export a descriptor and keep running as normal stages. 
+ */
+
+typedef enum
+{
+    TRANSFORM_OPAQUE = 0,            /* Not describable - never fused */
+    TRANSFORM_MAP,                   /* out[i] = map[in[i]], same length */
+    TRANSFORM_PERMUTE,               /* out[i] = in[source_index(i, n)], same length */
+    TRANSFORM_EXPAND                 /* out has output_length(n) bytes, each in[source_index(i, n)] or fill */
+} transform_kind_t;
+
+typedef struct
+{
+    transform_kind_t kind;                       /* Primitive implemented by the plugin */
+    const unsigned char* map;                    /* TRANSFORM_MAP: 256-entry byte table (must not map to 0) */
+    int (*output_length)(int length);            /* TRANSFORM_EXPAND: output length for an input of length bytes */
+    int (*source_index)(int index, int length);  /* PERMUTE/EXPAND: input index of output byte index, -1 for fill */
+    unsigned char fill;                          /* TRANSFORM_EXPAND: byte written where source_index is -1 */
+} plugin_descriptor_t;
+
+#endif
@@ -2,6 +2,19 @@
 #ifndef PLUGIN_SDK_H
 #define PLUGIN_SDK_H
 
+#include <stddef.h>
+#include "sync/work_meta.h"
+#include "sync/byte_budget.h"
+#include "sync/overload.h"
+#include "sync/trace.h"
+#include "plugin_descriptor.h"
+
+/* Return codes of plugin_run_slice */
+#define PLUGIN_SLICE_IDLE     0    /* Queue drained, nothing left to do */
+#define PLUGIN_SLICE_MORE     1    /* Slice budget used up, more items are queued */
+#define PLUGIN_SLICE_BLOCKED  2    /* Next plugin's queue is full, output is held back */
+#define PLUGIN_SLICE_DONE     3    /* <END> was forwarded, plugin has finished */
+
 /** 
  * Get the plugin's name 
  * @return The plugin's name (should not be modified or freed) 
@@ -34,6 +47,20 @@ const char* plugin_fini(void);
  */ 
 void plugin_attach(const char* (*next_place_work)(const char*));
 
+/** 
+ * Place work together with its metadata into the plugin's queue 
+ * @param str The string to process 
+ * @param meta Item metadata, passed on with the processed string (NULL for default metadata) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* plugin_place_work_meta(const char* str, const work_meta_t* meta);
+
+/** 
+ * Attach this plugin to the next plugin in the chain, keeping item metadata 
+ * @param next_place_work_meta Function pointer to the next plugin's place_work_meta function 
+ */ 
+void plugin_attach_meta(const char* (*next_place_work_meta)(const char*, const work_meta_t*));
+
 /** 
  * Wait until the plugin has finished processing all work and is ready to shutdown 
  * This is a blocking function used for graceful shutdown coordination 
@@ -41,4 +68,148 @@ void plugin_attach(const char* (*next_place_work)(const char*));
  */ 
 const char* plugin_wait_finished(void);
 
+/** 
+ * Hand the plugin over to an external executor - must be called before plugin_init 
+ * @param ready Called (with ready_arg) every time work is placed into the queue 
+ * @param ready_arg Opaque executor argument 
+ */ 
+void plugin_set_ready_callback(void (*ready)(void*), void* ready_arg);
+
+/** 
+ * Process up to max_items queued items on the calling thread without blocking 
+ * @param max_items Maximum number of items to process 
+ * @return One of the PLUGIN_SLICE_* status codes 
+ */ 
+int plugin_run_slice(int max_items);
+
+/** 
+ * Place work into the plugin's queue without blocking 
+ * @param str The string to process 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @return 0 on success, 1 if the queue is full, -1 on failure 
+ */ 
+int plugin_try_place_work(const char* str, const work_meta_t* meta);
+
+/** 
+ * Attach the non-blocking place_work of the next plugin 
+ * @param next_try_place_work Function pointer to the next plugin's try_place_work function 
+ */ 
+void plugin_attach_try(int (*next_try_place_work)(const char*, const work_meta_t*));
+
+/** 
+ * Tell a caller of plugin_try_place_work when to retry - must be called after plugin_init 
+ * @param room Called (with room_arg) once a full queue has room again or finishes 
+ * @param room_arg Opaque caller argument 
+ */ 
+void plugin_set_room_callback(void (*room)(void*), void* room_arg);
+
+/** 
+ * Get the number of items waiting in the plugin's queue 
+ * @return Number of queued items 
+ */ 
+int plugin_pending(void);
+
+/** 
+ * Run the plugin inline on the caller's thread (no queue, no thread) - must be called before plugin_init 
+ */ 
+void plugin_set_inline(void);
+
+/** 
+ * Limit the bytes held by the plugin's queue, spilling the overflow to disk - must be called before plugin_init 
+ * @param byte_budget Bytes the queue may hold in memory (0 = unlimited) 
+ * @param pipeline_budget Budget shared by all queues of the pipeline (NULL = none) 
+ * @param spill_dir Writable directory for spill segment files 
+ */ 
+void plugin_set_byte_budget(size_t byte_budget, byte_budget_t* pipeline_budget, const char* spill_dir);
+
+/** 
+ * Take items from the priority lanes by weighted round-robin instead of strict priority - must be called before plugin_init 
+ * @param weights Items each lane takes per round, one per WORK_PRIORITY_* class, most urgent first 
+ */ 
+void plugin_set_lane_weights(const int* weights);
+
+/** 
+ * Choose what producers do when the plugin's queue is full - must be called before plugin_init 
+ * @param policy Overload policy, must outlive the plugin (NULL = block, the default) 
+ */ 
+void plugin_set_overload(const overload_policy_t* policy);
+
+/** 
+ * Get the number of items the overload policy dropped 
+ * @return Items dropped since plugin_init 
+ */ 
+unsigned long plugin_dropped(void);
+
+/** 
+ * Count cycles, instructions, cache and branch misses and context switches of the consumer thread - must be called before plugin_init 
+ */ 
+void plugin_set_perf_counters(void);
+
+/** 
+ * Record the plugin's waits, processing and forwarding into a timeline - must be called before plugin_init 
+ * @param trace Timeline owned by the host 
+ * @param stage Stage id of this plugin in the timeline 
+ */ 
+void plugin_set_trace(trace_t* trace, int stage);
+
+/** 
+ * Let a tap look at the plugin's items or outputs - must be called before plugin_init 
+ * @param observe Tap, gets a read-only string that is only valid during the call 
+ * @param input 1 to see the items placed into the plugin, 0 to see its outputs 
+ * @return 1 if the tap was attached, 0 otherwise 
+ */ 
+int plugin_add_tap(void (*observe)(const char*, const work_meta_t*), int input);
+
+/** 
+ * Look at an item without taking part in the chain (optional export, tap plugins only) 
+ * @param str Item, read-only and only valid during the call 
+ * @param meta Item metadata (may be NULL) 
+ */ 
+void plugin_observe(const char* str, const work_meta_t* meta);
+
+/** 
+ * Describe the plugin's transform as a fusable primitive (optional export) 
+ * @return The plugin's descriptor (should not be modified or freed) 
+ */ 
+const plugin_descriptor_t* plugin_get_descriptor(void);
+
+/** 
+ * Run the plugin on elastic consumer threads that keep the item order - must be called before plugin_init 
+ * @param max_workers Most consumer threads 
+ */ 
+void plugin_set_max_workers(int max_workers);
+
+/** 
+ * Add or retire consumer threads of an elastic plugin at run time 
+ * @param workers Consumer threads wanted 
+ * @return Consumer threads wanted from now on, 0 if the plugin is not elastic 
+ */ 
+int plugin_scale_workers(int workers);
+
+/** 
+ * Get the time producers spent blocked on the plugin's full queue 
+ * @return Nanoseconds blocked since plugin_init 
+ */ 
+unsigned long long plugin_blocked_ns(void);
+
+/** 
+ * Set the pattern file of a filtering plugin (optional export) - must be called before plugin_init 
+ * @param path Pattern file, one literal pattern per line 
+ * @param drop 1 to drop lines that contain a pattern, 0 to keep only those lines 
+ */ 
+void plugin_set_patterns(const char* path, int drop);
+
+/** 
+ * Transform characters instead of bytes of UTF-8 lines (optional export) - must be called before plugin_init 
+ * @param enabled 1 for UTF-8 mode, 0 for bytes 
+ */ 
+void plugin_set_utf8(int enabled);
+
+/** 
+ * Replace the plugin's own transform, e.g. by a kernel fused from several plugins - must be called before plugin_init 
+ * @param process Called with process_arg instead of the plugin's transform, returns a newly allocated string 
+ * @param process_arg Opaque argument passed to process 
+ */ 
+void plugin_set_process_override(const char* (*process)(void*, const char*), void* process_arg);
+
 #endif
\ No newline at end of file
@@ -1,8 +1,14 @@
 #include "plugin_common.h"
+#include "utf8.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+// Transform code points instead of bytes, set by plugin_set_utf8
+static int utf8_mode = 0;
+
+static int rotate_source(int index, int length);
+
 const char* plugin_transform(const char* input) {
     if (!input) {
         return NULL;
@@ -10,6 +16,14 @@ const char* plugin_transform(const char* input) {
     
     int length_of_input = strlen(input);
     
+    // Move the last character to the front, not the bytes, when the line has more than ASCII in UTF-8 mode
+    if (utf8_mode && !utf8_is_ascii(input, length_of_input)) {
+        char* moved = utf8_transform(input, length_of_input, rotate_source, NULL);
+        if (moved) {
+            return moved;
+        }
+    }
+    
     if (length_of_input == 0) {
         return strdup(input);
     }
@@ -31,6 +45,25 @@ const char* plugin_transform(const char* input) {
     return result_of_transform;
 }
 
+// The first output byte (or character, in UTF-8 mode) is the last input one, everything else moves one to the right
+static int rotate_source(int index, int length) {
+    return index == 0 ? length - 1 : index - 1;
+}
+
+static const plugin_descriptor_t descriptor = { TRANSFORM_PERMUTE, NULL, NULL, rotate_source, 0 };
+
+// Byte positions only match character positions without UTF-8 mode
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    return utf8_mode ? NULL : &descriptor;
+}
+
+void plugin_set_utf8(int enabled) {
+    utf8_mode = enabled;
+    if (enabled) {
+        utf8_init();
+    }
+}
+
 const char* plugin_init(int queue_size) {
     return common_plugin_init(plugin_transform, "rotator", queue_size);
 }
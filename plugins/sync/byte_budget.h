@@ -0,0 +1,16 @@
+#ifndef BYTE_BUDGET_H
+#define BYTE_BUDGET_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/** 
+ * Byte budget shared by every queue of a pipeline (owned by the host) 
+ */
+typedef struct
+{
+    atomic_size_t used;              /* Bytes currently held in memory by all queues */
+    size_t limit;                    /* Maximum bytes held in memory (0 = unlimited) */
+} byte_budget_t;
+
+#endif
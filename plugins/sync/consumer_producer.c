@@ -2,6 +2,277 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
+
+static long long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Number of items waiting on disk
+static int spilled(consumer_producer_t* queue) {
+    return queue->spill ? queue->spill->pending : 0;
+}
+
+// Account an item entering (size > 0) or leaving (size < 0) memory
+static void charge_bytes(consumer_producer_t* queue, long size) {
+    queue->bytes += size;
+    if (queue->bytes > queue->peak_bytes) {
+        queue->peak_bytes = queue->bytes;
+    }
+    
+    if (queue->pipeline_budget) {
+        atomic_fetch_add(&queue->pipeline_budget->used, size);
+    }
+}
+
+// An item goes to disk if it would exceed a budget or the ring is full - or if older items
+// are on disk already, so that items are still read back in order
+static int must_spill(consumer_producer_t* queue, size_t size) {
+    if (!queue->spill) {
+        return 0;
+    }
+    
+    if (spilled(queue) > 0 || queue->count >= queue->capacity) {
+        return 1;
+    }
+    
+    if (queue->byte_budget > 0 && queue->bytes + size > queue->byte_budget) {
+        return 1;
+    }
+    
+    byte_budget_t* pipeline = queue->pipeline_budget;
+    return pipeline && pipeline->limit > 0 && atomic_load(&pipeline->used) + size > pipeline->limit;
+}
+
+// Append an item to the spill store - caller holds queue->mutex
+static const char* spill_locked(consumer_producer_t* queue, const char* item, const work_meta_t* meta) {
+    if (spill_append(queue->spill, item, meta) != 0) {
+        return "Failed to spill item to disk";
+    }
+    
+    if (queue->count + spilled(queue) == 1) {
+        monitor_signal(&queue->not_empty_monitor);
+    }
+    return NULL;
+}
+
+// Lane of an item's priority class, unknown classes go to the nearest lane
+static int lane_of(const work_meta_t* meta) {
+    int lane = WORK_PRIORITY_LANE(meta ? meta->priority : WORK_PRIORITY_NORMAL);
+    if (lane < 0) {
+        return 0;
+    }
+    return lane < WORK_PRIORITY_CLASSES ? lane : WORK_PRIORITY_CLASSES - 1;
+}
+
+// Lane whose head item was put first (-1 if all lanes are empty)
+static int oldest_lane(consumer_producer_t* queue) {
+    int oldest = -1;
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        consumer_producer_lane_t* lane = &queue->lanes[i];
+        if (lane->count == 0) {
+            continue;
+        }
+        
+        consumer_producer_lane_t* best = oldest >= 0 ? &queue->lanes[oldest] : NULL;
+        if (!best || lane->sequences[lane->head] < best->sequences[best->head]) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+// Lane the next item is taken from - caller holds queue->mutex and has checked count > 0
+static int pick_lane(consumer_producer_t* queue) {
+    int weighted = queue->weights[0] > 0;
+    int lane = 0;
+    
+    if (weighted) {
+        // Every lane takes up to its weight in items, then the next non-empty lane has its turn
+        while (queue->lanes[queue->current_lane].count == 0 || queue->credit == 0) {
+            queue->current_lane = (queue->current_lane + 1) % WORK_PRIORITY_CLASSES;
+            queue->credit = queue->weights[queue->current_lane];
+        }
+        lane = queue->current_lane;
+    } else {
+        while (queue->lanes[lane].count == 0) {
+            lane++;
+        }
+    }
+    
+    // <END> must not overtake anything queued before it, so older items are drained first
+    consumer_producer_lane_t* chosen = &queue->lanes[lane];
+    if (strcmp(chosen->items[chosen->head], "<END>") == 0) {
+        return oldest_lane(queue);
+    }
+    
+    if (weighted) {
+        queue->credit--;
+    }
+    return lane;
+}
+
+// Append an item at the tail of its lane - caller holds queue->mutex and has checked for space
+static void push_locked(consumer_producer_t* queue, char* item, const work_meta_t* meta) {
+    static const work_meta_t default_meta = {0};
+    
+    consumer_producer_lane_t* lane = &queue->lanes[lane_of(meta)];
+    lane->items[lane->tail] = item;
+    lane->metas[lane->tail] = meta ? *meta : default_meta;
+    lane->sequences[lane->tail] = queue->next_sequence++;
+    lane->tail = (lane->tail + 1) % queue->capacity;
+    lane->count++;
+    queue->count++;
+    charge_bytes(queue, strlen(item) + 1);
+    
+    // If this was the first item, signal not_empty
+    if (queue->count + spilled(queue) == 1) {
+        monitor_signal(&queue->not_empty_monitor);
+    }
+    
+    // If queue is now full, reset not_full_monitor
+    if (queue->count == queue->capacity) {
+        monitor_reset(&queue->not_full_monitor);
+    }
+}
+
+// Tell a non-blocking producer that found the queue full to retry - caller holds queue->mutex
+static void room_locked(consumer_producer_t* queue) {
+    if (queue->room_wanted) {
+        queue->room_wanted = 0;
+        if (queue->room_callback) {
+            queue->room_callback(queue->room_arg);
+        }
+    }
+}
+
+// Remove the next item by priority - caller holds queue->mutex and has checked count > 0
+static char* pop_locked(consumer_producer_t* queue, work_meta_t* meta) {
+    consumer_producer_lane_t* lane = &queue->lanes[pick_lane(queue)];
+    char* item = lane->items[lane->head];
+    if (meta) {
+        *meta = lane->metas[lane->head];
+    }
+    lane->items[lane->head] = NULL;
+    lane->head = (lane->head + 1) % queue->capacity;
+    lane->count--;
+    queue->count--;
+    charge_bytes(queue, -(long)(strlen(item) + 1));
+    
+    // Queue is full
+    if (queue->count == queue->capacity - 1) {
+        monitor_signal(&queue->not_full_monitor);
+    }
+    room_locked(queue);
+    
+    // Queue is empty
+    if (queue->count + spilled(queue) == 0) {
+        monitor_reset(&queue->not_empty_monitor);
+    }
+    
+    return item;
+}
+
+// Finish the queue for good and wake everyone waiting on it - caller holds queue->mutex
+static void break_locked(consumer_producer_t* queue, const char* error) {
+    queue->error = error;
+    queue->finished = 1;
+    monitor_signal(&queue->not_full_monitor);
+    monitor_signal(&queue->not_empty_monitor);
+    room_locked(queue);
+}
+
+// Take the oldest item, from memory first and then from disk - caller holds queue->mutex.
+// An item that cannot be read back breaks the queue, since everything behind it would be lost too
+static char* take_locked(consumer_producer_t* queue, work_meta_t* meta) {
+    if (queue->count > 0) {
+        return pop_locked(queue, meta);
+    }
+    
+    char* item = spill_read(queue->spill, meta);
+    if (!item) {
+        break_locked(queue, "Failed to read a spilled item back from disk");
+        return NULL;
+    }
+    if (queue->count + spilled(queue) == 0) {
+        monitor_reset(&queue->not_empty_monitor);
+    }
+    return item;
+}
+
+// Add a copy of an item - caller holds queue->mutex and has checked for space
+static const char* push_copy_locked(consumer_producer_t* queue, const char* item, const work_meta_t* meta) {
+    char* item_copy = strdup(item);
+    if (!item_copy) {
+        return "Failed to allocate memory for item";
+    }
+    
+    push_locked(queue, item_copy, meta);
+    return NULL;
+}
+
+// Drop the oldest item of the least urgent lane whose head is not an <END> marker - caller
+// holds queue->mutex, returns 1 if an item was dropped
+static int evict_locked(consumer_producer_t* queue) {
+    for (int i = WORK_PRIORITY_CLASSES - 1; i >= 0; i--) {
+        consumer_producer_lane_t* lane = &queue->lanes[i];
+        if (lane->count == 0 || strcmp(lane->items[lane->head], "<END>") == 0) {
+            continue;
+        }
+        
+        char* item = lane->items[lane->head];
+        lane->items[lane->head] = NULL;
+        lane->head = (lane->head + 1) % queue->capacity;
+        lane->count--;
+        queue->count--;
+        charge_bytes(queue, -(long)(strlen(item) + 1));
+        free(item);
+        return 1;
+    }
+    return 0;
+}
+
+// Outcomes of an item placed into the full queue
+#define SHED_ROOM     0    /* Room was made, the item can be added */
+#define SHED_DROPPED  1    /* The item was dropped */
+#define SHED_WAIT     2    /* The item has to wait for room */
+
+// Apply the overload policy to an item placed into the full queue - caller holds queue->mutex
+static int shed_locked(consumer_producer_t* queue, const char* item) {
+    // <END> closes a stream, it is never dropped
+    if (queue->overload.kind == OVERLOAD_BLOCK || strcmp(item, "<END>") == 0) {
+        return SHED_WAIT;
+    }
+    
+    if (queue->overload.kind == OVERLOAD_DROP_OLDEST) {
+        if (!evict_locked(queue)) {
+            return SHED_WAIT;
+        }
+        queue->dropped++;
+        return SHED_ROOM;
+    }
+    
+    // Sampling lets the first of every sample_every items wait for room
+    if (queue->overload.kind == OVERLOAD_SAMPLE && queue->full_arrivals++ % queue->overload.sample_every == 0) {
+        return SHED_WAIT;
+    }
+    
+    queue->dropped++;
+    return SHED_DROPPED;
+}
+
+static void free_lanes(consumer_producer_t* queue) {
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        free(queue->lanes[i].items);
+        free(queue->lanes[i].metas);
+        free(queue->lanes[i].sequences);
+        queue->lanes[i].items = NULL;
+        queue->lanes[i].metas = NULL;
+        queue->lanes[i].sequences = NULL;
+    }
+}
 
 const char* consumer_producer_init(consumer_producer_t* queue, int capacity) {
     if (!queue) {
@@ -11,33 +282,56 @@ const char* consumer_producer_init(consumer_producer_t* queue, int capacity) {
         return "Queue capacity must be positive";
     }
     
-    queue->items = (char**)malloc(capacity * sizeof(char*));
-
-    if (!queue->items) {
-        return "Failed to allocate memory for queue items";
+    // Any lane may hold the whole capacity
+    memset(queue->lanes, 0, sizeof(queue->lanes));
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        consumer_producer_lane_t* lane = &queue->lanes[i];
+        lane->items = (char**)malloc(capacity * sizeof(char*));
+        lane->metas = (work_meta_t*)malloc(capacity * sizeof(work_meta_t));
+        lane->sequences = (unsigned long*)malloc(capacity * sizeof(unsigned long));
+        if (!lane->items || !lane->metas || !lane->sequences) {
+            free_lanes(queue);
+            return "Failed to allocate memory for queue items";
+        }
     }
     
     queue->capacity = capacity;
     queue->count = 0;
-    queue->head = 0;
-    queue->tail = 0;
+    queue->next_sequence = 0;
+    memset(queue->weights, 0, sizeof(queue->weights));
+    queue->current_lane = 0;
+    queue->credit = 0;
     queue->finished = 0;
+    queue->error = NULL;
+    queue->bytes = 0;
+    queue->peak_bytes = 0;
+    queue->byte_budget = 0;
+    queue->pipeline_budget = NULL;
+    queue->spill = NULL;
+    queue->blocked_ns = 0;
+    memset(&queue->overload, 0, sizeof(queue->overload));
+    queue->full_arrivals = 0;
+    queue->dropped = 0;
+    queue->wake_pending = 0;
+    queue->room_callback = NULL;
+    queue->room_arg = NULL;
+    queue->room_wanted = 0;
     
     if (monitor_init(&queue->not_full_monitor) != 0) {
-        free(queue->items);
+        free_lanes(queue);
         return "Failed to initialize not_full_monitor";
     }
     
     if (monitor_init(&queue->not_empty_monitor) != 0) {
         monitor_destroy(&queue->not_full_monitor);
-        free(queue->items);
+        free_lanes(queue);
         return "Failed to initialize not_empty_monitor";
     }
     
     if (monitor_init(&queue->finished_monitor) != 0) {
         monitor_destroy(&queue->not_empty_monitor);
         monitor_destroy(&queue->not_full_monitor);
-        free(queue->items);
+        free_lanes(queue);
         return "Failed to initialize finished_monitor";
     }
     
@@ -45,7 +339,7 @@ const char* consumer_producer_init(consumer_producer_t* queue, int capacity) {
         monitor_destroy(&queue->finished_monitor);
         monitor_destroy(&queue->not_empty_monitor);
         monitor_destroy(&queue->not_full_monitor);
-        free(queue->items);
+        free_lanes(queue);
         return "Failed to initialize mutex";
     }
     
@@ -59,14 +353,25 @@ void consumer_producer_destroy(consumer_producer_t* queue) {
     }
     
     // Free remaining items
-    if (queue->items) {
-        for (int i = 0; i < queue->count; i++) {
-            int index = (queue->head + i) % queue->capacity;
-            if (queue->items[index]) {
-                free(queue->items[index]);
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        consumer_producer_lane_t* lane = &queue->lanes[i];
+        if (!lane->items) {
+            continue;
+        }
+        
+        for (int j = 0; j < lane->count; j++) {
+            int index = (lane->head + j) % queue->capacity;
+            if (lane->items[index]) {
+                free(lane->items[index]);
             }
         }
-        free(queue->items);
+    }
+    free_lanes(queue);
+    
+    if (queue->spill) {
+        spill_destroy(queue->spill);
+        free(queue->spill);
+        queue->spill = NULL;
     }
     
     // Destroy mutex and monitors
@@ -76,80 +381,237 @@ void consumer_producer_destroy(consumer_producer_t* queue) {
     monitor_destroy(&queue->finished_monitor);
 }
 
-const char* consumer_producer_put(consumer_producer_t* queue, const char* item) {
-    if (!queue) {
-        return "Invalid queue";
+const char* consumer_producer_set_budget(consumer_producer_t* queue, size_t byte_budget, byte_budget_t* pipeline_budget, const char* spill_dir) {
+    if (!queue || !spill_dir) {
+        return "Invalid parameters entered to consumer_producer_set_budget";
     }
-
-    if (!item) {
-        return "Invalid item";
+    
+    spill_t* spill = (spill_t*)malloc(sizeof(spill_t));
+    if (!spill) {
+        return "Failed to allocate memory for spill store";
     }
+    
+    const char* error = spill_init(spill, spill_dir);
+    if (error) {
+        free(spill);
+        return error;
+    }
+    
+    pthread_mutex_lock(&queue->mutex);
+    queue->byte_budget = byte_budget;
+    queue->pipeline_budget = pipeline_budget;
+    queue->spill = spill;
+    pthread_mutex_unlock(&queue->mutex);
+    return NULL;
+}
 
-    // Check if queue is finished 
+const char* consumer_producer_set_lanes(consumer_producer_t* queue, const int* weights) {
+    if (!queue) {
+        return "Invalid parameters entered to consumer_producer_set_lanes";
+    }
+    
+    if (weights) {
+        for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+            if (weights[i] <= 0) {
+                return "Lane weights must be positive";
+            }
+        }
+    }
+    
     pthread_mutex_lock(&queue->mutex);
-    if (queue->finished) {
-        pthread_mutex_unlock(&queue->mutex);
-        return "Queue is finished, cannot accept more items";
+    for (int i = 0; i < WORK_PRIORITY_CLASSES; i++) {
+        queue->weights[i] = weights ? weights[i] : 0;
     }
+    queue->current_lane = 0;
+    queue->credit = queue->weights[0];
     pthread_mutex_unlock(&queue->mutex);
+    return NULL;
+}
+
+const char* consumer_producer_set_overload(consumer_producer_t* queue, const overload_policy_t* policy) {
+    if (!queue) {
+        return "Invalid parameters entered to consumer_producer_set_overload";
+    }
+    
+    if (policy && (policy->kind < OVERLOAD_BLOCK || policy->kind > OVERLOAD_SAMPLE || policy->timeout_ns < 0 ||
+                   (policy->kind == OVERLOAD_SAMPLE && policy->sample_every == 0))) {
+        return "Invalid overload policy";
+    }
     
-    // Wait until queue is not full
+    pthread_mutex_lock(&queue->mutex);
+    if (policy) {
+        queue->overload = *policy;
+    } else {
+        memset(&queue->overload, 0, sizeof(queue->overload));
+    }
+    queue->full_arrivals = 0;
+    pthread_mutex_unlock(&queue->mutex);
+    return NULL;
+}
+
+const char* consumer_producer_put(consumer_producer_t* queue, const char* item) {
+    return consumer_producer_put_meta(queue, item, NULL);
+}
+
+// Add an item, waiting for room as long as the overload policy lets it (deadline_ns < 0 waits
+// without a limit) - returns 0 when the item was added or spilled, 1 when the queue was still
+// full at the deadline, 2 when the policy dropped it and -1 on error, with *error set
+static int put_until(consumer_producer_t* queue, const char* item, const work_meta_t* meta, long long deadline_ns, const char** error) {
+    *error = NULL;
+    int shed = 1;
+    long long wait_start = 0;
+    int expired = 0;
     while (1) {
         pthread_mutex_lock(&queue->mutex);
+        if (wait_start) {
+            queue->blocked_ns += now_ns() - wait_start;
+            wait_start = 0;
+        }
         
         // Check finished state again after acquiring lock
         if (queue->finished) {
+            *error = queue->error ? queue->error : "Queue is finished, cannot accept more items";
+            pthread_mutex_unlock(&queue->mutex);
+            return -1;
+        }
+        
+        // Over a budget or out of room - spill instead of waiting
+        if (must_spill(queue, strlen(item) + 1)) {
+            *error = spill_locked(queue, item, meta);
             pthread_mutex_unlock(&queue->mutex);
-            return "Queue is finished, cannot accept more items";
+            return *error ? -1 : 0;
         }
         
         if (queue->count < queue->capacity) {
             // Queue has space, proceed with adding
             break;
         }
+        
+        // A full queue sheds the item only when it first arrives, a sampled item waits its turn
+        int outcome = shed ? shed_locked(queue, item) : SHED_WAIT;
+        shed = 0;
+        if (outcome == SHED_ROOM) {
+            break;
+        }
+        if (outcome == SHED_DROPPED || expired) {
+            pthread_mutex_unlock(&queue->mutex);
+            return outcome == SHED_DROPPED ? 2 : 1;
+        }
         pthread_mutex_unlock(&queue->mutex);
         
         // Queue is full, wait for space
-        if (monitor_wait(&queue->not_full_monitor) != 0) {
-            return "Failed to wait for not_full condition";
+        wait_start = now_ns();
+        if (deadline_ns < 0) {
+            if (monitor_wait(&queue->not_full_monitor) != 0) {
+                *error = "Failed to wait for not_full condition";
+                return -1;
+            }
+            continue;
+        }
+        
+        // Out of time, the queue is checked once more before giving up
+        struct timespec deadline = { deadline_ns / 1000000000LL, deadline_ns % 1000000000LL };
+        int result = wait_start < deadline_ns ? monitor_wait_until(&queue->not_full_monitor, &deadline) : 1;
+        if (result < 0) {
+            *error = "Failed to wait for not_full condition";
+            return -1;
         }
+        expired = result == 1;
     }
     
-    char* item_copy = strdup(item);
-    if (!item_copy) {
+    *error = push_copy_locked(queue, item, meta);
+    pthread_mutex_unlock(&queue->mutex);
+    return *error ? -1 : 0;
+}
+
+const char* consumer_producer_put_meta(consumer_producer_t* queue, const char* item, const work_meta_t* meta) {
+    const char* error = NULL;
+    consumer_producer_put_checked(queue, item, meta, &error);
+    return error;
+}
+
+int consumer_producer_put_checked(consumer_producer_t* queue, const char* item, const work_meta_t* meta, const char** error) {
+    if (!queue) {
+        *error = "Invalid queue";
+        return -1;
+    }
+
+    if (!item) {
+        *error = "Invalid item";
+        return -1;
+    }
+    
+    // A blocking policy with a timeout drops the item once its wait runs out
+    long long deadline_ns = -1;
+    if (queue->overload.timeout_ns > 0 && strcmp(item, "<END>") != 0) {
+        deadline_ns = now_ns() + queue->overload.timeout_ns;
+    }
+    
+    int result = put_until(queue, item, meta, deadline_ns, error);
+    if (result == 1) {
+        pthread_mutex_lock(&queue->mutex);
+        queue->dropped++;
         pthread_mutex_unlock(&queue->mutex);
-        return "Failed to allocate memory for item";
+    }
+    return result < 0 ? -1 : result > 0;
+}
+
+int consumer_producer_try_put(consumer_producer_t* queue, const char* item, const work_meta_t* meta) {
+    if (!queue || !item) {
+        return -1;
     }
     
-    // Add item to queue
-    queue->items[queue->tail] = item_copy;
-    queue->tail = (queue->tail + 1) % queue->capacity;
-    queue->count++;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->finished) {
+        pthread_mutex_unlock(&queue->mutex);
+        return -1;
+    }
     
-    // If this was the first item, signal not_empty
-    if (queue->count == 1) {
-        monitor_signal(&queue->not_empty_monitor);
+    if (must_spill(queue, strlen(item) + 1)) {
+        int result = spill_locked(queue, item, meta) ? -1 : 0;
+        pthread_mutex_unlock(&queue->mutex);
+        return result;
     }
     
-    // If queue is now full, reset not_full_monitor
-    if (queue->count == queue->capacity) {
-        monitor_reset(&queue->not_full_monitor);
+    int outcome = queue->count < queue->capacity ? SHED_ROOM : shed_locked(queue, item);
+    if (outcome != SHED_ROOM) {
+        queue->room_wanted |= outcome == SHED_WAIT;
+        pthread_mutex_unlock(&queue->mutex);
+        return outcome == SHED_WAIT ? 1 : 2;
     }
     
+    const char* error = push_copy_locked(queue, item, meta);
     pthread_mutex_unlock(&queue->mutex);
-    return NULL;
+    return error ? -1 : 0;
 }
 
 char* consumer_producer_get(consumer_producer_t* queue) {
+    return consumer_producer_get_meta(queue, NULL);
+}
+
+char* consumer_producer_get_meta(consumer_producer_t* queue, work_meta_t* meta) {
+    return consumer_producer_get_wakeable(queue, meta, NULL);
+}
+
+char* consumer_producer_get_wakeable(consumer_producer_t* queue, work_meta_t* meta, int* woken) {
+    if (woken) {
+        *woken = 0;
+    }
     if (!queue) {
         return NULL;
     }
     
-    // Wait until queue is not empty or finished
+    // Wait until queue is not empty or finished (or a wakeable consumer is woken)
     while (1) {
         pthread_mutex_lock(&queue->mutex);
         
-        if (queue->count > 0) {
+        // A broken queue has nothing left to give
+        if (queue->error) {
+            pthread_mutex_unlock(&queue->mutex);
+            return NULL;
+        }
+        
+        if (queue->count > 0 || spilled(queue) > 0) {
             break;
         }
         
@@ -159,6 +621,15 @@ char* consumer_producer_get(consumer_producer_t* queue) {
             return NULL;
         }
         
+        // The wake-up signaled an empty queue, which is reset so the next wait blocks again
+        if (woken && queue->wake_pending) {
+            queue->wake_pending = 0;
+            monitor_reset(&queue->not_empty_monitor);
+            pthread_mutex_unlock(&queue->mutex);
+            *woken = 1;
+            return NULL;
+        }
+        
         pthread_mutex_unlock(&queue->mutex);
         
         // Queue is empty but not finished
@@ -167,25 +638,91 @@ char* consumer_producer_get(consumer_producer_t* queue) {
         }
     }
     
-    char* item = queue->items[queue->head];
-    queue->items[queue->head] = NULL;
-    queue->head = (queue->head + 1) % queue->capacity;
-    queue->count--;
-    
-    // Queue is full
-    if (queue->count == queue->capacity - 1) {
-        monitor_signal(&queue->not_full_monitor);
+    char* item = take_locked(queue, meta);
+    pthread_mutex_unlock(&queue->mutex);
+    return item;
+}
+
+void consumer_producer_set_room_callback(consumer_producer_t* queue, void (*room)(void*), void* room_arg) {
+    if (!queue) {
+        return;
     }
     
-    // Queue is empty
-    if (queue->count == 0) {
-        monitor_reset(&queue->not_empty_monitor);
+    pthread_mutex_lock(&queue->mutex);
+    queue->room_callback = room;
+    queue->room_arg = room_arg;
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+char* consumer_producer_try_get(consumer_producer_t* queue, work_meta_t* meta) {
+    if (!queue) {
+        return NULL;
     }
     
+    pthread_mutex_lock(&queue->mutex);
+    char* item = NULL;
+    if (!queue->error && (queue->count > 0 || spilled(queue) > 0)) {
+        item = take_locked(queue, meta);
+    }
     pthread_mutex_unlock(&queue->mutex);
     return item;
 }
 
+int consumer_producer_count(consumer_producer_t* queue) {
+    if (!queue) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&queue->mutex);
+    int count = queue->count + spilled(queue);
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+unsigned long long consumer_producer_blocked_ns(consumer_producer_t* queue) {
+    if (!queue) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&queue->mutex);
+    unsigned long long blocked = queue->blocked_ns;
+    pthread_mutex_unlock(&queue->mutex);
+    return blocked;
+}
+
+unsigned long consumer_producer_dropped(consumer_producer_t* queue) {
+    if (!queue) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&queue->mutex);
+    unsigned long dropped = queue->dropped;
+    pthread_mutex_unlock(&queue->mutex);
+    return dropped;
+}
+
+const char* consumer_producer_error(consumer_producer_t* queue) {
+    if (!queue) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&queue->mutex);
+    const char* error = queue->error;
+    pthread_mutex_unlock(&queue->mutex);
+    return error;
+}
+
+void consumer_producer_wake(consumer_producer_t* queue) {
+    if (!queue) {
+        return;
+    }
+    
+    pthread_mutex_lock(&queue->mutex);
+    queue->wake_pending = 1;
+    monitor_signal(&queue->not_empty_monitor);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
 void consumer_producer_signal_finished(consumer_producer_t* queue) {
     if (!queue) {
         return;
@@ -193,6 +730,7 @@ void consumer_producer_signal_finished(consumer_producer_t* queue) {
     
     pthread_mutex_lock(&queue->mutex);
     queue->finished = 1;
+    room_locked(queue);
     pthread_mutex_unlock(&queue->mutex);
     monitor_signal(&queue->finished_monitor);
     monitor_signal(&queue->not_empty_monitor);
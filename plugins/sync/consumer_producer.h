@@ -2,24 +2,62 @@
 #define CONSUMER_PRODUCER_H
 
 #include "monitor.h"
+#include "work_meta.h"
+#include "spill.h"
+#include "byte_budget.h"
+#include "overload.h"
 #include <pthread.h>
+#include <stddef.h>
+
+/** 
+ * One FIFO ring per priority class 
+ */
+typedef struct
+{
+    char** items;                    /* Array of string pointers */
+    work_meta_t* metas;              /* Metadata of each item (same index as items) */
+    unsigned long* sequences;        /* Arrival order of each item across all lanes */
+    int count;                       /* Current number of items in this lane */
+    int head;                        /* Index of first item */
+    int tail;                        /* Index of next insertion point */
+} consumer_producer_lane_t;
 
 /** 
  * Consumer-Producer queue structure for thread-safe producer-consumer pattern 
  * Now using monitors for simpler implementation 
+ * Items are kept in one lane per priority class (the capacity is shared by all lanes) and 
+ * taken by strict priority or weighted round-robin, in order within each lane. The <END> 
+ * marker is only taken once every item queued before it, in any lane, has been taken. 
+ * A full queue blocks its producers unless an overload policy sheds items instead. 
  */
 typedef struct
 {
-    char** items;                    /* Array of string pointers */
+    consumer_producer_lane_t lanes[WORK_PRIORITY_CLASSES]; /* Lane of each class, most urgent first */
     int capacity;                    /* Maximum number of items */
     int count;                       /* Current number of items */
-    int head;                        /* Index of first item */
-    int tail;                        /* Index of next insertion point */
+    unsigned long next_sequence;     /* Sequence number of the next item put */
+    int weights[WORK_PRIORITY_CLASSES]; /* Round-robin weight of each lane (all 0 = strict priority) */
+    int current_lane;                /* Lane served by round-robin */
+    int credit;                      /* Items current_lane may still take in this round */
     pthread_mutex_t mutex;           /* Mutex for protecting queue state */
     monitor_t not_full_monitor;      /* Monitor for "not full" state */
     monitor_t not_empty_monitor;     /* Monitor for "not empty" state */
     monitor_t finished_monitor;      /* Monitor for finished signal */
     int finished;                    /* Flag to indicate if queue is finished */
+    const char* error;               /* Why the queue broke, e.g. a spilled item was lost (NULL = healthy) */
+    size_t bytes;                    /* Bytes held by the items in memory */
+    size_t peak_bytes;               /* Largest bytes seen */
+    size_t byte_budget;              /* Maximum bytes held in memory (0 = unlimited) */
+    byte_budget_t* pipeline_budget;  /* Budget shared with the other queues (NULL = none) */
+    spill_t* spill;                  /* Overflow store, items beyond the budgets (NULL = block instead) */
+    unsigned long long blocked_ns;   /* Time producers spent waiting for room */
+    overload_policy_t overload;      /* What producers do when the queue is full */
+    unsigned long full_arrivals;     /* Items placed into the full queue, for OVERLOAD_SAMPLE */
+    unsigned long dropped;           /* Items dropped by the overload policy */
+    int wake_pending;                /* consumer_producer_wake was called, no wakeable consumer returned yet */
+    void (*room_callback)(void*);    /* Called when a non-blocking producer may retry (NULL = none) */
+    void* room_arg;                  /* Argument passed to room_callback */
+    int room_wanted;                 /* consumer_producer_try_put found the queue full since the last call */
 } consumer_producer_t;
 
 /** 
@@ -36,15 +74,65 @@ const char* consumer_producer_init(consumer_producer_t* queue, int capacity);
  */ 
 void consumer_producer_destroy(consumer_producer_t* queue);
 
+/** 
+ * Limit the bytes the queue holds in memory - items beyond a budget (or beyond the capacity) 
+ * are spilled to disk instead of blocking the producer, and read back in order 
+ * @param queue Pointer to queue structure 
+ * @param byte_budget Maximum bytes held by this queue (0 = unlimited) 
+ * @param pipeline_budget Budget shared with other queues (NULL = none) 
+ * @param spill_dir Writable directory for spill segment files 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* consumer_producer_set_budget(consumer_producer_t* queue, size_t byte_budget, byte_budget_t* pipeline_budget, const char* spill_dir);
+
+/** 
+ * Choose how items are taken from the priority lanes 
+ * @param queue Pointer to queue structure 
+ * @param weights Items each lane may take per round-robin round, most urgent lane first 
+ *                (NULL = strict priority, the default) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* consumer_producer_set_lanes(consumer_producer_t* queue, const int* weights);
+
+/** 
+ * Choose what producers do when the queue is full 
+ * @param queue Pointer to queue structure 
+ * @param policy Overload policy (NULL = block, the default) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* consumer_producer_set_overload(consumer_producer_t* queue, const overload_policy_t* policy);
+
 /** 
  * Add an item to the queue (producer). 
- * Blocks if queue is full. 
+ * Blocks if queue is full (spills instead when a budget is set). 
  * @param queue Pointer to queue structure 
  * @param item String to add (queue takes ownership) 
  * @return NULL on success, error message on failure 
  */ 
 const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
 
+/** 
+ * Add an item together with its metadata to the queue (producer). 
+ * Blocks if queue is full (spills instead when a budget is set), unless the overload 
+ * policy drops an item or gives up waiting - a dropped item still counts as success. 
+ * @param queue Pointer to queue structure 
+ * @param item String to add (queue takes ownership) 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @return NULL on success, error message on failure 
+ */ 
+const char* consumer_producer_put_meta(consumer_producer_t* queue, const char* item, const work_meta_t* meta);
+
+/** 
+ * Add an item together with its metadata to the queue (producer), like consumer_producer_put_meta, 
+ * and tell whether the overload policy dropped it. 
+ * @param queue Pointer to queue structure 
+ * @param item String to add (queue takes a copy) 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @param error Receives the error message on failure 
+ * @return 0 if the item was queued, 1 if the overload policy dropped it, -1 on error 
+ */ 
+int consumer_producer_put_checked(consumer_producer_t* queue, const char* item, const work_meta_t* meta, const char** error);
+
 /** 
  * Remove an item from the queue (consumer) and returns it. 
  * Blocks if queue is empty. 
@@ -53,6 +141,93 @@ const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
  */ 
 char* consumer_producer_get(consumer_producer_t* queue);
 
+/** 
+ * Remove an item and its metadata from the queue (consumer). 
+ * Blocks if queue is empty. 
+ * @param queue Pointer to queue structure 
+ * @param meta Receives the item metadata (may be NULL) 
+ * @return String item or NULL if queue is empty 
+ */ 
+char* consumer_producer_get_meta(consumer_producer_t* queue, work_meta_t* meta);
+
+/** 
+ * Remove an item and its metadata from the queue (consumer), or return early when woken. 
+ * Blocks if queue is empty, until an item arrives, the queue finishes or consumer_producer_wake 
+ * is called; a wake-up is taken by one consumer only. 
+ * @param queue Pointer to queue structure 
+ * @param meta Receives the item metadata (may be NULL) 
+ * @param woken Set to 1 if the call returned NULL because of a wake-up (may be NULL = not wakeable) 
+ * @return String item or NULL if queue is empty 
+ */ 
+char* consumer_producer_get_wakeable(consumer_producer_t* queue, work_meta_t* meta, int* woken);
+
+/** 
+ * Wake a consumer waiting in consumer_producer_get_wakeable on an empty queue, e.g. to let it 
+ * exit - the wake-up stays pending until a wakeable consumer finds the queue empty 
+ * @param queue Pointer to queue structure 
+ */ 
+void consumer_producer_wake(consumer_producer_t* queue);
+
+/** 
+ * Add an item to the queue without blocking (producer). 
+ * A shedding overload policy is applied to a full queue. A blocking policy only makes the 
+ * caller retry, its timeout is not applied. 
+ * @param queue Pointer to queue structure 
+ * @param item String to add (queue takes a copy) 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @return 0 on success, 1 if the queue is full, 2 if the overload policy dropped the item, 
+ *         -1 on error or if the queue is finished 
+ */ 
+int consumer_producer_try_put(consumer_producer_t* queue, const char* item, const work_meta_t* meta);
+
+/** 
+ * Have the queue tell non-blocking producers when to retry - after consumer_producer_try_put 
+ * found it full, room is called once the next item is taken or the queue finishes. It runs on 
+ * the consumer's thread with the queue locked, so it must not use the queue. 
+ * @param queue Pointer to queue structure 
+ * @param room Callback (NULL = none) 
+ * @param room_arg Argument passed to room 
+ */ 
+void consumer_producer_set_room_callback(consumer_producer_t* queue, void (*room)(void*), void* room_arg);
+
+/** 
+ * Remove an item from the queue without blocking (consumer). 
+ * @param queue Pointer to queue structure 
+ * @param meta Receives the item metadata (may be NULL) 
+ * @return String item or NULL if queue is empty 
+ */ 
+char* consumer_producer_try_get(consumer_producer_t* queue, work_meta_t* meta);
+
+/** 
+ * Get the current number of items in the queue (in memory and spilled) 
+ * @param queue Pointer to queue structure 
+ * @return Number of queued items 
+ */ 
+int consumer_producer_count(consumer_producer_t* queue);
+
+/** 
+ * Get the total time producers spent blocked on a full queue 
+ * @param queue Pointer to queue structure 
+ * @return Nanoseconds blocked since the queue was initialized 
+ */ 
+unsigned long long consumer_producer_blocked_ns(consumer_producer_t* queue);
+
+/** 
+ * Get the number of items the overload policy dropped 
+ * @param queue Pointer to queue structure 
+ * @return Items dropped since the queue was initialized 
+ */ 
+unsigned long consumer_producer_dropped(consumer_producer_t* queue);
+
+/** 
+ * Get the error that broke the queue 
+ * A queue breaks when a spilled item cannot be read back: it is finished at once, producers 
+ * get the error and consumers get NULL, just as if the queue were empty and finished 
+ * @param queue Pointer to queue structure 
+ * @return Error message, NULL if the queue is healthy 
+ */ 
+const char* consumer_producer_error(consumer_producer_t* queue);
+
 /** 
  * Signal that processing is finished 
  * @param queue Pointer to queue structure 
@@ -1,4 +1,6 @@
 #include "monitor.h"
+#include <errno.h>
+#include <time.h>
 
 int monitor_init(monitor_t* monitor) {
     if (!monitor) {
@@ -10,7 +12,12 @@ int monitor_init(monitor_t* monitor) {
         return -1;
     }
     
-    int condition_result = pthread_cond_init(&monitor->condition, NULL);
+    // Deadlines are monotonic, so they are not moved by changes of the wall clock
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    int condition_result = pthread_cond_init(&monitor->condition, &attributes);
+    pthread_condattr_destroy(&attributes);
     if (condition_result != 0) {
         pthread_mutex_destroy(&monitor->mutex);
         return -1;
@@ -66,6 +73,30 @@ int monitor_wait(monitor_t* monitor) {
         }
     }
     
+    pthread_mutex_unlock(&monitor->mutex);
+    return 0;
+}
+
+int monitor_wait_until(monitor_t* monitor, const struct timespec* deadline) {
+    if (!monitor || !deadline) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&monitor->mutex);
+    
+    while (!monitor->signaled) {
+        int wait_result = pthread_cond_timedwait(&monitor->condition, &monitor->mutex, deadline);
+        if (wait_result == ETIMEDOUT) {
+            int signaled = monitor->signaled;
+            pthread_mutex_unlock(&monitor->mutex);
+            return signaled ? 0 : 1;
+        }
+        if (wait_result != 0) {
+            pthread_mutex_unlock(&monitor->mutex);
+            return -1;
+        }
+    }
+    
     pthread_mutex_unlock(&monitor->mutex);
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define MONITOR_H
 
 #include <pthread.h>
+#include <time.h>
 
 /** 
  * Monitor structure that can remember its state 
@@ -46,4 +47,12 @@ void monitor_reset(monitor_t* monitor);
  */ 
 int monitor_wait(monitor_t* monitor);
 
+/** 
+ * Wait for a monitor to be signaled until a deadline 
+ * @param monitor Pointer to monitor structure 
+ * @param deadline Absolute CLOCK_MONOTONIC time to give up at 
+ * @return 0 on success, 1 if the deadline passed first, -1 on error 
+ */ 
+int monitor_wait_until(monitor_t* monitor, const struct timespec* deadline);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+/* What a producer does when the queue it places into is full */
+#define OVERLOAD_BLOCK        0    /* Wait for room (at most timeout_ns when set, then drop the item) */
+#define OVERLOAD_DROP_NEWEST  1    /* Drop the item being placed */
+#define OVERLOAD_DROP_OLDEST  2    /* Drop the oldest item of the least urgent lane to make room */
+#define OVERLOAD_SAMPLE       3    /* Wait for room with one item in every sample_every, drop the others */
+
+/** 
+ * Overload policy of a queue (the zeroed default blocks without a deadline) 
+ * The <END> marker is never dropped, it always waits for room 
+ */
+typedef struct
+{
+    int kind;                        /* One of OVERLOAD_* */
+    long long timeout_ns;            /* Longest wait for room of OVERLOAD_BLOCK (0 = no limit) */
+    unsigned int sample_every;       /* OVERLOAD_SAMPLE keeps one in this many items of a full queue */
+} overload_policy_t;
+
+#endif
@@ -0,0 +1,211 @@
+#include "spill.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// On-disk record: header followed by the item bytes (without the terminator)
+typedef struct
+{
+    unsigned int length;
+    work_meta_t meta;
+} spill_record_t;
+
+static double now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static int write_all(int fd, const void* data, size_t length, off_t offset) {
+    const char* bytes = (const char*)data;
+    while (length > 0) {
+        ssize_t written = pwrite(fd, bytes, length, offset);
+        if (written <= 0) {
+            return -1;
+        }
+        bytes += written;
+        length -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void* data, size_t length, off_t offset) {
+    char* bytes = (char*)data;
+    while (length > 0) {
+        ssize_t got = pread(fd, bytes, length, offset);
+        if (got <= 0) {
+            return -1;
+        }
+        bytes += got;
+        length -= got;
+        offset += got;
+    }
+    return 0;
+}
+
+// Create a new segment file at the append end
+static spill_segment_t* add_segment(spill_t* spill) {
+    spill_segment_t* segment = (spill_segment_t*)calloc(1, sizeof(spill_segment_t));
+    if (!segment) {
+        return NULL;
+    }
+    
+    size_t path_length = strlen(spill->directory) + 32;
+    char* path = (char*)malloc(path_length);
+    if (!path) {
+        free(segment);
+        return NULL;
+    }
+    
+    snprintf(path, path_length, "%s/pipeline-spill-XXXXXX", spill->directory);
+    segment->fd = mkstemp(path);
+    if (segment->fd < 0) {
+        free(path);
+        free(segment);
+        return NULL;
+    }
+    
+    // Nobody else needs the name - the space is released with the last descriptor
+    unlink(path);
+    free(path);
+    
+    if (spill->tail) {
+        spill->tail->next = segment;
+    } else {
+        spill->head = segment;
+    }
+    spill->tail = segment;
+    spill->segments++;
+    return segment;
+}
+
+static void remove_head(spill_t* spill) {
+    spill_segment_t* segment = spill->head;
+    spill->head = segment->next;
+    if (!spill->head) {
+        spill->tail = NULL;
+    }
+    close(segment->fd);
+    free(segment);
+}
+
+const char* spill_init(spill_t* spill, const char* directory) {
+    if (!spill || !directory) {
+        return "Invalid parameters entered to spill_init";
+    }
+    
+    memset(spill, 0, sizeof(*spill));
+    if (access(directory, W_OK | X_OK) != 0) {
+        return "Spill directory is not writable";
+    }
+    
+    spill->directory = strdup(directory);
+    if (!spill->directory) {
+        return "Failed to allocate memory for spill directory";
+    }
+    
+    return NULL;
+}
+
+int spill_append(spill_t* spill, const char* item, const work_meta_t* meta) {
+    static const work_meta_t default_meta = {0};
+    
+    spill_segment_t* segment = spill->tail;
+    if (!segment || segment->write_offset >= SPILL_SEGMENT_BYTES) {
+        segment = add_segment(spill);
+        if (!segment) {
+            return -1;
+        }
+    }
+    
+    spill_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.length = strlen(item);
+    record.meta = meta ? *meta : default_meta;
+    
+    if (write_all(segment->fd, &record, sizeof(record), segment->write_offset) != 0 ||
+        write_all(segment->fd, item, record.length, segment->write_offset + sizeof(record)) != 0) {
+        return -1;
+    }
+    
+    size_t size = sizeof(record) + record.length;
+    segment->write_offset += size;
+    spill->pending++;
+    spill->pending_bytes += size;
+    spill->items++;
+    spill->bytes += size;
+    if (spill->pending_bytes > spill->peak_bytes) {
+        spill->peak_bytes = spill->pending_bytes;
+    }
+    return 0;
+}
+
+char* spill_read(spill_t* spill, work_meta_t* meta) {
+    if (spill->pending == 0) {
+        return NULL;
+    }
+    
+    // Drop segments that were read completely and are no longer appended to
+    while (spill->head->read_offset >= spill->head->write_offset && spill->head != spill->tail) {
+        remove_head(spill);
+    }
+    
+    double start = now_ns();
+    spill_segment_t* segment = spill->head;
+    spill_record_t record;
+    if (read_all(segment->fd, &record, sizeof(record), segment->read_offset) != 0) {
+        return NULL;
+    }
+    
+    char* item = (char*)malloc(record.length + 1);
+    if (!item) {
+        return NULL;
+    }
+    
+    if (read_all(segment->fd, item, record.length, segment->read_offset + sizeof(record)) != 0) {
+        free(item);
+        return NULL;
+    }
+    item[record.length] = '\0';
+    
+    size_t size = sizeof(record) + record.length;
+    segment->read_offset += size;
+    spill->pending--;
+    spill->pending_bytes -= size;
+    if (meta) {
+        *meta = record.meta;
+    }
+    
+    // Everything was read back - start over at the beginning of the file
+    if (spill->pending == 0) {
+        while (spill->head != spill->tail) {
+            remove_head(spill);
+        }
+        if (ftruncate(spill->head->fd, 0) == 0) {
+            spill->head->write_offset = 0;
+            spill->head->read_offset = 0;
+        }
+    }
+    
+    double elapsed = now_ns() - start;
+    spill->read_ns_total += elapsed;
+    if (elapsed > spill->read_ns_max) {
+        spill->read_ns_max = elapsed;
+    }
+    return item;
+}
+
+void spill_destroy(spill_t* spill) {
+    if (!spill) {
+        return;
+    }
+    
+    while (spill->head) {
+        remove_head(spill);
+    }
+    free(spill->directory);
+    spill->directory = NULL;
+}
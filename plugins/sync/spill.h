@@ -0,0 +1,73 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "work_meta.h"
+
+/** 
+ * Append-only overflow store for queue items 
+ * Items are appended to segment files in a temp directory and read back in the same order. 
+ * Segment files are unlinked as soon as they are created, so nothing is left behind and the 
+ * disk space of a segment is freed when its last item has been read back. 
+ */
+
+// A new segment is started once the current one holds this many bytes
+#define SPILL_SEGMENT_BYTES (4 * 1024 * 1024)
+
+typedef struct spill_segment
+{
+    int fd;                                  /* Unlinked segment file */
+    off_t write_offset;                      /* End of the appended records */
+    off_t read_offset;                       /* Next record to read back */
+    struct spill_segment* next;              /* Newer segment */
+} spill_segment_t;
+
+typedef struct
+{
+    char* directory;                         /* Directory segment files are created in */
+    spill_segment_t* head;                   /* Oldest segment (read end) */
+    spill_segment_t* tail;                   /* Newest segment (append end) */
+    int pending;                             /* Items on disk not read back yet */
+    size_t pending_bytes;                    /* Bytes on disk not read back yet */
+    size_t peak_bytes;                       /* Largest pending_bytes seen */
+    unsigned long items;                     /* Items spilled in total */
+    size_t bytes;                            /* Bytes spilled in total */
+    int segments;                            /* Segment files created */
+    double read_ns_total;                    /* Time spent reading items back */
+    double read_ns_max;                      /* Slowest single read-back */
+} spill_t;
+
+/** 
+ * Initialize an empty spill store - no file is created until the first append 
+ * @param spill Pointer to spill structure 
+ * @param directory Writable directory for segment files 
+ * @return NULL on success, error message on failure 
+ */
+const char* spill_init(spill_t* spill, const char* directory);
+
+/** 
+ * Append an item 
+ * @param spill Pointer to spill structure 
+ * @param item String to append 
+ * @param meta Item metadata (NULL for default metadata) 
+ * @return 0 on success, -1 on failure 
+ */
+int spill_append(spill_t* spill, const char* item, const work_meta_t* meta);
+
+/** 
+ * Read back the oldest item 
+ * @param spill Pointer to spill structure 
+ * @param meta Receives the item metadata (may be NULL) 
+ * @return Newly allocated string, NULL if nothing is pending or on a read or allocation error 
+ *         (the item then stays pending) 
+ */
+char* spill_read(spill_t* spill, work_meta_t* meta);
+
+/** 
+ * Close every segment and free the spill store 
+ * @param spill Pointer to spill structure 
+ */
+void spill_destroy(spill_t* spill);
+
+#endif
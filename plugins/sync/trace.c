@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// Buffer of the calling thread (every plugin library has its own copy of these)
+static __thread trace_buffer_t* thread_buffer = NULL;
+static __thread const trace_t* thread_trace = NULL;
+
+// Claim a buffer slot for the calling thread, NULL if none is left
+static trace_buffer_t* claim_buffer(trace_t* trace, int stage) {
+    thread_trace = trace;
+    thread_buffer = NULL;
+    
+    int slot = atomic_fetch_add(&trace->num_buffers, 1);
+    if (slot >= TRACE_MAX_BUFFERS) {
+        return NULL;
+    }
+    
+    trace_buffer_t* buffer = &trace->buffers[slot];
+    buffer->events = (trace_event_t*)malloc(TRACE_BUFFER_EVENTS * sizeof(trace_event_t));
+    if (!buffer->events) {
+        return NULL;
+    }
+    
+    buffer->written = 0;
+    buffer->tid = (int)syscall(SYS_gettid);
+    buffer->stage = stage;
+    thread_buffer = buffer;
+    return buffer;
+}
+
+const char* trace_init(trace_t* trace, unsigned int sample) {
+    if (!trace || sample == 0) {
+        return "Invalid parameters entered to trace_init";
+    }
+    
+    memset(trace, 0, sizeof(*trace));
+    atomic_init(&trace->num_buffers, 0);
+    trace->sample = sample;
+    trace->origin_ns = trace_now();
+    return NULL;
+}
+
+int trace_add_stage(trace_t* trace, const char* name) {
+    if (trace->num_stages == TRACE_MAX_STAGES) {
+        return -1;
+    }
+    
+    trace->stages[trace->num_stages] = strdup(name);
+    if (!trace->stages[trace->num_stages]) {
+        return -1;
+    }
+    return trace->num_stages++;
+}
+
+long long trace_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int trace_sampled(const trace_t* trace, unsigned long* counter) {
+    return (*counter)++ % trace->sample == 0;
+}
+
+void trace_record(trace_t* trace, int stage, int kind, long long start_ns, int stream, int sampled, int dedicated) {
+    long long end_ns = trace_now();
+    if (!sampled && (kind != TRACE_WAIT || end_ns - start_ns < TRACE_LONG_WAIT_NS)) {
+        return;
+    }
+    
+    trace_buffer_t* buffer = thread_buffer;
+    if (thread_trace != trace) {
+        buffer = claim_buffer(trace, dedicated ? stage : -1);
+    }
+    if (!buffer) {
+        return;
+    }
+    
+    trace_event_t* event = &buffer->events[buffer->written % TRACE_BUFFER_EVENTS];
+    event->start_ns = start_ns;
+    event->duration_ns = end_ns - start_ns;
+    event->stage = stage;
+    event->kind = kind;
+    event->stream = stream;
+    buffer->written++;
+}
+
+void trace_destroy(trace_t* trace) {
+    if (!trace) {
+        return;
+    }
+    
+    int num_buffers = atomic_load(&trace->num_buffers);
+    for (int i = 0; i < num_buffers && i < TRACE_MAX_BUFFERS; i++) {
+        free(trace->buffers[i].events);
+        trace->buffers[i].events = NULL;
+    }
+    
+    for (int i = 0; i < trace->num_stages; i++) {
+        free(trace->stages[i]);
+        trace->stages[i] = NULL;
+    }
+    trace->num_stages = 0;
+}
@@ -0,0 +1,107 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+
+/** 
+ * Execution timeline shared by the host and every plugin (owned by the host) 
+ * Each thread records into its own ring buffer, so recording takes no lock: a thread claims 
+ * a buffer slot once with an atomic increment and is its only writer from then on. When a 
+ * buffer is full the oldest events are overwritten. The buffers are read after every 
+ * recording thread has been joined. 
+ */
+
+// Maximum number of recording threads (a pool worker uses one buffer per plugin it runs)
+#define TRACE_MAX_BUFFERS 256
+
+// Maximum number of named stages
+#define TRACE_MAX_STAGES 64
+
+// Events kept per thread
+#define TRACE_BUFFER_EVENTS 65536
+
+// Waits at least this long are recorded even for items that were not sampled
+#define TRACE_LONG_WAIT_NS 1000000LL
+
+/* Event kinds */
+#define TRACE_WAIT     0             /* Waiting for an item (sleeping in monitor_wait) */
+#define TRACE_PROCESS  1             /* Running the transform */
+#define TRACE_FORWARD  2             /* Handing the result on (blocks while the next queue is full) */
+
+typedef struct
+{
+    long long start_ns;              /* Monotonic start time */
+    long long duration_ns;           /* Length of the event */
+    int stage;                       /* Stage id from trace_add_stage */
+    int kind;                        /* One of TRACE_* */
+    int stream;                      /* Stream id of the item */
+} trace_event_t;
+
+typedef struct
+{
+    trace_event_t* events;           /* Ring of TRACE_BUFFER_EVENTS events */
+    unsigned long written;           /* Events recorded in total (the ring keeps the newest) */
+    int tid;                         /* Kernel thread id of the owner */
+    int stage;                       /* Stage of a dedicated plugin thread (-1 = shared thread) */
+} trace_buffer_t;
+
+typedef struct
+{
+    trace_buffer_t buffers[TRACE_MAX_BUFFERS]; /* One per recording thread and plugin */
+    atomic_int num_buffers;          /* Slots claimed so far (may exceed TRACE_MAX_BUFFERS) */
+    char* stages[TRACE_MAX_STAGES];  /* Stage names */
+    int num_stages;                  /* Number of stages */
+    unsigned int sample;             /* Record one item in every sample items */
+    long long origin_ns;             /* Time the trace was started */
+} trace_t;
+
+/** 
+ * Initialize an empty trace 
+ * @param trace Pointer to trace structure 
+ * @param sample Record one item in every sample items per stage (1 = every item) 
+ * @return NULL on success, error message on failure 
+ */
+const char* trace_init(trace_t* trace, unsigned int sample);
+
+/** 
+ * Register a stage name - called by the host before any thread records 
+ * @param trace Pointer to trace structure 
+ * @param name Stage name (copied) 
+ * @return Stage id, or -1 if there are too many stages 
+ */
+int trace_add_stage(trace_t* trace, const char* name);
+
+/** 
+ * Get the current monotonic time 
+ * @return Time in nanoseconds 
+ */
+long long trace_now(void);
+
+/** 
+ * Decide whether the next item of a stage is sampled 
+ * @param trace Pointer to trace structure 
+ * @param counter Per-stage item counter, advanced by one 
+ * @return 1 if the item's events should be recorded 
+ */
+int trace_sampled(const trace_t* trace, unsigned long* counter);
+
+/** 
+ * Record an event into the calling thread's buffer - waits are kept when they were long even 
+ * if the item was not sampled, other events only when it was 
+ * @param trace Pointer to trace structure 
+ * @param stage Stage id 
+ * @param kind One of TRACE_* 
+ * @param start_ns Start time from trace_now 
+ * @param stream Stream id of the item 
+ * @param sampled Result of trace_sampled for the item 
+ * @param dedicated The calling thread only ever runs this stage (names the thread in the viewer) 
+ */
+void trace_record(trace_t* trace, int stage, int kind, long long start_ns, int stream, int sampled, int dedicated);
+
+/** 
+ * Free every buffer 
+ * @param trace Pointer to trace structure 
+ */
+void trace_destroy(trace_t* trace);
+
+#endif
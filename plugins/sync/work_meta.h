@@ -0,0 +1,23 @@
+#ifndef WORK_META_H
+#define WORK_META_H
+
+/* Priority classes, most urgent first - the zeroed default is the normal class */
+#define WORK_PRIORITY_HIGH    -1
+#define WORK_PRIORITY_NORMAL   0
+#define WORK_PRIORITY_LOW      1
+#define WORK_PRIORITY_CLASSES  3
+
+/* Queue lane of a priority class (0 = most urgent) */
+#define WORK_PRIORITY_LANE(priority) ((priority) - WORK_PRIORITY_HIGH)
+
+/** 
+ * Metadata that travels with every item through the queues and plugins 
+ */
+typedef struct
+{
+    int stream;                      /* Ingest stream id (0 = the default stdin stream) */
+    int priority;                    /* Priority class (one of WORK_PRIORITY_*) */
+    long long ingest_ns;             /* Monotonic time the line entered the pipeline (0 = not stamped) */
+} work_meta_t;
+
+#endif
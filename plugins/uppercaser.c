@@ -1,14 +1,27 @@
 #include "plugin_common.h"
+#include "utf8.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+// Transform code points instead of bytes, set by plugin_set_utf8
+static int utf8_mode = 0;
+
 const char* plugin_transform(const char* input) {
     if (!input) {
         return NULL;
     }
 
     int length_of_input = strlen(input);
+    
+    // Only lines with other characters than ASCII pay for decoding, invalid UTF-8 stays bytewise
+    if (utf8_mode && !utf8_is_ascii(input, length_of_input)) {
+        char* mapped = utf8_transform(input, length_of_input, NULL, utf8_to_upper);
+        if (mapped) {
+            return mapped;
+        }
+    }
+    
     char* result_of_transform = malloc(length_of_input + 1);
 
     if (!result_of_transform) {
@@ -29,6 +42,30 @@ const char* plugin_transform(const char* input) {
     return result_of_transform;
 }
 
+static unsigned char uppercase_map[256];
+static const plugin_descriptor_t descriptor = { TRANSFORM_MAP, uppercase_map, NULL, NULL, 0 };
+
+// Same rule as plugin_transform, as a byte table the host can fuse - not in UTF-8 mode,
+// where a letter may be several bytes
+const plugin_descriptor_t* plugin_get_descriptor(void) {
+    if (utf8_mode) {
+        return NULL;
+    }
+    
+    for (int c = 0; c < 256; c++) {
+        uppercase_map[c] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+    }
+    
+    return &descriptor;
+}
+
+void plugin_set_utf8(int enabled) {
+    utf8_mode = enabled;
+    if (enabled) {
+        utf8_init();
+    }
+}
+
 const char* plugin_init(int queue_size) {
     return common_plugin_init(plugin_transform, "uppercaser", queue_size);
 }
@@ -0,0 +1,265 @@
+#include "utf8.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_HAVE_SIMD 1
+#endif
+
+// Word-at-a-time check, also finishes the tails of the vector checks
+static int is_ascii_scalar(const char* text, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, text + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            return 0;
+        }
+    }
+    
+    for (; i < length; i++) {
+        if ((unsigned char)text[i] & 0x80) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#ifdef UTF8_HAVE_SIMD
+// 64 bytes per round are OR-ed together, one movemask tells whether any high bit was set
+__attribute__((target("sse2")))
+static int is_ascii_sse2(const char* text, size_t length) {
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(text + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(text + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(text + i + 48));
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)))) {
+            return 0;
+        }
+    }
+    
+    for (; i + 16 <= length; i += 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(text + i)))) {
+            return 0;
+        }
+    }
+    return is_ascii_scalar(text + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static int is_ascii_avx2(const char* text, size_t length) {
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(text + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(text + i + 32));
+        if (_mm256_movemask_epi8(_mm256_or_si256(a, b))) {
+            return 0;
+        }
+    }
+    
+    for (; i + 32 <= length; i += 32) {
+        if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(text + i)))) {
+            return 0;
+        }
+    }
+    return is_ascii_scalar(text + i, length - i);
+}
+#endif
+
+static int (*is_ascii_kernel)(const char*, size_t) = is_ascii_scalar;
+static const char* kernel_name = "scalar";
+
+void utf8_init(void) {
+#ifdef UTF8_HAVE_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        is_ascii_kernel = is_ascii_avx2;
+        kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        is_ascii_kernel = is_ascii_sse2;
+        kernel_name = "sse2";
+    }
+#endif
+}
+
+const char* utf8_kernel_name(void) {
+    return kernel_name;
+}
+
+int utf8_is_ascii(const char* text, size_t length) {
+    return is_ascii_kernel(text, length);
+}
+
+int utf8_decode(const char* text, size_t length, uint32_t* code_points) {
+    const unsigned char* bytes = (const unsigned char*)text;
+    int count = 0;
+    size_t i = 0;
+    
+    while (i < length) {
+        unsigned char lead = bytes[i];
+        if (lead < 0x80) {
+            code_points[count++] = lead;
+            i++;
+            continue;
+        }
+        
+        // Sequence length and the smallest code point that needs it (anything below is overlong)
+        int extra;
+        uint32_t code_point;
+        uint32_t minimum;
+        if ((lead & 0xe0) == 0xc0) {
+            extra = 1;
+            code_point = lead & 0x1f;
+            minimum = 0x80;
+        } else if ((lead & 0xf0) == 0xe0) {
+            extra = 2;
+            code_point = lead & 0x0f;
+            minimum = 0x800;
+        } else if ((lead & 0xf8) == 0xf0) {
+            extra = 3;
+            code_point = lead & 0x07;
+            minimum = 0x10000;
+        } else {
+            return -1;
+        }
+        
+        if (i + extra >= length) {
+            return -1;
+        }
+        for (int k = 1; k <= extra; k++) {
+            if ((bytes[i + k] & 0xc0) != 0x80) {
+                return -1;
+            }
+            code_point = (code_point << 6) | (bytes[i + k] & 0x3f);
+        }
+        
+        if (code_point < minimum || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff)) {
+            return -1;
+        }
+        
+        code_points[count++] = code_point;
+        i += extra + 1;
+    }
+    return count;
+}
+
+int utf8_encode(uint32_t code_point, char* out) {
+    unsigned char* bytes = (unsigned char*)out;
+    if (code_point < 0x80) {
+        bytes[0] = code_point;
+        return 1;
+    }
+    if (code_point < 0x800) {
+        bytes[0] = 0xc0 | (code_point >> 6);
+        bytes[1] = 0x80 | (code_point & 0x3f);
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        bytes[0] = 0xe0 | (code_point >> 12);
+        bytes[1] = 0x80 | ((code_point >> 6) & 0x3f);
+        bytes[2] = 0x80 | (code_point & 0x3f);
+        return 3;
+    }
+    bytes[0] = 0xf0 | (code_point >> 18);
+    bytes[1] = 0x80 | ((code_point >> 12) & 0x3f);
+    bytes[2] = 0x80 | ((code_point >> 6) & 0x3f);
+    bytes[3] = 0x80 | (code_point & 0x3f);
+    return 4;
+}
+
+char* utf8_transform(const char* text, size_t length, int (*source_index)(int, int), uint32_t (*map)(uint32_t)) {
+    uint32_t* code_points = (uint32_t*)malloc((length > 0 ? length : 1) * sizeof(uint32_t));
+    if (!code_points) {
+        return NULL;
+    }
+    
+    int count = utf8_decode(text, length, code_points);
+    char* result = count >= 0 ? (char*)malloc((size_t)count * UTF8_MAX_BYTES + 1) : NULL;
+    if (result) {
+        size_t out = 0;
+        for (int i = 0; i < count; i++) {
+            uint32_t code_point = code_points[source_index ? source_index(i, count) : i];
+            out += utf8_encode(map ? map(code_point) : code_point, result + out);
+        }
+        result[out] = '\0';
+    }
+    
+    free(code_points);
+    return result;
+}
+
+// Blocks where upper- and lowercase letters alternate; parity is that of the lowercase letters
+typedef struct
+{
+    uint32_t first;
+    uint32_t last;
+    uint32_t parity;
+} case_pairs_t;
+
+static const case_pairs_t case_pairs[] = {
+    { 0x0100, 0x012f, 1 },                   /* Latin Extended-A */
+    { 0x0132, 0x0137, 1 },
+    { 0x0139, 0x0148, 0 },
+    { 0x014a, 0x0177, 1 },
+    { 0x0179, 0x017e, 0 },
+    { 0x0460, 0x0481, 1 },                   /* Cyrillic */
+    { 0x048a, 0x04bf, 1 },
+    { 0x04c1, 0x04ce, 0 },
+    { 0x04d0, 0x052f, 1 },
+    { 0x1e00, 0x1e95, 1 },                   /* Latin Extended Additional */
+    { 0x1ea0, 0x1eff, 1 },
+};
+
+// Blocks where every lowercase letter is a fixed distance from its uppercase letter
+typedef struct
+{
+    uint32_t first;
+    uint32_t last;
+    uint32_t offset;
+} case_range_t;
+
+static const case_range_t case_ranges[] = {
+    { 0x00e0, 0x00f6, 0x20 },                /* Latin-1 */
+    { 0x00f8, 0x00fe, 0x20 },
+    { 0x03ad, 0x03af, 0x25 },                /* Greek */
+    { 0x03b1, 0x03c1, 0x20 },
+    { 0x03c3, 0x03cb, 0x20 },
+    { 0x03cd, 0x03ce, 0x3f },
+    { 0x0430, 0x044f, 0x20 },                /* Cyrillic */
+    { 0x0450, 0x045f, 0x50 },
+    { 0x0561, 0x0586, 0x30 },                /* Armenian */
+    { 0xff41, 0xff5a, 0x20 },                /* Fullwidth Latin */
+};
+
+uint32_t utf8_to_upper(uint32_t code_point) {
+    if (code_point < 0x80) {
+        return code_point >= 'a' && code_point <= 'z' ? code_point - 'a' + 'A' : code_point;
+    }
+    
+    // Letters whose uppercase is outside their own block
+    switch (code_point) {
+        case 0x00b5: return 0x039c;
+        case 0x00ff: return 0x0178;
+        case 0x0131: return 0x0049;
+        case 0x017f: return 0x0053;
+        case 0x03ac: return 0x0386;
+        case 0x03c2: return 0x03a3;
+        case 0x03cc: return 0x038c;
+        case 0x04cf: return 0x04c0;
+        default: break;
+    }
+    
+    for (size_t i = 0; i < sizeof(case_ranges) / sizeof(case_ranges[0]); i++) {
+        if (code_point >= case_ranges[i].first && code_point <= case_ranges[i].last) {
+            return code_point - case_ranges[i].offset;
+        }
+    }
+    
+    for (size_t i = 0; i < sizeof(case_pairs) / sizeof(case_pairs[0]); i++) {
+        if (code_point >= case_pairs[i].first && code_point <= case_pairs[i].last) {
+            return (code_point & 1) == case_pairs[i].parity ? code_point - 1 : code_point;
+        }
+    }
+    return code_point;
+}
@@ -0,0 +1,74 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** 
+ * UTF-8 helpers for the text plugins 
+ * Lines are checked for pure ASCII first, many bytes at a time with SIMD, so ASCII text stays 
+ * on the plugins' byte paths and only lines with other characters are decoded into code points. 
+ */
+
+// Longest encoding of a code point
+#define UTF8_MAX_BYTES 4
+
+/** 
+ * Pick the fastest ASCII check the CPU supports - call once before the plugin starts 
+ */
+void utf8_init(void);
+
+/** 
+ * Get the name of the ASCII check picked by utf8_init 
+ * @return "avx2", "sse2" or "scalar" 
+ */
+const char* utf8_kernel_name(void);
+
+/** 
+ * Check whether a text is pure ASCII 
+ * @param text Text to check 
+ * @param length Bytes in text 
+ * @return 1 if no byte has the high bit set, 0 otherwise 
+ */
+int utf8_is_ascii(const char* text, size_t length);
+
+/** 
+ * Decode a text into code points 
+ * Overlong forms, surrogates, code points beyond U+10FFFF and truncated sequences are invalid 
+ * @param text Text to decode 
+ * @param length Bytes in text 
+ * @param code_points Receives the code points (room for length entries) 
+ * @return Number of code points, -1 if the text is not valid UTF-8 
+ */
+int utf8_decode(const char* text, size_t length, uint32_t* code_points);
+
+/** 
+ * Encode one code point 
+ * @param code_point Valid code point 
+ * @param out Receives up to UTF8_MAX_BYTES bytes 
+ * @return Number of bytes written 
+ */
+int utf8_encode(uint32_t code_point, char* out);
+
+/** 
+ * Rebuild a text code point by code point 
+ * Output code point i is map(input code point source_index(i, count)), which is how the 
+ * PERMUTE descriptors of the plugins describe their byte transforms 
+ * @param text Text to transform 
+ * @param length Bytes in text 
+ * @param source_index Input position of output position index (NULL = same position) 
+ * @param map Applied to every code point (NULL = unchanged) 
+ * @return Newly allocated text, NULL if text is not valid UTF-8 or on allocation failure 
+ */
+char* utf8_transform(const char* text, size_t length, int (*source_index)(int, int), uint32_t (*map)(uint32_t));
+
+/** 
+ * Simple uppercase mapping of a code point 
+ * Covers Latin (Latin-1, Extended-A and Extended Additional), Greek, Cyrillic, Armenian and 
+ * fullwidth Latin; every other code point is its own uppercase 
+ * @param code_point Code point to map 
+ * @return Uppercase code point 
+ */
+uint32_t utf8_to_upper(uint32_t code_point);
+
+#endif
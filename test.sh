@@ -729,6 +729,1150 @@ run_test "Data validation chain" \
     "" \
     ""
 
+# SECTION 21: POOLED EXECUTOR
+print_status "POOLED EXECUTOR TESTS"
+
+run_test "Pool with default size" \
+    "integration\n<END>" \
+    "./analyzer --pool 30 uppercaser rotator flipper expander logger" \
+    "\\[logger\\] O I T A R G E T N I N" \
+    "" \
+    ""
+
+seq 1 50 > pool_order_input.txt
+echo "<END>" >> pool_order_input.txt
+
+run_test "Single worker pool keeps order" \
+    "" \
+    "./analyzer --pool=1 2 uppercaser rotator logger < pool_order_input.txt > pool_order_pooled.txt 2>&1; ./analyzer 2 uppercaser rotator logger < pool_order_input.txt > pool_order_plain.txt 2>&1; grep -c '^\\[logger\\]' pool_order_pooled.txt; cmp -s pool_order_pooled.txt pool_order_plain.txt && echo same order" \
+    "^50$
+same order" \
+    "" \
+    ""
+rm -f pool_order_input.txt pool_order_pooled.txt pool_order_plain.txt
+
+run_test "Pool with typewriter" \
+    "hi\n<END>" \
+    "timeout 10 ./analyzer --pool=2 10 uppercaser typewriter" \
+    "\\[typewriter\\] HI" \
+    "" \
+    ""
+
+run_test "Invalid pool size" \
+    "" \
+    "./analyzer --pool=0 10 logger" \
+    "Error: Invalid pool size" \
+    "check_usage" \
+    "expect_error"
+
+run_test "Unknown option" \
+    "" \
+    "./analyzer --bogus 10 logger" \
+    "Error: Unknown option --bogus" \
+    "check_usage" \
+    "expect_error"
+
+# SECTION 22: INLINE EXECUTION
+print_status "INLINE EXECUTION TESTS"
+
+# Run the same input threaded and with the given options and compare the outputs
+# (sorted, since logger and typewriter lines interleave differently across threads)
+run_mode_test() {
+    local test_name="$1"
+    local input="$2"
+    local mode="$3"
+    local arguments="$4"
+    
+    test_count=$((test_count + 1))
+    print_status "Running test $test_count: $test_name"
+    
+    local expected_output
+    local actual_output
+    expected_output=$(echo -e "$input" | eval "timeout 30 ./analyzer $arguments" 2>&1 | sort || true)
+    actual_output=$(echo -e "$input" | eval "timeout 30 ./analyzer $mode $arguments" 2>&1 | sort || true)
+    
+    if [ "$expected_output" = "$actual_output" ]; then
+        print_status "PASS: $test_name"
+        pass_count=$((pass_count + 1))
+    else
+        print_error "FAIL: $test_name"
+        print_error "Reason: output differs from threaded mode"
+        diff <(echo "$expected_output") <(echo "$actual_output") | sed 's/^/  /'
+        echo
+        failed_tests+=("$test_name")
+    fi
+}
+
+run_mode_test "Inline five-plugin chain" \
+    "hello\n<END>" \
+    "--inline" \
+    "15 uppercaser rotator flipper expander logger"
+
+run_mode_test "Inline multiple inputs" \
+    "$(for i in {1..50}; do echo -n "$i\n"; done)<END>" \
+    "--inline" \
+    "1 uppercaser logger"
+
+run_mode_test "Inline empty lines" \
+    "test\n\ntest2\n<END>" \
+    "--inline" \
+    "10 expander rotator logger"
+
+run_mode_test "Inline logger and typewriter" \
+    "hello\nworld\n<END>" \
+    "--inline" \
+    "10 logger typewriter"
+
+run_mode_test "Inline just END token" \
+    "<END>" \
+    "--inline" \
+    "10 logger"
+
+run_mode_test "Inline large string" \
+    "$(printf 'BigString%.0s' {1..10})\n<END>" \
+    "--inline" \
+    "30 uppercaser rotator flipper expander logger"
+
+run_test "Inline combined with pool" \
+    "" \
+    "./analyzer --inline --pool 10 logger" \
+    "Error: --pool and --inline cannot be combined" \
+    "check_usage" \
+    "expect_error"
+
+# SECTION 23: MULTI-STREAM INGEST
+print_status "MULTI-STREAM INGEST TESTS"
+
+printf 'alpha\nbeta\n<END>\nignored\n' > stream_a.txt
+printf 'one\ntwo' > stream_b.txt
+
+run_test "Two input streams" \
+    "" \
+    "./analyzer --input stream_a.txt --input stream_b.txt 5 uppercaser rotator" \
+    "\\[stream_a.txt\\] AALPH
+\\[stream_a.txt\\] ABET
+\\[stream_b.txt\\] EON
+\\[stream_b.txt\\] OTW
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Stream END closes only its own stream" \
+    "" \
+    "./analyzer --input stream_a.txt --input stream_b.txt 5 logger | grep -c ignored" \
+    "^0$" \
+    "" \
+    ""
+
+run_test "Per-stream output files" \
+    "" \
+    "rm -rf streams_out && mkdir streams_out && ./analyzer --pool=2 --input stream_a.txt --input stream_b.txt --output-dir streams_out 1 flipper && cat streams_out/1-stream_a.txt.out streams_out/2-stream_b.txt.out | tr '\\n' ' '" \
+    "ahpla ateb eno owt" \
+    "" \
+    ""
+
+# The writer of the second FIFO starts first, the first FIFO only gets a writer once the
+# second stream's result came out - reading must not wait for the first FIFO's writer
+ingest_reverse_fifos() {
+    rm -f fifo_a fifo_b
+    mkfifo fifo_a fifo_b
+    
+    timeout 10 ./analyzer --input fifo_a --input fifo_b 5 uppercaser > fifo_results.txt 2>&1 &
+    local analyzer_pid=$!
+    timeout 3 sh -c "printf 'from b\\n<END>\\n' > fifo_b"
+    for attempt in $(seq 30); do
+        grep -q "FROM B" fifo_results.txt && break
+        sleep 0.1
+    done
+    timeout 3 sh -c "printf 'from a\\n<END>\\n' > fifo_a"
+    
+    wait "$analyzer_pid"
+    echo "exit $?"
+    cat fifo_results.txt
+    rm -f fifo_a fifo_b fifo_results.txt
+}
+
+run_test "FIFO inputs whose writers start in reverse order" \
+    "" \
+    "ingest_reverse_fifos" \
+    "\\[fifo_b\\] FROM B
+\\[fifo_a\\] FROM A
+exit 0" \
+    "" \
+    ""
+
+run_test "Missing input file" \
+    "" \
+    "./analyzer --input no_such_file.txt 5 logger" \
+    "Error opening input no_such_file.txt" \
+    "" \
+    "expect_error"
+
+# SECTION 24: SOCKET SERVER
+print_status "SOCKET SERVER TESTS"
+
+# Serve on a loopback port, send the lines from one client, print the reply,
+# then stop the server with SIGTERM and print what it wrote itself
+query_server() {
+    local port="$1"
+    local arguments="$2"
+    local lines="$3"
+    
+    ./analyzer --listen-tcp "$port" $arguments > server.log 2>&1 &
+    local server_pid=$!
+    for attempt in $(seq 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null && break
+        sleep 0.1
+    done
+    
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    printf '%b\n<END>\n' "$lines" >&3
+    cat <&3
+    exec 3<&-
+    
+    kill -TERM "$server_pid"
+    wait "$server_pid"
+    echo "exit $?"
+    cat server.log
+}
+
+run_test "Server single client" \
+    "" \
+    "query_server 17301 '5 uppercaser rotator' 'hello\nworld'" \
+    "OHELL
+DWORL
+exit 0
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Server with pooled executor" \
+    "" \
+    "query_server 17302 '--pool=2 2 flipper expander' 'abc\n\nxy'" \
+    "c b a
+
+y x
+exit 0" \
+    "" \
+    ""
+
+run_test "Server with inline execution" \
+    "" \
+    "query_server 17303 '--inline 1 uppercaser' 'inline'" \
+    "INLINE
+exit 0" \
+    "" \
+    ""
+
+# One client floods a slow chain through a queue of 1 and keeps its connection open,
+# a second client connecting meanwhile must still get its answer quickly
+query_busy_server() {
+    local port="$1"
+    
+    ./analyzer --listen-tcp "$port" 1 typewriter > server.log 2>&1 &
+    local server_pid=$!
+    for attempt in $(seq 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null && break
+        sleep 0.1
+    done
+    
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    printf 'a\n%.0s' $(seq 15) >&3
+    sleep 0.3
+    
+    local start=$(date +%s%N)
+    exec 4<>"/dev/tcp/127.0.0.1/$port"
+    printf 'b\n<END>\n' >&4
+    cat <&4
+    exec 4<&-
+    local elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+    [ "$elapsed" -lt 2000 ] && echo "second client served while the first was busy"
+    
+    printf '<END>\n' >&3
+    cat <&3 | grep -c a
+    exec 3<&-
+    
+    kill -TERM "$server_pid"
+    wait "$server_pid"
+    echo "exit $?"
+}
+
+run_test "Server keeps serving while one client fills the queue" \
+    "" \
+    "query_busy_server 17306" \
+    "^b$
+second client served while the first was busy
+^15$
+exit 0" \
+    "" \
+    ""
+
+# A client whose lines wait for room hangs up with results unread (so the server sees EPOLLHUP),
+# the server must not spin on it meanwhile and must still place its <END> and exit cleanly
+query_hung_up_client() {
+    local port="$1"
+    
+    ./analyzer --listen-tcp "$port" 1 typewriter > server.log 2>&1 &
+    local server_pid=$!
+    for attempt in $(seq 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null && break
+        sleep 0.1
+    done
+    
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    printf 'a\na line that keeps the typewriter busy\n' >&3
+    printf 'a\n%.0s' $(seq 5) >&3
+    sleep 0.6
+    exec 3<&-
+    sleep 0.2
+    
+    local before=$(awk '{print $14 + $15}' /proc/$server_pid/stat)
+    sleep 1
+    local after=$(awk '{print $14 + $15}' /proc/$server_pid/stat)
+    [ $((after - before)) -lt 20 ] && echo "idle while the lines wait"
+    
+    exec 4<>"/dev/tcp/127.0.0.1/$port"
+    printf 'b\n<END>\n' >&4
+    cat <&4
+    exec 4<&-
+    
+    kill -TERM "$server_pid"
+    wait "$server_pid"
+    echo "exit $?"
+}
+
+run_test "Server idles while a hung up client waits for room" \
+    "" \
+    "query_hung_up_client 17308" \
+    "idle while the lines wait
+^b$
+exit 0" \
+    "" \
+    ""
+
+# Logger output of a server that has not exited yet
+query_logging_server() {
+    local port="$1"
+    
+    ./analyzer --listen-tcp "$port" 5 uppercaser logger > server.log 2>&1 &
+    local server_pid=$!
+    for attempt in $(seq 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null && break
+        sleep 0.1
+    done
+    
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    printf 'hello\n<END>\n' >&3
+    cat <&3 > /dev/null
+    exec 3<&-
+    
+    for attempt in $(seq 20); do
+        grep -q '^\[logger\] HELLO$' server.log && break
+        sleep 0.1
+    done
+    grep '^\[logger\]' server.log | sed 's/$/ while running/'
+    
+    kill -TERM "$server_pid"
+    wait "$server_pid"
+    echo "exit $?"
+}
+
+run_test "Logger output of a running server" \
+    "" \
+    "query_logging_server 17307" \
+    "^\\[logger\\] HELLO while running$
+exit 0" \
+    "" \
+    ""
+
+# Logger output while the pipe on stdin is still open
+query_open_pipe() {
+    (printf 'hello\n'; sleep 3; printf '<END>\n') | ./analyzer 5 uppercaser logger > pipe.log 2>&1 &
+    local pipe_pid=$!
+    for attempt in $(seq 20); do
+        grep -q '^\[logger\] HELLO$' pipe.log && break
+        sleep 0.1
+    done
+    grep '^\[logger\]' pipe.log | sed 's/$/ while the pipe is open/'
+    
+    wait "$pipe_pid"
+    echo "exit $?"
+    rm -f pipe.log
+}
+
+run_test "Logger output while stdin is an open pipe" \
+    "" \
+    "query_open_pipe" \
+    "^\\[logger\\] HELLO while the pipe is open$
+exit 0" \
+    "" \
+    ""
+
+run_test "Invalid listen port" \
+    "" \
+    "./analyzer --listen-tcp 70000 5 logger" \
+    "Error: Invalid port" \
+    "check_usage" \
+    "expect_error"
+
+run_test "Listen combined with input" \
+    "" \
+    "./analyzer --listen-tcp 17304 --input stream_a.txt 5 logger" \
+    "Error: --input and --listen cannot be combined" \
+    "check_usage" \
+    "expect_error"
+
+# SECTION 25: TRANSFORM COMPOSITION
+print_status "TRANSFORM COMPOSITION TESTS"
+
+run_mode_test "Fused map, permutations and expansion" \
+    "hello world\nMixed Case 123\nx\n<END>" \
+    "--fuse" \
+    "10 uppercaser rotator flipper expander"
+
+run_mode_test "Fused runs around an opaque plugin" \
+    "abc\n\nde\n<END>" \
+    "--fuse" \
+    "2 flipper rotator logger expander uppercaser"
+
+run_mode_test "Fused expansion before permutation" \
+    "pipeline\n<END>" \
+    "--fuse" \
+    "5 expander rotator flipper"
+
+run_mode_test "Fused with pooled executor" \
+    "$(for i in {1..50}; do echo -n "line $i\n"; done)<END>" \
+    "--fuse --pool=2" \
+    "1 uppercaser flipper expander logger"
+
+run_mode_test "Fused with inline execution" \
+    "$(printf 'BigString%.0s' {1..10})\n<END>" \
+    "--fuse --inline" \
+    "30 rotator expander uppercaser logger"
+
+run_test "Fused output" \
+    "abc\n<END>" \
+    "./analyzer --fuse 5 uppercaser rotator expander logger" \
+    "\\[logger\\] C A B
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_mode_test "Fused run with a tap inside" \
+    "hello\nabc\n<END>" \
+    "--fuse" \
+    "5 uppercaser logger rotator flipper"
+
+run_test "Tap inside a fused run" \
+    "hello\nhello\n<END>" \
+    "./analyzer --fuse --memo 5 uppercaser logger rotator logger" \
+    "\\[logger\\] HELLO
+\\[logger\\] OHELL
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+# SECTION 26: MEMOIZATION CACHE
+print_status "MEMOIZATION CACHE TESTS"
+
+run_test "Memo hits on repeated lines" \
+    "abc\nabc\nxyz\nabc\n<END>" \
+    "./analyzer --memo 5 uppercaser rotator logger" \
+    "\\[logger\\] CAB
+\\[logger\\] ZXY
+\\[STATS\\]\\[memo\\] - uppercaser+rotator: 2 hits, 2 misses
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Memo never bypasses logger" \
+    "same\nsame\nsame\n<END>" \
+    "./analyzer --memo 5 flipper logger expander | grep -c '\\[logger\\] emas'" \
+    "^3$" \
+    "" \
+    ""
+
+run_test "Memo evicts under a small limit" \
+    "$(for i in {1..40}; do echo -n "line number $i\nline number 1\n"; done)<END>" \
+    "./analyzer --memo=1K 5 flipper expander 2>&1 | grep 'STATS'" \
+    "flipper+expander: 40 hits, 40 misses
+[1-9][0-9]* evictions" \
+    "" \
+    ""
+
+run_mode_test "Memo with pooled executor" \
+    "$(for i in {1..30}; do echo -n "repeat $((i % 4))\n"; done)<END>" \
+    "--memo --pool=2" \
+    "1 uppercaser flipper expander logger 2>/dev/null"
+
+run_test "Invalid memo size" \
+    "" \
+    "./analyzer --memo=12X 5 logger" \
+    "Error: Invalid memo size" \
+    "check_usage" \
+    "expect_error"
+
+# SECTION 27: MICROBENCHMARKS
+print_status "MICROBENCHMARK TESTS"
+
+run_test "Microbenchmarks build and run" \
+    "" \
+    "(cd .. && ./build.sh microbench > /dev/null) && ./microbench --quick --reps 1" \
+    "queue-pingpong *capacity=1 
+queue-stream *capacity=4096 
+monitor-wake
+transform-uppercaser *length=0 
+transform-expander *length=4096 
+transform-logger" \
+    "" \
+    ""
+
+run_test "Microbenchmark filter" \
+    "" \
+    "./microbench --quick --reps 1 --filter transform-flipper | cut -d' ' -f2 | sort -u" \
+    "^transform-flipper$" \
+    "" \
+    ""
+
+# SECTION 28: BYTE BUDGETS AND SPILLING
+print_status "BYTE BUDGET TESTS"
+
+run_mode_test "Queue budget keeps output and order" \
+    "$(for i in {1..200}; do echo -n "burst line number $i\n"; done)<END>" \
+    "--queue-bytes 256" \
+    "2 uppercaser expander logger 2>/dev/null"
+
+run_mode_test "Pipeline budget with pooled executor" \
+    "$(for i in {1..200}; do echo -n "pooled burst $i\n"; done)<END>" \
+    "--pipeline-bytes 512 --pool=2" \
+    "4 rotator flipper logger 2>/dev/null"
+
+run_test "Spill statistics reported" \
+    "$(for i in {1..100}; do echo -n "a line that does not fit $i\n"; done)<END>" \
+    "./analyzer --queue-bytes 64 --spill-dir . 100 expander flipper 2>&1 >/dev/null" \
+    "\\[STATS\\]\\[expander\\] - queue peak [0-9]* bytes in memory, spilled [1-9][0-9]* items
+\\[STATS\\]\\[flipper\\]" \
+    "" \
+    ""
+
+run_test "Spill files are not left behind" \
+    "$(for i in {1..100}; do echo -n "line $i\n"; done)<END>" \
+    "./analyzer --queue-bytes 32 --spill-dir . 5 flipper logger > /dev/null 2>&1; ls | grep -c pipeline-spill" \
+    "^0$" \
+    "" \
+    ""
+
+run_test "Invalid byte budget" \
+    "" \
+    "./analyzer --queue-bytes lots 5 logger" \
+    "Error: Invalid byte budget" \
+    "check_usage" \
+    "expect_error"
+
+run_test "Unwritable spill directory" \
+    "hello\n<END>" \
+    "./analyzer --queue-bytes 1K --spill-dir /no/such/dir 5 logger" \
+    "Error initializing plugin logger: Spill directory is not writable" \
+    "" \
+    "expect_error"
+
+# SECTION 29: PRIORITY LANES
+print_status "PRIORITY LANE TESTS"
+
+run_mode_test "Priority classes keep every line" \
+    "$(for i in {1..200}; do echo -n "!alert $i\nline $i\n~bulk $i\n"; done)<END>" \
+    "--priority '!=high' --priority '~=low'" \
+    "3 uppercaser rotator logger 2>/dev/null"
+
+run_mode_test "Weighted lanes with pooled executor" \
+    "$(for i in {1..200}; do echo -n "!alert $i\nline $i\n~bulk $i\n"; done)<END>" \
+    "--priority '!=high' --priority '~=low' --lanes 4,2,1 --pool=2" \
+    "3 flipper expander logger 2>/dev/null"
+
+run_test "High priority line overtakes queued lines" \
+    "aa\nbb\ncc\n!hi\n<END>" \
+    "./analyzer --priority '!=high' 10 typewriter logger 2>/dev/null | grep '^\\[logger\\]' | tr '\n' ' '" \
+    "\\[logger\\] !hi .*\\[logger\\] bb \\[logger\\] cc" \
+    "" \
+    ""
+
+run_test "Per-class latency report" \
+    "!urgent\nplain\n~later\nplain again\n<END>" \
+    "./analyzer --priority '!=high' --priority '~=low' --lanes 3,2,1 10 uppercaser logger 2>&1 >/dev/null" \
+    "\\[STATS\\]\\[priority\\] - lanes: weighted round-robin 3,2,1
+\\[STATS\\]\\[priority\\] - high: 1 items, latency avg
+\\[STATS\\]\\[priority\\] - normal: 2 items, latency avg
+\\[STATS\\]\\[priority\\] - low: 1 items, latency avg" \
+    "" \
+    ""
+
+printf 'b1\nb2\nb3\n' > prio_bulk.txt
+printf 'alert\n' > prio_alerts.txt
+run_test "Per-source priority for input streams" \
+    "" \
+    "./analyzer --source-priority prio_bulk.txt=low --source-priority prio_alerts.txt=high --input prio_bulk.txt --input prio_alerts.txt 5 uppercaser 2>&1" \
+    "\\[prio_bulk.txt\\] B3
+\\[prio_alerts.txt\\] ALERT
+\\[STATS\\]\\[priority\\] - high: 1 items
+\\[STATS\\]\\[priority\\] - low: 3 items" \
+    "" \
+    ""
+rm -f prio_bulk.txt prio_alerts.txt
+
+run_test "Invalid priority class" \
+    "" \
+    "./analyzer --priority '!=urgent' 5 logger" \
+    "Error: Invalid --priority: Priority class must be high, normal or low" \
+    "" \
+    "expect_error"
+
+run_test "Invalid lane weights" \
+    "" \
+    "./analyzer --lanes 1,0,1 5 logger" \
+    "Error: Invalid --lanes: Lane weights must be positive numbers" \
+    "" \
+    "expect_error"
+
+run_test "Priority classes with byte budgets" \
+    "" \
+    "./analyzer --priority '!=high' --queue-bytes 1K 5 logger" \
+    "Error: --priority, --source-priority and --lanes cannot be combined with byte budgets" \
+    "" \
+    "expect_error"
+
+run_test "Weighted lanes with a pipeline budget" \
+    "" \
+    "./analyzer --lanes 3,2,1 --pipeline-bytes 4K 5 logger" \
+    "Error: --priority, --source-priority and --lanes cannot be combined with byte budgets" \
+    "" \
+    "expect_error"
+
+# SECTION 30: PERFORMANCE COUNTERS
+print_status "PERFORMANCE COUNTER TESTS"
+
+run_mode_test "Counted plugins keep their output" \
+    "$(for i in {1..100}; do echo -n "counted line $i\n"; done)<END>" \
+    "--perf" \
+    "4 uppercaser flipper logger 2>/dev/null"
+
+run_test "Counters reported per stage and phase" \
+    "one\ntwo\nthree\n<END>" \
+    "./analyzer --perf 5 rotator logger 2>&1 >/dev/null" \
+    "\\[STATS\\]\\[rotator\\] - perf process: 3 items, 11 bytes, [0-9.]* ms, IPC [0-9.n/a]*
+\\[STATS\\]\\[rotator\\] - perf wait: 3 items, .*context switches [0-9n/a]*$
+\\[STATS\\]\\[logger\\] - perf process: 3 items" \
+    "" \
+    ""
+
+run_test "Counters need plugin threads" \
+    "" \
+    "./analyzer --perf --pool=2 5 logger" \
+    "Error: --perf cannot be combined with --pool or --inline" \
+    "" \
+    "expect_error"
+
+# SECTION 31: TIMELINE TRACING
+print_status "TIMELINE TRACING TESTS"
+
+run_mode_test "Traced plugins keep their output" \
+    "$(for i in {1..100}; do echo -n "traced line $i\n"; done)<END>" \
+    "--trace trace_mode.json" \
+    "4 uppercaser flipper logger 2>/dev/null"
+rm -f trace_mode.json
+
+run_test "Trace events per stage" \
+    "one\ntwo\n<END>" \
+    "./analyzer --trace trace_test.json 5 rotator logger > /dev/null 2>&1; cat trace_test.json" \
+    "\"traceEvents\"
+\"name\":\"thread_name\".*\"args\":{\"name\":\"rotator\"}
+\"name\":\"wait\",\"cat\":\"rotator\",\"ph\":\"X\"
+\"name\":\"process\",\"cat\":\"rotator\",\"ph\":\"X\"
+\"name\":\"forward\",\"cat\":\"logger\",\"ph\":\"X\"" \
+    "" \
+    ""
+
+run_test "Sampled trace with pooled executor" \
+    "$(for i in {1..100}; do echo -n "line $i\n"; done)<END>" \
+    "./analyzer --trace trace_test.json --trace-sample 10 --pool=2 5 uppercaser logger 2>&1 >/dev/null; grep -c '\"name\":\"process\"' trace_test.json" \
+    "\\[STATS\\]\\[trace\\] - 40 events from [0-9]* buffers written to trace_test.json
+^20$" \
+    "" \
+    ""
+rm -f trace_test.json
+
+run_test "Invalid trace sample" \
+    "" \
+    "./analyzer --trace out.json --trace-sample 0 5 logger" \
+    "Error: Invalid trace sample" \
+    "" \
+    "expect_error"
+
+# SECTION 32: STAGE PROCESSES
+print_status "STAGE PROCESSES TESTS"
+
+run_mode_test "Stage processes keep the output" \
+    "$(for i in {1..200}; do echo -n "process line $i\n"; done)<END>" \
+    "--processes" \
+    "4 uppercaser rotator flipper logger 2>/dev/null"
+
+run_mode_test "Grouped stage processes" \
+    "abc\n\nlonger line\n<END>" \
+    "--processes=2,1" \
+    "1 expander flipper logger 2>/dev/null"
+
+run_test "Every group reports its process" \
+    "hello\n<END>" \
+    "./analyzer --processes=2,1 5 uppercaser rotator logger" \
+    "\\[logger\\] OHELL
+\\[STATS\\]\\[process\\] - group 1 (uppercaser,rotator): pid [0-9]* exited normally
+\\[STATS\\]\\[process\\] - group 2 (logger): pid [0-9]* exited normally
+\\[STATS\\]\\[process\\] - 2 processes, 1 results reached the host
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Stage processes with input streams" \
+    "" \
+    "./analyzer --processes --input stream_a.txt --input stream_b.txt 5 uppercaser rotator" \
+    "\\[stream_a.txt\\] AALPH
+\\[stream_b.txt\\] OTW
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Server with stage processes" \
+    "" \
+    "query_server 17305 '--processes 5 uppercaser flipper' 'served'" \
+    "DEVRES
+exit 0" \
+    "" \
+    ""
+
+# Kill the last stage process while the host still has lines to send
+crash_stage() {
+    (echo first; sleep 2; echo second; echo '<END>') | timeout 20 ./analyzer --processes 5 uppercaser typewriter 2>&1 &
+    local pipeline_pid=$!
+    sleep 1
+    pkill -SEGV -n -f "analyzer --processes 5 uppercaser typewriter"
+    wait "$pipeline_pid"
+    echo "exit $?"
+}
+
+run_test "Crashed stage process is reported" \
+    "" \
+    "crash_stage" \
+    "\\[typewriter\\] FIRST
+group 2 (typewriter): pid [0-9]* killed by signal 11
+Error waiting for stage processes: A stage process failed
+Pipeline shutdown complete
+exit 0" \
+    "" \
+    ""
+
+run_test "Stage processes need inline plugins" \
+    "" \
+    "./analyzer --processes --pool=2 5 logger" \
+    "Error: --processes cannot be combined with --pool" \
+    "" \
+    "expect_error"
+
+run_test "Group sizes must cover the chain" \
+    "hello\n<END>" \
+    "./analyzer --processes=1,1 5 uppercaser rotator logger" \
+    "Error starting stage processes: Group sizes do not add up to the number of plugins" \
+    "" \
+    "expect_error"
+
+# SECTION 33: PATTERN FILTER
+print_status "PATTERN FILTER TESTS"
+
+printf 'error\nwarn\n\n' > filter_patterns.txt
+seq -f "noise%g" 1 100 > filter_many.txt
+
+run_test "Filter keeps matching lines" \
+    "an error here\nall fine\nwarning x\n<END>" \
+    "./analyzer --filter-keep filter_patterns.txt 5 filter uppercaser logger" \
+    "\\[logger\\] AN ERROR HERE
+\\[logger\\] WARNING X
+\\[STATS\\]\\[filter\\] - 2 patterns (teddy[-a-z0-9]*), kept matching lines: 3 lines, 1 dropped (33.3%)
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Filter drops matching lines" \
+    "an error here\nall fine\nwarning x\n<END>" \
+    "./analyzer --filter-drop filter_patterns.txt 5 filter logger | grep -c '^\\[logger\\]'" \
+    "^1$" \
+    "" \
+    ""
+
+run_test "Large pattern sets use the automaton" \
+    "noise42 line\nsignal\nnoise7\n<END>" \
+    "./analyzer --filter-drop filter_many.txt 5 filter logger" \
+    "\\[logger\\] signal
+\\[STATS\\]\\[filter\\] - 100 patterns (aho-corasick), dropped matching lines: 3 lines, 2 dropped (66.7%)" \
+    "" \
+    ""
+
+{ cat filter_many.txt; printf 'abcd\nbc\n'; } > filter_overlap.txt
+
+run_test "Automaton follows failure links" \
+    "zabce\nabd\naabcd\n<END>" \
+    "./analyzer --filter-keep filter_overlap.txt 5 filter logger" \
+    "\\[logger\\] zabce
+\\[logger\\] aabcd
+\\[STATS\\]\\[filter\\] - 102 patterns (aho-corasick), kept matching lines: 3 lines, 1 dropped (33.3%)" \
+    "" \
+    ""
+
+run_mode_test "Filter with pooled executor" \
+    "$(for i in {1..100}; do echo -n "line $i error\nline $i ok\n"; done)<END>" \
+    "--pool=2" \
+    "3 --filter-keep filter_patterns.txt filter rotator logger 2>/dev/null"
+
+run_mode_test "Filter in stage processes" \
+    "$(for i in {1..100}; do echo -n "warn $i\nquiet $i\n"; done)<END>" \
+    "--processes" \
+    "3 --filter-drop filter_patterns.txt filter flipper logger 2>/dev/null"
+
+run_test "Filter without patterns" \
+    "" \
+    "./analyzer 5 filter logger" \
+    "Error initializing plugin filter: No pattern file given" \
+    "" \
+    "expect_error"
+
+run_test "Patterns without filter plugin" \
+    "" \
+    "./analyzer --filter-keep filter_patterns.txt 5 logger" \
+    "Error: --filter-keep and --filter-drop need the filter plugin in the chain" \
+    "" \
+    "expect_error"
+rm -f filter_patterns.txt filter_many.txt filter_overlap.txt
+
+# SECTION 34: CAPTURE AND REPLAY
+print_status "CAPTURE AND REPLAY TESTS"
+
+run_test "Capture stdin and replay it" \
+    "hello\nworld\n<END>" \
+    "./analyzer --capture replay_test.cap 5 uppercaser logger >/dev/null 2>&1; ./analyzer --replay replay_test.cap --replay-speed max 5 uppercaser logger" \
+    "\\[logger\\] HELLO
+\\[logger\\] WORLD
+\\[STATS\\]\\[replay\\] - 2 lines (10 bytes) spanning .* ms replayed in .* ms at max speed
+\\[STATS\\]\\[replay\\] - uppercaser queue: avg .* items, max [0-9]* of 5, full in .*% of samples
+\\[STATS\\]\\[priority\\] - normal: 2 items, latency avg
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Replay keeps the recorded gaps" \
+    "" \
+    "(echo first; sleep 0.3; echo second; echo '<END>') | ./analyzer --capture replay_gap.cap 5 logger >/dev/null 2>&1; ./analyzer --replay replay_gap.cap 5 logger" \
+    "\\[STATS\\]\\[replay\\] - 2 lines (11 bytes) spanning [2-4][0-9][0-9]\\.[0-9] ms replayed in [2-4][0-9][0-9]\\.[0-9] ms at 1x" \
+    "" \
+    ""
+
+run_test "Replay at a faster speed" \
+    "" \
+    "./analyzer --replay replay_gap.cap --replay-speed 10x 5 logger" \
+    "replayed in [3-9][0-9]\\.[0-9] ms at 10x" \
+    "" \
+    ""
+
+printf 'a1\na2\na3\n<END>\n' > replay_a.txt
+printf 'b1\nb2\n<END>\n' > replay_b.txt
+run_test "Capture input streams" \
+    "" \
+    "./analyzer --input replay_a.txt --input replay_b.txt --capture replay_streams.cap 5 logger 2>&1 | grep -c '^\\[STATS\\]\\[capture\\] - 5 lines captured'; ./analyzer --replay replay_streams.cap --replay-speed max 5 logger | grep -c '^\\[logger\\] [ab][0-9]'" \
+    "^1
+5$" \
+    "" \
+    ""
+rm -f replay_a.txt replay_b.txt replay_streams.cap
+
+run_mode_test "Replay into stage processes" \
+    "" \
+    "--processes" \
+    "--replay replay_test.cap --replay-speed max 3 rotator logger 2>/dev/null"
+
+run_test "Replay of a file that is not a capture" \
+    "" \
+    "./analyzer --replay ./logger.so 5 logger" \
+    "Error opening replay: Not a capture file" \
+    "" \
+    "expect_error"
+
+run_test "Invalid replay speed" \
+    "" \
+    "./analyzer --replay replay_test.cap --replay-speed fast 5 logger" \
+    "Error: Invalid replay speed" \
+    "" \
+    "expect_error"
+rm -f replay_test.cap replay_gap.cap
+
+# SECTION 35: ELASTIC STAGES
+print_status "ELASTIC STAGE TESTS"
+
+seq -f "elastic line %g padded to make the expander work" 1 30000 > autoscale_burst.txt
+cp autoscale_burst.txt autoscale_input.txt
+echo "<END>" >> autoscale_input.txt
+echo "nomatch" > autoscale_patterns.txt
+
+# filter has no descriptor, so it is a stateful stage that must keep a single worker
+run_test "Scaled stages keep the output order" \
+    "" \
+    "./analyzer --autoscale=8 --filter-drop autoscale_patterns.txt 2 filter expander rotator flipper logger < autoscale_input.txt > autoscale_scaled.txt 2>autoscale_log.txt; ./analyzer --filter-drop autoscale_patterns.txt 2 filter expander rotator flipper logger < autoscale_input.txt > autoscale_plain.txt 2>/dev/null; cmp -s autoscale_scaled.txt autoscale_plain.txt && echo same order" \
+    "same order" \
+    "" \
+    ""
+
+run_test "Scaling decisions are logged" \
+    "" \
+    "cat autoscale_log.txt" \
+    "\\[INFO\\]\\[autoscale\\] - [a-z]*: 1 -> 2 workers (queue [0-9]*/2, producers blocked [0-9]*%)
+\\[STATS\\]\\[autoscale\\] - expander: [0-9]* added, [0-9]* retired, peak [0-9]* workers, ended with [0-9]*
+\\[STATS\\]\\[autoscale\\] - rotator: [0-9]* added
+\\[STATS\\]\\[autoscale\\] - flipper: [0-9]* added
+\\[STATS\\]\\[autoscale\\] - peak [5-8] of 8 threads" \
+    "" \
+    ""
+
+run_test "Stateful stages are never scaled" \
+    "" \
+    "grep 'autoscale\\] - filter' autoscale_log.txt" \
+    "^\\[STATS\\]\\[autoscale\\] - filter: stateful, peak 1 workers$" \
+    "" \
+    ""
+
+# Threads of the plugin while the input pipe is open but quiet, after a burst scaled the stages up
+count_quiet_threads() {
+    (cat autoscale_burst.txt; sleep 3; echo "<END>") | ./analyzer --autoscale=8 2 expander rotator flipper logger > /dev/null 2>&1 &
+    local pid=$!
+    sleep 2.5
+    echo "$(ls /proc/$pid/task | wc -l) threads while quiet"
+    wait
+}
+
+# The main thread, one consumer thread per stage and the controller are left
+run_test "Quiet stages give their threads back" \
+    "" \
+    "count_quiet_threads" \
+    "^5 threads while quiet$" \
+    "" \
+    ""
+rm -f autoscale_burst.txt autoscale_input.txt autoscale_patterns.txt autoscale_scaled.txt autoscale_plain.txt autoscale_log.txt
+
+run_mode_test "Idle autoscaled pipeline" \
+    "hello\nworld\n<END>" \
+    "--autoscale" \
+    "5 uppercaser rotator logger 2>/dev/null"
+
+run_test "Thread budget below the plugin count" \
+    "" \
+    "./analyzer --autoscale=1 5 uppercaser rotator" \
+    "Error starting autoscaler: Thread budget is smaller than the number of plugins" \
+    "" \
+    "expect_error"
+
+run_test "Autoscale with pooled executor" \
+    "" \
+    "./analyzer --autoscale --pool 5 uppercaser logger" \
+    "Error: --autoscale cannot be combined with --pool" \
+    "" \
+    "expect_error"
+
+run_test "Invalid thread budget" \
+    "" \
+    "./analyzer --autoscale=many 5 uppercaser logger" \
+    "Error: Invalid thread budget" \
+    "" \
+    "expect_error"
+
+# SECTION 36: UTF-8 MODE
+print_status "UTF-8 MODE TESTS"
+
+run_test "Uppercaser maps non-ASCII letters" \
+    "héllo wörld\nпривет мир\nσαλάτα ÿ\n<END>" \
+    "./analyzer --utf8 5 uppercaser logger" \
+    "\\[logger\\] HÉLLO WÖRLD
+\\[logger\\] ПРИВЕТ МИР
+\\[logger\\] ΣΑΛΆΤΑ Ÿ" \
+    "" \
+    ""
+
+run_test "Flipper reverses characters, not bytes" \
+    "שלום 🙂!\n<END>" \
+    "./analyzer --utf8 5 flipper logger" \
+    "\\[logger\\] !🙂 םולש" \
+    "" \
+    ""
+
+run_test "Rotator moves whole characters" \
+    "abcé\n<END>" \
+    "./analyzer --utf8 5 rotator logger" \
+    "\\[logger\\] éabc" \
+    "" \
+    ""
+
+run_test "Invalid UTF-8 keeps the byte transform" \
+    "ab\\xff\n<END>" \
+    "./analyzer --utf8 5 rotator logger | od -An -c | tr -d ' \\n'" \
+    "\\[logger\\]377ab" \
+    "" \
+    ""
+
+run_mode_test "ASCII text in UTF-8 mode" \
+    "Hello World\nMixed Case 123\n\nx\n<END>" \
+    "--utf8" \
+    "5 uppercaser rotator flipper logger 2>/dev/null"
+
+run_test "UTF-8 mode with fused stages" \
+    "grüße\n<END>" \
+    "./analyzer --utf8 --fuse 5 uppercaser flipper logger" \
+    "\\[logger\\] EßÜRG" \
+    "" \
+    ""
+
+# SECTION 37: OVERLOAD POLICIES
+print_status "OVERLOAD POLICY TESTS"
+
+overload_input=$(for i in $(seq 1 20); do printf 'x%d\\n' $i; done)
+
+run_test "Drop-newest does not stall the reader" \
+    "${overload_input}<END>" \
+    "./analyzer --overload drop-newest 1 typewriter" \
+    "\\[STATS\\]\\[overload\\] - typewriter: drop-newest, [0-9]* items dropped
+Pipeline shutdown complete" \
+    "" \
+    ""
+
+run_test "Drop-oldest keeps the newest line" \
+    "${overload_input}<END>" \
+    "./analyzer --overload drop-oldest 1 typewriter" \
+    "\\[typewriter\\] x20
+\\[STATS\\]\\[overload\\] - typewriter: drop-oldest, [0-9]* items dropped" \
+    "" \
+    ""
+
+run_test "Sampling keeps some lines of a full queue" \
+    "${overload_input}<END>" \
+    "./analyzer --overload sample:5 1 typewriter" \
+    "\\[typewriter\\] x1
+\\[STATS\\]\\[overload\\] - typewriter: sample:5, [0-9]* items dropped" \
+    "" \
+    ""
+
+run_test "Blocking with a timeout drops late lines" \
+    "${overload_input}<END>" \
+    "./analyzer --overload block:20 1 typewriter" \
+    "\\[STATS\\]\\[overload\\] - typewriter: block:20, [1-9][0-9]* items dropped" \
+    "" \
+    ""
+
+run_test "A rule for one plugin leaves the others blocking" \
+    "${overload_input}<END>" \
+    "./analyzer --overload drop-oldest --overload typewriter=drop-newest 1 uppercaser typewriter 2>&1 | grep overload" \
+    "uppercaser: drop-oldest
+typewriter: drop-newest" \
+    "" \
+    ""
+
+run_mode_test "Blocking policy loses no lines" \
+    "one\ntwo\nthree\nfour\nfive\n<END>" \
+    "--overload block" \
+    "1 uppercaser rotator logger 2>/dev/null"
+
+run_test "Invalid overload policy" \
+    "" \
+    "./analyzer --overload drop-everything 5 uppercaser logger" \
+    "Error: Invalid --overload: Policy must be block, block:MS, drop-newest, drop-oldest or sample:N" \
+    "" \
+    "expect_error"
+
+run_test "Overload rule for a missing plugin" \
+    "hello\n<END>" \
+    "./analyzer --overload flipper=drop-newest 5 uppercaser logger" \
+    "Error applying --overload: A rule names a plugin that is not in the chain" \
+    "" \
+    "expect_error"
+
+run_test "Overload policy with inline plugins" \
+    "" \
+    "./analyzer --overload drop-newest --inline 5 uppercaser logger" \
+    "Error: --overload cannot be combined with --inline, --processes or byte budgets" \
+    "" \
+    "expect_error"
+
+run_test "Block timeout with pooled executor" \
+    "" \
+    "./analyzer --pool=2 --overload block:20 5 uppercaser logger" \
+    "Error: --overload block:MS cannot be combined with --pool or --listen" \
+    "" \
+    "expect_error"
+
+# Every line is either shown to the tap in front of the queue or dropped, never both
+overload_tap_total() {
+    ./analyzer "$@" > overload_taps.txt 2>&1
+    local logged=$(grep -c '^\[logger\] x' overload_taps.txt)
+    local dropped=$(sed -n 's/.* \([0-9]*\) items dropped$/\1/p' overload_taps.txt)
+    echo "$((logged + dropped)) lines logged or dropped"
+    rm -f overload_taps.txt
+}
+
+run_test "Taps in front of a queue only see queued lines" \
+    "${overload_input}<END>" \
+    "overload_tap_total --overload drop-newest 1 logger typewriter" \
+    "^20 lines logged or dropped$" \
+    "" \
+    ""
+
+# SECTION 38: TAP STAGES
+print_status "TAP STAGE TESTS"
+
+run_test "Logger taps between two plugins" \
+    "hello\n<END>" \
+    "./analyzer 10 uppercaser logger rotator logger" \
+    "\\[logger\\] HELLO
+\\[logger\\] OHELL" \
+    "" \
+    ""
+
+run_test "Logger at the head of the chain" \
+    "hello\n<END>" \
+    "./analyzer 10 logger flipper logger" \
+    "\\[logger\\] hello
+\\[logger\\] olleh" \
+    "" \
+    ""
+
+run_test "Logger stays a stage when profiled" \
+    "hello\n<END>" \
+    "./analyzer --perf 10 uppercaser logger" \
+    "\\[STATS\\]\\[logger\\] - perf process: 1 items
+\\[logger\\] HELLO" \
+    "" \
+    ""
+
+run_mode_test "Taps match the logger running as a process" \
+    "one\ntwo\nthree\n<END>" \
+    "--processes" \
+    "10 uppercaser logger rotator 2>/dev/null"
+
+run_mode_test "Taps on pooled plugins" \
+    "one\ntwo\nthree\n<END>" \
+    "--pool=2" \
+    "10 uppercaser logger flipper logger 2>/dev/null"
+
+run_mode_test "Taps on inline plugins" \
+    "one\ntwo\nthree\n<END>" \
+    "--inline" \
+    "10 logger uppercaser logger expander logger 2>/dev/null"
+
+run_mode_test "Taps on elastic plugins" \
+    "one\ntwo\nthree\n<END>" \
+    "--autoscale=8" \
+    "10 uppercaser logger rotator logger 2>/dev/null"
+
 # FINAL RESULTS
 print_status "TEST EXECUTION COMPLETE"
 print_status "Total tests executed: $test_count"